@@ -1641,6 +1641,9 @@ alsa_driver_read (alsa_driver_t *driver, jack_nframes_t nframes)
 	return 0;
 }
 
+/* playback ports with more inputs than this are mixed by libjack */
+#define ALSA_DRIVER_MIX_SOURCES 32
+
 static int
 alsa_driver_write (alsa_driver_t* driver, jack_nframes_t nframes)
 {
@@ -1649,6 +1652,8 @@ alsa_driver_write (alsa_driver_t* driver, jack_nframes_t nframes)
 	JSList *mon_node;
 	jack_default_audio_sample_t* buf;
 	jack_default_audio_sample_t* monbuf;
+	const jack_default_audio_sample_t* srcs[ALSA_DRIVER_MIX_SOURCES];
+	int nsrcs;
 	jack_nframes_t orig_nframes;
 	snd_pcm_sframes_t nwritten;
 	snd_pcm_sframes_t contiguous;
@@ -1710,17 +1715,46 @@ alsa_driver_write (alsa_driver_t* driver, jack_nframes_t nframes)
 			if (!jack_port_connected (port)) {
 				continue;
 			}
-			buf = jack_port_get_buffer (port, orig_nframes);
-			alsa_driver_write_to_channel (driver, chn,
-						      buf + nwritten, contiguous);
 
-			if (mon_node) {
-				port = (jack_port_t*)mon_node->data;
-				if (!jack_port_connected (port)) {
-					continue;
+			monbuf = NULL;
+			if (mon_node
+			    && jack_port_connected ((jack_port_t*)mon_node->data)) {
+				monbuf = jack_port_get_buffer (
+					(jack_port_t*)mon_node->data,
+					orig_nframes);
+			}
+
+			if (jack_port_is_silent (port)) {
+				/* leave the channel to
+				   alsa_driver_silence_untouched_channels(),
+				   which stops writing it once the whole
+				   buffer is silent */
+				jack_silence_skipped (
+					JackSilenceConvert, contiguous
+					* sizeof(jack_default_audio_sample_t));
+				if (monbuf) {
+					memset (monbuf + nwritten, 0, contiguous * sizeof(jack_default_audio_sample_t));
 				}
-				monbuf = jack_port_get_buffer (port, orig_nframes);
-				memcpy (monbuf + nwritten, buf + nwritten, contiguous * sizeof(jack_default_audio_sample_t));
+			} else if ((nsrcs = jack_port_mix_sources (
+					    port, contiguous, srcs,
+					    ALSA_DRIVER_MIX_SOURCES)) > 0) {
+				/* several inputs: sum them straight into
+				   the device format, chunk by chunk */
+				alsa_driver_mix_to_channel (driver, chn,
+							    srcs, nsrcs,
+							    nwritten, contiguous,
+							    monbuf);
+			} else {
+				buf = jack_port_get_buffer (port, orig_nframes);
+				alsa_driver_write_to_channel (driver, chn,
+							      buf + nwritten,
+							      contiguous);
+				if (monbuf) {
+					memcpy (monbuf + nwritten, buf + nwritten, contiguous * sizeof(jack_default_audio_sample_t));
+				}
+			}
+
+			if (monbuf) {
 				mon_node = jack_slist_next (mon_node);
 			}
 		}
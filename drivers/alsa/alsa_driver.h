@@ -205,6 +205,23 @@ alsa_driver_write_to_channel (alsa_driver_t *driver,
 	alsa_driver_mark_channel_done (driver, channel);
 }
 
+static inline void
+alsa_driver_mix_to_channel (alsa_driver_t *driver,
+			    channel_t channel,
+			    const jack_default_audio_sample_t **srcs,
+			    int nsrcs,
+			    jack_nframes_t offset,
+			    jack_nframes_t nsamples,
+			    jack_default_audio_sample_t *copy)
+{
+	sample_mix_move (driver->playback_addr[channel],
+			 srcs, nsrcs, offset, nsamples,
+			 driver->playback_interleave_skip[channel],
+			 driver->dither_state + channel,
+			 driver->write_via_copy, copy);
+	alsa_driver_mark_channel_done (driver, channel);
+}
+
 void  alsa_driver_silence_untouched_channels(alsa_driver_t *driver,
 					     jack_nframes_t nframes);
 void  alsa_driver_set_clock_sync_status(alsa_driver_t *driver, channel_t chn,
@@ -173,10 +173,225 @@ static inline unsigned int fast_rand ()
 }
 
 
-/* functions for native float sample data */
+/* SSE2 versions of the common float <-> integer conversions.
+
+   They convert four samples at a time and leave any remainder to the
+   scalar loop in the caller. The clip/scale/round sequence gives the
+   same integers as the float_* macros for every finite input (NaN
+   comes out as the negative limit). Skips other than the sample size
+   are handled by converting in registers and scattering or gathering
+   the individual samples, which still saves the per-sample branches.
+ */
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#define MEMOPS_SSE2
+
+#include <emmintrin.h>
+
+static int memops_sse2 = -1;
+
+static inline int memops_have_sse2 ()
+{
+	if (memops_sse2 < 0) {
+		__builtin_cpu_init ();
+		memops_sse2 = __builtin_cpu_supports ("sse2");
+	}
+	return memops_sse2;
+}
+
+__attribute__((target ("sse2")))
+static inline __m128i sse2_float_to_int (const float *src, float scaling)
+{
+	__m128 s = _mm_loadu_ps (src);
+
+	s = _mm_max_ps (s, _mm_set1_ps (NORMALIZED_FLOAT_MIN));
+	s = _mm_min_ps (s, _mm_set1_ps (NORMALIZED_FLOAT_MAX));
+
+	return _mm_cvtps_epi32 (_mm_mul_ps (s, _mm_set1_ps (scaling)));
+}
+
+__attribute__((target ("sse2")))
+static inline __m128i sse2_bswap16 (__m128i x)
+{
+	return _mm_or_si128 (_mm_slli_epi16 (x, 8), _mm_srli_epi16 (x, 8));
+}
+
+__attribute__((target ("sse2")))
+static inline __m128i sse2_bswap32 (__m128i x)
+{
+	x = sse2_bswap16 (x);
+	x = _mm_shufflelo_epi16 (x, _MM_SHUFFLE (2, 3, 0, 1));
+	return _mm_shufflehi_epi16 (x, _MM_SHUFFLE (2, 3, 0, 1));
+}
+
+__attribute__((target ("sse2")))
+static inline __m128i sse2_gather32 (const char *src, unsigned long src_skip)
+{
+	int32_t v[4];
+
+	if (src_skip == 4) {
+		return _mm_loadu_si128 ((const __m128i*)src);
+	}
+
+	memcpy (&v[0], src, 4);
+	memcpy (&v[1], src + src_skip, 4);
+	memcpy (&v[2], src + 2 * src_skip, 4);
+	memcpy (&v[3], src + 3 * src_skip, 4);
+
+	return _mm_loadu_si128 ((const __m128i*)v);
+}
+
+__attribute__((target ("sse2")))
+static void sse2_d32u24 (char *dst, const float *src, unsigned long nsamples, unsigned long dst_skip, int swap)
+{
+	int32_t v[4] __attribute__((aligned (16)));
+	__m128i z;
+	int i;
+
+	for (; nsamples; nsamples -= 4, src += 4) {
+		z = _mm_slli_epi32 (sse2_float_to_int (src, SAMPLE_24BIT_SCALING), 8);
+		if (swap) {
+			z = sse2_bswap32 (z);
+		}
+		if (dst_skip == 4) {
+			_mm_storeu_si128 ((__m128i*)dst, z);
+			dst += 16;
+		} else {
+			_mm_store_si128 ((__m128i*)v, z);
+			for (i = 0; i < 4; i++, dst += dst_skip)
+				memcpy (dst, &v[i], 4);
+		}
+	}
+}
+
+__attribute__((target ("sse2")))
+static void sse2_d24 (char *dst, const float *src, unsigned long nsamples, unsigned long dst_skip, int swap)
+{
+	int32_t v[4] __attribute__((aligned (16)));
+	int i;
+
+	for (; nsamples; nsamples -= 4, src += 4) {
+		_mm_store_si128 ((__m128i*)v,
+				 sse2_float_to_int (src, SAMPLE_24BIT_SCALING));
+		for (i = 0; i < 4; i++, dst += dst_skip) {
+			if (swap) {
+				dst[0] = (char)(v[i] >> 16);
+				dst[1] = (char)(v[i] >> 8);
+				dst[2] = (char)(v[i]);
+			} else {
+				memcpy (dst, &v[i], 3);
+			}
+		}
+	}
+}
+
+__attribute__((target ("sse2")))
+static void sse2_d16 (char *dst, const float *src, unsigned long nsamples, unsigned long dst_skip, int swap)
+{
+	int16_t v[8] __attribute__((aligned (16)));
+	__m128i z;
+	int i;
+
+	for (; nsamples; nsamples -= 4, src += 4) {
+		z = sse2_float_to_int (src, SAMPLE_16BIT_SCALING);
+		/* already within range, so the saturation never kicks in */
+		z = _mm_packs_epi32 (z, z);
+		if (swap) {
+			z = sse2_bswap16 (z);
+		}
+		if (dst_skip == 2) {
+			_mm_storel_epi64 ((__m128i*)dst, z);
+			dst += 8;
+		} else {
+			_mm_store_si128 ((__m128i*)v, z);
+			for (i = 0; i < 4; i++, dst += dst_skip)
+				memcpy (dst, &v[i], 2);
+		}
+	}
+}
+
+__attribute__((target ("sse2")))
+static void sse2_dS_s32u24 (float *dst, const char *src, unsigned long nsamples, unsigned long src_skip, int swap)
+{
+	__m128i x;
+
+	for (; nsamples; nsamples -= 4, dst += 4, src += 4 * src_skip) {
+		x = sse2_gather32 (src, src_skip);
+		if (swap) {
+			x = sse2_bswap32 (x);
+		}
+		x = _mm_srai_epi32 (x, 8);
+		_mm_storeu_ps (dst, _mm_div_ps (_mm_cvtepi32_ps (x),
+						_mm_set1_ps (SAMPLE_24BIT_SCALING)));
+	}
+}
+
+__attribute__((target ("sse2")))
+static void sse2_dS_s16 (float *dst, const char *src, unsigned long nsamples, unsigned long src_skip, int swap)
+{
+	int16_t v[8] __attribute__((aligned (16)));
+	__m128i x;
+	int i;
+
+	for (; nsamples; nsamples -= 4, dst += 4) {
+		if (src_skip == 2) {
+			x = _mm_loadl_epi64 ((const __m128i*)src);
+			src += 8;
+		} else {
+			for (i = 0; i < 4; i++, src += src_skip)
+				memcpy (&v[i], src, 2);
+			x = _mm_loadl_epi64 ((const __m128i*)v);
+		}
+		if (swap) {
+			x = sse2_bswap16 (x);
+		}
+		/* sign extend to 32 bits */
+		x = _mm_srai_epi32 (_mm_unpacklo_epi16 (x, x), 16);
+		_mm_storeu_ps (dst, _mm_div_ps (_mm_cvtepi32_ps (x),
+						_mm_set1_ps (SAMPLE_16BIT_SCALING)));
+	}
+}
+
+/* hand the largest multiple of four samples to an SSE2 converter and
+   advance the caller's pointers past them */
+
+#define SSE2_FROM_FLOAT(fn, swap) \
+	if (nsamples >= 4 && memops_have_sse2 ()) { \
+		unsigned long done = nsamples & ~3UL; \
+		fn (dst, src, done, dst_skip, swap); \
+		dst += done * dst_skip;	\
+		src += done; \
+		nsamples -= done; \
+	}
+
+#define SSE2_TO_FLOAT(fn, swap)	\
+	if (nsamples >= 4 && memops_have_sse2 ()) { \
+		unsigned long done = nsamples & ~3UL; \
+		fn (dst, src, done, src_skip, swap); \
+		dst += done; \
+		src += done * src_skip;	\
+		nsamples -= done; \
+	}
+
+#else /* __i386__ || __x86_64__ */
+
+#define SSE2_FROM_FLOAT(fn, swap)
+#define SSE2_TO_FLOAT(fn, swap)
+
+#endif /* __i386__ || __x86_64__ */
+
+/* functions for native float sample data. A skip of one sample means
+   the channel is not interleaved, which makes the move a plain copy.
+ */
 
 void sample_move_floatLE_sSs (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip)
 {
+	if (src_skip == sizeof(float)) {
+		memcpy (dst, src, nsamples * sizeof(float));
+		return;
+	}
+
 	while (nsamples--) {
 		*dst = *((float*)src);
 		dst++;
@@ -186,6 +401,11 @@ void sample_move_floatLE_sSs (jack_default_audio_sample_t *dst, char *src, unsig
 
 void sample_move_dS_floatLE (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
+	if (dst_skip == sizeof(float)) {
+		memcpy (dst, src, nsamples * sizeof(float));
+		return;
+	}
+
 	while (nsamples--) {
 		*((float*)dst) = *src;
 		dst += dst_skip;
@@ -222,6 +442,8 @@ void sample_move_d32u24_sSs (char *dst, jack_default_audio_sample_t *src, unsign
 {
 	int32_t z;
 
+	SSE2_FROM_FLOAT (sse2_d32u24, 1);
+
 	while (nsamples--) {
 
 		float_24u32 (*src, z);
@@ -245,6 +467,8 @@ void sample_move_d32u24_sSs (char *dst, jack_default_audio_sample_t *src, unsign
 
 void sample_move_d32u24_sS (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
+	SSE2_FROM_FLOAT (sse2_d32u24, 0);
+
 	while (nsamples--) {
 		float_24u32 (*src, *((int32_t*)dst));
 		dst += dst_skip;
@@ -256,6 +480,8 @@ void sample_move_dS_s32u24s (jack_default_audio_sample_t *dst, char *src, unsign
 {
 	/* ALERT: signed sign-extension portability !!! */
 
+	SSE2_TO_FLOAT (sse2_dS_s32u24, 1);
+
 	while (nsamples--) {
 		int x;
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -285,6 +511,8 @@ void sample_move_dS_s32u24 (jack_default_audio_sample_t *dst, char *src, unsigne
 {
 	/* ALERT: signed sign-extension portability !!! */
 
+	SSE2_TO_FLOAT (sse2_dS_s32u24, 0);
+
 	while (nsamples--) {
 		*dst = (*((int*)src) >> 8) / SAMPLE_24BIT_SCALING;
 		dst++;
@@ -296,6 +524,8 @@ void sample_move_d24_sSs (char *dst, jack_default_audio_sample_t *src, unsigned
 {
 	int32_t z;
 
+	SSE2_FROM_FLOAT (sse2_d24, 1);
+
 	while (nsamples--) {
 		float_24 (*src, z);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -316,6 +546,8 @@ void sample_move_d24_sS (char *dst, jack_default_audio_sample_t *src, unsigned l
 {
 	int32_t z;
 
+	SSE2_FROM_FLOAT (sse2_d24, 0);
+
 	while (nsamples--) {
 		float_24 (*src, z);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -384,6 +616,8 @@ void sample_move_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned
 {
 	int16_t tmp;
 
+	SSE2_FROM_FLOAT (sse2_d16, 1);
+
 	while (nsamples--) {
 		// float_16 (*src, tmp);
 
@@ -409,6 +643,8 @@ void sample_move_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned
 
 void sample_move_d16_sS (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
+	SSE2_FROM_FLOAT (sse2_d16, 0);
+
 	while (nsamples--) {
 		float_16 (*src, *((int16_t*)dst));
 		dst += dst_skip;
@@ -566,6 +802,8 @@ void sample_move_dS_s16s (jack_default_audio_sample_t *dst, char *src, unsigned
 	short z;
 
 	/* ALERT: signed sign-extension portability !!! */
+	SSE2_TO_FLOAT (sse2_dS_s16, 1);
+
 	while (nsamples--) {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
 		z = (unsigned char)(src[0]);
@@ -586,6 +824,8 @@ void sample_move_dS_s16 (jack_default_audio_sample_t *dst, char *src, unsigned l
 
 {
 	/* ALERT: signed sign-extension portability !!! */
+	SSE2_TO_FLOAT (sse2_dS_s16, 0);
+
 	while (nsamples--) {
 		*dst = (*((short*)src)) / SAMPLE_16BIT_SCALING;
 		dst++;
@@ -593,6 +833,60 @@ void sample_move_dS_s16 (jack_default_audio_sample_t *dst, char *src, unsigned l
 	}
 }
 
+/* Sum samples offset .. offset + nsamples - 1 of nsrcs (>= 1) buffers
+ * and convert the sum into dst with move(), one block at a time, so
+ * the sum never makes a trip through memory between mixing and
+ * conversion. The dither state carries from block to block just as it
+ * does within a single call to move(). If copy is not NULL the sum is
+ * also stored there, at the same offset.
+ */
+
+#define SAMPLE_MIX_BLOCK 256
+
+void sample_mix_move (char *dst, const jack_default_audio_sample_t **srcs, int nsrcs,
+		      unsigned long offset, unsigned long nsamples, unsigned long dst_skip,
+		      dither_state_t *state,
+		      void (*move)(char *, jack_default_audio_sample_t *, unsigned long, unsigned long, dither_state_t *),
+		      jack_default_audio_sample_t *copy)
+{
+	jack_default_audio_sample_t acc[SAMPLE_MIX_BLOCK] __attribute__((aligned (16)));
+	const jack_default_audio_sample_t *src, *src1;
+	unsigned long i, j, n;
+	int k;
+
+	if (nsrcs == 1 && copy == NULL) {
+		move (dst, (jack_default_audio_sample_t*)srcs[0] + offset,
+		      nsamples, dst_skip, state);
+		return;
+	}
+
+	for (i = offset; i < offset + nsamples; i += n) {
+		n = offset + nsamples - i;
+		if (n > SAMPLE_MIX_BLOCK) {
+			n = SAMPLE_MIX_BLOCK;
+		}
+		src = srcs[0] + i;
+		if (nsrcs > 1) {
+			src1 = srcs[1] + i;
+			for (j = 0; j < n; j++)
+				acc[j] = src[j] + src1[j];
+		} else {
+			for (j = 0; j < n; j++)
+				acc[j] = src[j];
+		}
+		for (k = 2; k < nsrcs; k++) {
+			src = srcs[k] + i;
+			for (j = 0; j < n; j++)
+				acc[j] += src[j];
+		}
+		move (dst, acc, n, dst_skip, state);
+		dst += n * dst_skip;
+		if (copy) {
+			memcpy (copy + i, acc, n * sizeof(jack_default_audio_sample_t));
+		}
+	}
+}
+
 void memset_interleave (char *dst, char val, unsigned long bytes,
 			unsigned long unit_bytes,
 			unsigned long skip_bytes)
@@ -0,0 +1,206 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    memops_bench -- time mixing playback sources and converting them
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+/* Feeds the channels of an interleaved period from several source
+   buffers each, the way the ALSA driver does, in two ways. The
+   three-pass way sums a channel's sources into its mix buffer,
+   converts that into the period, and copies it to the channel's
+   monitor buffer. sample_mix_move() does all of it one block at a
+   time. Every channel has buffers of its own, so with enough channels
+   and frames the working set no longer fits in the cache, as in a
+   real driver. Both ways are timed over the same buffers for a range
+   of channel and source counts, and the rate at which source samples
+   are consumed, best of a few runs, is printed for each. */
+
+#include <time.h>
+
+#include "memops.c"
+
+#define BENCH_MAX_CHANNELS 64
+#define BENCH_MAX_SRCS     8
+#define BENCH_FRAMES       1024
+#define BENCH_SAMPLES      (32 * 1024 * 1024)  /* source samples per run */
+#define BENCH_RUNS         5                   /* best of */
+
+typedef void (*from_float_t)(char *, jack_default_audio_sample_t *, unsigned long, unsigned long, dither_state_t *);
+
+typedef struct {
+	const char *name;
+	from_float_t fn;
+	int width;
+} bench_format_t;
+
+typedef struct {
+	const jack_default_audio_sample_t *srcs[BENCH_MAX_SRCS];
+	jack_default_audio_sample_t *mix;
+	jack_default_audio_sample_t *monitor;
+	dither_state_t state;
+} bench_channel_t;
+
+static const bench_format_t formats[] = {
+	{ "d32u24_sS",  sample_move_d32u24_sS,  4 },
+	{ "d16_sSs",    sample_move_d16_sSs,    2 },
+	{ "dither_tri_d16_sS", sample_move_dither_tri_d16_sS, 2 },
+};
+
+static const int channel_counts[] = { 2, 16, 64 };
+static const int source_counts[] = { 2, 4, 8 };
+
+#define NCASES(a) (sizeof(a) / sizeof(a[0]))
+
+static bench_channel_t channels[BENCH_MAX_CHANNELS];
+static char *period;
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* what jack_audio_port_mixdown() and the driver did before */
+
+static void
+three_pass (const bench_format_t *f, int nchannels, int nsrcs)
+{
+	bench_channel_t *c;
+	unsigned long j;
+	int ch, k;
+
+	for (ch = 0; ch < nchannels; ch++) {
+		c = &channels[ch];
+		memcpy (c->mix, c->srcs[0],
+			BENCH_FRAMES * sizeof(jack_default_audio_sample_t));
+		for (k = 1; k < nsrcs; k++) {
+			for (j = 0; j < BENCH_FRAMES; j++) {
+				c->mix[j] += c->srcs[k][j];
+			}
+		}
+		f->fn (period + ch * f->width, c->mix, BENCH_FRAMES,
+		       f->width * nchannels, &c->state);
+		memcpy (c->monitor, c->mix,
+			BENCH_FRAMES * sizeof(jack_default_audio_sample_t));
+	}
+}
+
+static void
+one_pass (const bench_format_t *f, int nchannels, int nsrcs)
+{
+	bench_channel_t *c;
+	int ch;
+
+	for (ch = 0; ch < nchannels; ch++) {
+		c = &channels[ch];
+		sample_mix_move (period + ch * f->width, c->srcs, nsrcs, 0,
+				 BENCH_FRAMES, f->width * nchannels, &c->state,
+				 f->fn, c->monitor);
+	}
+}
+
+static double
+run (void (*fn)(const bench_format_t *, int, int),
+     const bench_format_t *f, int nchannels, int nsrcs)
+{
+	unsigned long i, periods = BENCH_SAMPLES / (nchannels * nsrcs * BENCH_FRAMES);
+	double start, best = 0.0;
+	int r;
+
+	/* warm the caches and the branch predictors first */
+	fn (f, nchannels, nsrcs);
+
+	/* the fastest run is the one least disturbed by anything else */
+	for (r = 0; r < BENCH_RUNS; r++) {
+		start = now ();
+		for (i = 0; i < periods; i++) {
+			fn (f, nchannels, nsrcs);
+		}
+		start = now () - start;
+		if (best == 0.0 || start < best) {
+			best = start;
+		}
+	}
+
+	/* million source samples consumed per second */
+	return (double)periods * nchannels * nsrcs * BENCH_FRAMES / best / 1e6;
+}
+
+static jack_default_audio_sample_t *
+bench_buffer (int random)
+{
+	jack_default_audio_sample_t *buf;
+	unsigned long j;
+
+	if ((buf = calloc (BENCH_FRAMES, sizeof(*buf))) == NULL) {
+		fprintf (stderr, "memops_bench: out of memory\n");
+		exit (1);
+	}
+
+	if (random) {
+		for (j = 0; j < BENCH_FRAMES; j++) {
+			buf[j] = ((float) rand () / RAND_MAX - 0.5f) * 0.5f;
+		}
+	}
+
+	return buf;
+}
+
+int
+main (int argc, char *argv[])
+{
+	double three, one;
+	size_t n, c, s;
+	int ch, k;
+
+	for (ch = 0; ch < BENCH_MAX_CHANNELS; ch++) {
+		for (k = 0; k < BENCH_MAX_SRCS; k++) {
+			channels[ch].srcs[k] = bench_buffer (1);
+		}
+		channels[ch].mix = bench_buffer (0);
+		channels[ch].monitor = bench_buffer (0);
+	}
+
+	if ((period = calloc (BENCH_FRAMES * BENCH_MAX_CHANNELS, 4)) == NULL) {
+		fprintf (stderr, "memops_bench: out of memory\n");
+		return 1;
+	}
+
+	printf ("%d frames per period\n", BENCH_FRAMES);
+	printf ("%-18s %5s %5s %12s %12s %7s\n", "format", "chans", "srcs",
+		"3-pass Ms/s", "1-pass Ms/s", "ratio");
+
+	for (n = 0; n < NCASES (formats); n++) {
+		for (c = 0; c < NCASES (channel_counts); c++) {
+			for (s = 0; s < NCASES (source_counts); s++) {
+				three = run (three_pass, &formats[n],
+					     channel_counts[c], source_counts[s]);
+				one = run (one_pass, &formats[n],
+					   channel_counts[c], source_counts[s]);
+				printf ("%-18s %5d %5d %12.1f %12.1f %7.2f\n",
+					formats[n].name, channel_counts[c],
+					source_counts[s], three, one,
+					one / three);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,200 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    memops_check -- compare the SSE2 sample converters with the scalar ones
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+/* memops.c is built into this program directly so that the SSE2
+   paths can be switched off through memops_sse2 and each converter
+   run twice over the same input. Every output byte, including the
+   bytes between interleaved samples, must come out the same. */
+
+#include "memops.c"
+
+#ifndef MEMOPS_SSE2
+static int memops_sse2;
+#endif
+
+#define CHECK_MAX_SAMPLES 1100
+#define CHECK_MAX_SKIP    4
+#define CHECK_ROUNDS      2000
+
+typedef void (*from_float_t)(char *, jack_default_audio_sample_t *, unsigned long, unsigned long, dither_state_t *);
+typedef void (*to_float_t)(jack_default_audio_sample_t *, char *, unsigned long, unsigned long);
+
+typedef struct {
+	const char *name;
+	from_float_t fn;
+	int width;
+} from_float_case_t;
+
+typedef struct {
+	const char *name;
+	to_float_t fn;
+	int width;
+} to_float_case_t;
+
+static const from_float_case_t from_float_cases[] = {
+	{ "d32u24_sSs", sample_move_d32u24_sSs, 4 },
+	{ "d32u24_sS",  sample_move_d32u24_sS,  4 },
+	{ "d24_sSs",    sample_move_d24_sSs,    3 },
+	{ "d24_sS",     sample_move_d24_sS,     3 },
+	{ "d16_sSs",    sample_move_d16_sSs,    2 },
+	{ "d16_sS",     sample_move_d16_sS,     2 },
+};
+
+static const to_float_case_t to_float_cases[] = {
+	{ "dS_s32u24s", sample_move_dS_s32u24s, 4 },
+	{ "dS_s32u24",  sample_move_dS_s32u24,  4 },
+	{ "dS_s16s",    sample_move_dS_s16s,    2 },
+	{ "dS_s16",     sample_move_dS_s16,     2 },
+};
+
+#define NCASES(a) (sizeof(a) / sizeof(a[0]))
+
+static jack_default_audio_sample_t fsrc[CHECK_MAX_SAMPLES];
+static jack_default_audio_sample_t fdst[2][CHECK_MAX_SAMPLES];
+static char isrc[CHECK_MAX_SAMPLES * 4 * CHECK_MAX_SKIP];
+static char idst[2][CHECK_MAX_SAMPLES * 4 * CHECK_MAX_SKIP];
+
+/* mostly in-range samples, with the clipping boundaries and values
+   far outside them mixed in */
+
+static jack_default_audio_sample_t
+random_sample ()
+{
+	static const jack_default_audio_sample_t edges[] = {
+		0.0f, -0.0f, 1.0f, -1.0f, NORMALIZED_FLOAT_MAX, NORMALIZED_FLOAT_MIN,
+		1.0000001f, -1.0000001f, 1e-30f, -1e-30f, 1e10f, -1e10f,
+	};
+
+	switch (rand () % 8) {
+	case 0:
+		return edges[rand () % NCASES (edges)];
+	case 1:
+		return ((float) rand () / RAND_MAX - 0.5f) * 8.0f;
+	default:
+		return ((float) rand () / RAND_MAX - 0.5f) * 2.0f;
+	}
+}
+
+static int
+check_from_float (const from_float_case_t *c, unsigned long nsamples, unsigned long skip)
+{
+	dither_state_t state;
+	size_t bytes = nsamples * skip;
+	unsigned long i;
+	int pass;
+
+	for (i = 0; i < nsamples; i++) {
+		fsrc[i] = random_sample ();
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		memset (idst[pass], 0x5a, sizeof(idst[pass]));
+		memset (&state, 0, sizeof(state));
+		memops_sse2 = pass;
+		c->fn (idst[pass], fsrc, nsamples, skip, &state);
+	}
+
+	if (memcmp (idst[0], idst[1], sizeof(idst[0])) == 0) {
+		return 0;
+	}
+
+	for (i = 0; i < bytes; i++) {
+		if (idst[0][i] != idst[1][i]) {
+			break;
+		}
+	}
+	fprintf (stderr, "%s: nsamples %lu skip %lu: sample %lu (%.9g) differs\n",
+		 c->name, nsamples, skip, i / skip, fsrc[i / skip]);
+	return -1;
+}
+
+static int
+check_to_float (const to_float_case_t *c, unsigned long nsamples, unsigned long skip)
+{
+	size_t bytes = nsamples * skip;
+	unsigned long i;
+	int pass;
+
+	for (i = 0; i < bytes; i++) {
+		isrc[i] = (char) rand ();
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		memset (fdst[pass], 0x5a, sizeof(fdst[pass]));
+		memops_sse2 = pass;
+		c->fn (fdst[pass], isrc, nsamples, skip);
+	}
+
+	if (memcmp (fdst[0], fdst[1], sizeof(fdst[0])) == 0) {
+		return 0;
+	}
+
+	for (i = 0; i < nsamples; i++) {
+		if (memcmp (&fdst[0][i], &fdst[1][i], sizeof(fdst[0][i]))) {
+			break;
+		}
+	}
+	fprintf (stderr, "%s: nsamples %lu skip %lu: sample %lu differs (%.9g vs %.9g)\n",
+		 c->name, nsamples, skip, i, fdst[0][i], fdst[1][i]);
+	return -1;
+}
+
+int
+main (int argc, char *argv[])
+{
+	unsigned int seed = argc > 1 ? strtoul (argv[1], NULL, 0) : 1;
+	unsigned long nsamples, skip;
+	int round, failed = 0;
+	size_t n;
+
+#ifdef MEMOPS_SSE2
+	if (!memops_have_sse2 ()) {
+		printf ("memops_check: no SSE2 on this CPU, nothing to compare\n");
+		return 0;
+	}
+#else
+	printf ("memops_check: no SIMD converters on this architecture\n");
+	return 0;
+#endif
+
+	srand (seed);
+
+	for (round = 0; round < CHECK_ROUNDS && !failed; round++) {
+		/* cover the short and remainder cases often */
+		nsamples = rand () % (round & 1 ? CHECK_MAX_SAMPLES : 16);
+		for (n = 0; n < NCASES (from_float_cases); n++) {
+			skip = from_float_cases[n].width * (1 + rand () % CHECK_MAX_SKIP);
+			failed |= check_from_float (&from_float_cases[n], nsamples, skip);
+		}
+		for (n = 0; n < NCASES (to_float_cases); n++) {
+			skip = to_float_cases[n].width * (1 + rand () % CHECK_MAX_SKIP);
+			failed |= check_to_float (&to_float_cases[n], nsamples, skip);
+		}
+	}
+
+	if (failed) {
+		fprintf (stderr, "memops_check: FAILED (seed %u)\n", seed);
+		return 1;
+	}
+
+	printf ("memops_check: %d rounds, scalar and SSE2 output identical\n",
+		CHECK_ROUNDS);
+	return 0;
+}
@@ -1010,7 +1010,12 @@ render_jack_ports_to_payload_float (JSList *playback_ports, JSList *playback_src
 			} else
 #endif
 			{
-				if ( dont_htonl_floats ) {
+				if (jack_port_is_silent (port)) {
+					/* 0.0f is all zero bits in either byte order */
+					memset (packet_bufX, 0, net_period_up * sizeof(uint32_t));
+					jack_silence_skipped (JackSilenceEncode,
+							      net_period_up * sizeof(jack_default_audio_sample_t));
+				} else if ( dont_htonl_floats ) {
 					memcpy ( packet_bufX, buf, net_period_up * sizeof(jack_default_audio_sample_t) );
 				} else {
 					for (i = 0; i < net_period_up; i++) {
@@ -1150,8 +1155,16 @@ render_jack_ports_to_payload_16bit (JSList *playback_ports, JSList *playback_src
 				src_node = jack_slist_next (src_node);
 			} else
 #endif
-			for (i = 0; i < net_period_up; i++)
-				packet_bufX[i] = htons (((uint16_t)((buf[i] + 1.0) * 32767.0)));
+			if (jack_port_is_silent (port)) {
+				uint16_t zero = htons (32767);
+				for (i = 0; i < net_period_up; i++)
+					packet_bufX[i] = zero;
+				jack_silence_skipped (JackSilenceEncode,
+						      net_period_up * sizeof(jack_default_audio_sample_t));
+			} else {
+				for (i = 0; i < net_period_up; i++)
+					packet_bufX[i] = htons (((uint16_t)((buf[i] + 1.0) * 32767.0)));
+			}
 		} else if (jack_port_is_midi (porttype)) {
 			// encode midi events from port to packet
 			// convert the data buffer to a standard format (uint32_t based)
@@ -1282,8 +1295,14 @@ render_jack_ports_to_payload_8bit (JSList *playback_ports, JSList *playback_srcs
 				src_node = jack_slist_next (src_node);
 			} else
 #endif
-			for (i = 0; i < net_period_up; i++)
-				packet_bufX[i] = buf[i] * 127.0;
+			if (jack_port_is_silent (port)) {
+				memset (packet_bufX, 0, net_period_up);
+				jack_silence_skipped (JackSilenceEncode,
+						      net_period_up * sizeof(jack_default_audio_sample_t));
+			} else {
+				for (i = 0; i < net_period_up; i++)
+					packet_bufX[i] = buf[i] * 127.0;
+			}
 		} else if (jack_port_is_midi (porttype)) {
 			// encode midi events from port to packet
 			// convert the data buffer to a standard format (uint32_t based)
@@ -24,11 +24,19 @@
 #include <jack/jack.h>
 #include "internal.h"
 #include "driver_interface.h"
+#include "portindex.h"
 
 struct _jack_driver;
 struct _jack_client_internal;
 struct _jack_port_internal;
 
+/* The server thread keeps its fds registered with epoll instead of
+ * building a pollfd array every time around.
+ */
+#if defined(HAVE_SYS_EPOLL_H) && !defined(JACK_USE_MACH_THREADS)
+#define JACK_USE_EPOLL 1
+#endif
+
 /* Structures is allocated by the engine in local memory to keep track
  * of port buffers and connections.
  */
@@ -42,6 +50,7 @@ typedef struct _jack_port_internal {
 	struct _jack_port_shared *shared;
 	JSList                   *connections;
 	jack_port_buffer_info_t  *buffer_info;
+	jack_port_buffer_info_t  *live_buffer;  /* borrowed by --share-buffers */
 } jack_port_internal_t;
 
 /* The engine's internal port type structure. */
@@ -51,11 +60,59 @@ typedef struct _jack_port_buffer_list {
 	jack_port_buffer_info_t *info;          /* jack_buffer_info_t array */
 } jack_port_buffer_list_t;
 
+/* What the realtime thread needs to run a cycle. The server builds a
+ * new plan whenever the client list or the chain changes and publishes
+ * it with jack_publish_plan(); once published a plan is only read,
+ * apart from the scratch fields the realtime thread owns, and it is
+ * freed only after the cycle has moved on to a newer one. Clients are
+ * in engine->clients order, which jack_sort_graph() leaves in
+ * execution order, in one array, so a cycle is a linear scan that
+ * touches jack_client_internal_t only to call an internal client.
+ */
+typedef struct _jack_plan_entry {
+	jack_client_control_t *control;
+	int internal;           /* runs in the server: internal or driver */
+	int chained;            /* active, has a process callback, not leaving */
+	int start_fd;           /* subgraph head: trigger here ... */
+	int wait_fd;            /* ... and wait for the subgraph here */
+	int start_slot;         /* same, for futex wakeups */
+	int wait_slot;
+	unsigned int nsuccs;    /* sortfeeds edges, as plan indices */
+	unsigned int *succs;
+	int npreds;
+	int pending;            /* scratch: predecessors not yet finished */
+	struct _jack_client_internal *client;
+} jack_plan_entry_t;
+
+typedef struct _jack_plan {
+	unsigned long version;
+	int futex_wakeup;
+	unsigned int nclients;
+	jack_plan_entry_t *clients;
+	struct pollfd *sched_pfd;       /* scratch for the parallel engine */
+	jack_plan_entry_t **sched_client;
+	struct _jack_plan *retired_next;
+} jack_plan_t;
+
 typedef struct _jack_reserved_name {
 	jack_uuid_t uuid;
 	char name[JACK_CLIENT_NAME_SIZE];
 } jack_reserved_name_t;
 
+/* DSP load of one client, accumulated by the cycle until it is
+ * published into the client's jack_client_stats_t.
+ */
+typedef struct {
+	uint32_t cycles;
+	uint32_t timeouts;
+	jack_time_t run_total;
+	jack_time_t run_max;
+	jack_time_t wake_total;
+	jack_time_t wake_max;
+	uint32_t run_histogram[JACK_STATS_BUCKETS];
+	uint32_t wake_histogram[JACK_STATS_BUCKETS];
+} jack_stats_window_t;
+
 #define JACKD_WATCHDOG_TIMEOUT 10000
 #define JACKD_CLIENT_EVENT_TIMEOUT 2000
 
@@ -84,8 +141,9 @@ struct _jack_engine {
 	/* engine serialization -- use precedence for deadlock avoidance */
 	pthread_mutex_t request_lock; /* precedes client_lock */
 	pthread_rwlock_t client_lock;
+	pthread_mutex_t rt_lock;      /* follows client_lock, see jack_lock_rt() */
 	pthread_mutex_t port_lock;
-	pthread_mutex_t problem_lock; /* must hold write lock on client_lock */
+	pthread_mutex_t event_lock;   /* one writer per event ring */
 	int process_errors;
 	int period_msecs;
 
@@ -111,6 +169,11 @@ struct _jack_engine {
 	size_t pfd_size;
 	size_t pfd_max;
 	struct pollfd  *pfd;
+#ifdef JACK_USE_EPOLL
+	int epoll_fd;
+	struct _jack_client_internal **fd_clients; /* by request fd */
+	int fd_clients_size;
+#endif
 	char fifo_prefix[PATH_MAX + 1];
 	int            *fifo;
 	unsigned long fifo_size;
@@ -130,21 +193,45 @@ struct _jack_engine {
 	const char     *server_name;
 	char temporary;
 	int reordered;
+	unsigned long reorder_sent;     /* GraphReordered events delivered ... */
+	unsigned long reorder_skipped;  /* ... and not needed, since startup */
+	unsigned long latency_sent;     /* LatencyCallbacks delivered ... */
+	unsigned long latency_skipped;  /* ... and not needed, since startup */
+	unsigned long events_queued;    /* notifications put in event rings ... */
+	unsigned long events_kicked;    /* ... EventsQueued sent for them ... */
+	unsigned long events_overflow;  /* ... and sent the slow way instead */
 	int feedbackcount;
 	int removing_clients;
 	pid_t wait_pid;
 	int nozombies;
 	int timeout_count_threshold;
-	volatile int problems;
+	int parallel;
+	int futex_wakeup;
+	int share_buffers;
+	int share_mixdowns;
+	int *live_pos;                  /* scratch for jack_plan_shared_buffers() */
+	jack_port_buffer_info_t **live_next;    /* ... and its result */
+	int live_changed;               /* ... not applied yet */
+	int problems;                   /* atomic */
+	int xruns_pending;              /* atomic, for the server thread */
 	volatile int timeout_count;
 	volatile int new_clients_allowed;
 
+	/* the cycle runs from `plan' and never takes `client_lock' */
+	jack_plan_t    *plan;
+	jack_plan_t    *plan_in_use;    /* set by the cycle while it runs */
+	jack_plan_t    *plans_retired;  /* replaced, maybe still in use */
+	unsigned long plan_version;
+	unsigned long lock_null_cycles;         /* rt_lock was busy */
+	unsigned long problem_null_cycles;      /* client problems pending */
+
 	/* these lists are protected by `client_lock' */
 	JSList         *clients;
 	JSList         *clients_waiting;
 	JSList         *reserved_client_names;
 
 	jack_port_internal_t    *internal_ports;
+	jack_port_index_t port_index;   /* protected by port_lock */
 	jack_client_internal_t  *timebase_client;
 	jack_port_buffer_info_t *silent_buffer;
 	jack_client_internal_t  *current_client;
@@ -161,6 +248,23 @@ struct _jack_engine {
 
 	int first_wakeup;
 
+	/* per-cycle client timing ring, exported read-only to clients */
+	jack_shm_info_t trace_shm;
+	jack_trace_header_t *trace;
+	uint32_t trace_cycle;
+	int trace_xrun;
+
+	/* connection snapshot, exported read-only to clients */
+	jack_shm_info_t graph_shm;
+	jack_graph_snapshot_t *graph;
+	uint32_t *graph_scratch;        /* next snapshot's data[] */
+
+	/* per-client DSP load, exported read-only to clients */
+	jack_shm_info_t stats_shm;
+	jack_stats_header_t *stats;
+	jack_stats_window_t *stats_window;      /* one per record */
+	uint32_t stats_cycles;
+
 #ifdef JACK_USE_MACH_THREADS
 	/* specific resources for server/client real-time thread communication */
 	mach_port_t servertask, bp;
@@ -182,8 +286,9 @@ jack_engine_t  *jack_engine_new(int real_time, int real_time_priority,
 				int verbose, int client_timeout,
 				unsigned int port_max,
 				pid_t waitpid, jack_nframes_t frame_time_offset, int nozombies,
-				int timeout_count_threshold,
-				JSList *drivers);
+				int timeout_count_threshold, int parallel,
+				int futex_wakeup, int share_buffers,
+				int share_mixdowns, JSList *drivers);
 void            jack_engine_delete(jack_engine_t *);
 int             jack_run(jack_engine_t *engine);
 int             jack_wait(jack_engine_t *engine);
@@ -211,9 +316,17 @@ jack_client_internal_by_id(jack_engine_t *engine, jack_uuid_t id);
 #define jack_try_rdlock_graph(e) pthread_rwlock_tryrdlock (&e->client_lock)
 #define jack_unlock_graph(e) { DEBUG ("release graph lock"); if (pthread_rwlock_unlock (&e->client_lock)) { abort (); } }
 
-#define jack_trylock_problems(e) pthread_mutex_trylock (&e->problem_lock)
-#define jack_lock_problems(e) { DEBUG ("acquiring problem lock"); if (pthread_mutex_lock (&e->problem_lock)) { abort (); } }
-#define jack_unlock_problems(e) { DEBUG ("release problem lock"); if (pthread_mutex_unlock (&e->problem_lock)) { abort (); } }
+/* The process cycle holds rt_lock for its whole length. The server
+ * takes it, always inside client_lock, only to change something a
+ * running cycle or an internal client's process() looks at directly:
+ * a client's place in the chain, shared port buffers, an active
+ * internal client's connections, transport sync state. Everything
+ * else goes through the plan. A cycle that finds rt_lock held runs
+ * as a null cycle, counted in control->lock_null_cycles.
+ */
+#define jack_lock_rt(e) { DEBUG ("acquiring rt lock"); if (pthread_mutex_lock (&e->rt_lock)) { abort (); } }
+#define jack_trylock_rt(e) pthread_mutex_trylock (&e->rt_lock)
+#define jack_unlock_rt(e) { DEBUG ("release rt lock"); if (pthread_mutex_unlock (&e->rt_lock)) { abort (); } }
 
 #if 0
 static inline void jack_rdlock_graph (jack_engine_t* engine)
@@ -252,6 +365,8 @@ void    jack_port_clear_connections(jack_engine_t *engine,
 void jack_port_registration_notify (jack_engine_t *, jack_port_id_t, int);
 void    jack_port_release(jack_engine_t *engine, jack_port_internal_t *);
 void    jack_sort_graph(jack_engine_t *engine);
+int     jack_publish_plan(jack_engine_t *engine);
+void    jack_plan_quiesce(jack_engine_t *engine);
 int     jack_stop_freewheeling(jack_engine_t* engine, int engine_exiting);
 jack_client_internal_t *
 jack_client_by_name(jack_engine_t *engine, const char *name);
@@ -260,6 +375,14 @@ int  jack_deliver_event(jack_engine_t *, jack_client_internal_t *, const jack_ev
 
 void
 jack_engine_signal_problems(jack_engine_t* engine);
+void    jack_engine_watch_client(jack_engine_t *engine,
+				 jack_client_internal_t *client);
+void    jack_engine_unwatch_client(jack_engine_t *engine,
+				   jack_client_internal_t *client);
+void    jack_engine_stats_add_client(jack_engine_t *engine,
+				     jack_client_internal_t *client);
+void    jack_engine_stats_remove_client(jack_engine_t *engine,
+					jack_client_internal_t *client);
 int
 jack_use_driver(jack_engine_t *engine, struct _jack_driver *driver);
 int
@@ -27,6 +27,7 @@
 #define __jack_internal_h__
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <limits.h>
 #include <dlfcn.h>
@@ -76,6 +77,14 @@ const char* jack_clock_source_name (jack_timer_type_t);
     #endif      /* MAXPATHLEN */
 #endif          /* !PATH_MAX */
 
+/* The shared memory structures below are packed, so any field that is
+ * used with atomic operations or as a futex has its alignment given
+ * back explicitly, and checked where the structure is defined.
+ */
+#define JACK_SHM_ALIGNED(n) __attribute__((aligned (n)))
+#define JACK_STATIC_ASSERT(cond, name) \
+	typedef char jack_static_assert_ ## name[(cond) ? 1 : -1]
+
 #ifdef DEBUG_ENABLED
 
 /* grab thread id instead of PID on linux */
@@ -151,9 +160,148 @@ typedef struct {
 
 } POST_PACKED_STRUCTURE jack_frame_timer_t;
 
+#if defined(__linux__) && defined(HAVE_LINUX_FUTEX_H) && !defined(JACK_USE_MACH_THREADS)
+#define JACK_HAVE_FUTEX_WAKEUP 1
+#endif
+
+/* Graph wakeup slots, used in place of the inter-client FIFOs when the
+ * server runs with futex wakeups (see wakeup.h). Slot n corresponds to
+ * FIFO n. Each slot has a cache line to itself.
+ */
+#define JACK_WAKEUP_SLOTS 256
+
+#define JACK_WAKEUP_GRAPH  0x1          /* run process(), as a FIFO byte */
+#define JACK_WAKEUP_EVENT  0x2          /* event pending on event_fd */
+#define JACK_WAKEUP_WAITER 0x80000000   /* someone is asleep on the word */
+
+typedef struct {
+	volatile uint32_t word;
+	uint32_t pad[15];
+} POST_PACKED_STRUCTURE jack_wakeup_slot_t;
+
+/* Per-cycle client timing trace. The engine appends one record per
+ * client that ran in each cycle to a ring in its own shm segment;
+ * readers use jack_get_cycle_trace(). A record at ring position p is
+ * valid when its seq reads 2*p+2 both before and after copying it.
+ */
+#define JACK_TRACE_RECORDS 4096         /* must be a power of two */
+
+#define JACK_TRACE_XRUN    0x1          /* an xrun preceded this cycle */
+#define JACK_TRACE_TIMEOUT 0x2          /* the client timed out */
+
+typedef struct {
+	volatile uint32_t seq;
+	uint32_t cycle;
+	jack_uuid_t client_id;
+	jack_time_t signalled_at;
+	jack_time_t awake_at;
+	jack_time_t finished_at;
+	jack_nframes_t nframes;
+	uint32_t flags;
+} POST_PACKED_STRUCTURE jack_trace_record_t;
+
+typedef struct {
+	uint32_t size;                          /* records in the ring */
+	uint32_t pad;
+	volatile uint64_t head;                 /* next position to write */
+	jack_trace_record_t records[0];
+} POST_PACKED_STRUCTURE jack_trace_header_t;
+
+/* Snapshot of every connection in the graph, in its own shm segment,
+ * republished by the engine whenever the graph is sorted and the
+ * connections differ from the last snapshot. data[] holds nports + 1
+ * row starts followed by the edges: the ports connected to port p, in
+ * either direction, are data[nports + 1 + data[p]] up to (but not
+ * including) data[nports + 1 + data[p + 1]]. generation is odd while
+ * the engine is rewriting the snapshot; readers copy what they need
+ * and start over if it changed meanwhile. If the connections did not
+ * fit in max_edges, complete is 0 and readers have to ask the server.
+ */
+#define JACK_GRAPH_EDGES_PER_PORT 16
+
+typedef struct {
+	volatile uint32_t generation;
+	uint32_t nports;
+	uint32_t max_edges;
+	int32_t complete;
+	uint32_t data[0];
+} POST_PACKED_STRUCTURE jack_graph_snapshot_t;
+
+/* Per-client DSP load. Every rolling interval (about a second) the
+ * engine rewrites the record of each client with what it saw since the
+ * last time: how long process() took from awake_at to finished_at, and
+ * how long the client took to wake up from signalled_at to awake_at.
+ * Records sit in their own shm segment and are stamped like trace
+ * records: seq is odd while the engine is rewriting one. The name goes
+ * last and the record is padded to a multiple of 8 bytes, so that seq
+ * and the counters are aligned in every record of the array.
+ */
+#define JACK_STATS_CLIENTS 256
+#define JACK_STATS_BUCKETS 64
+
+typedef struct {
+	volatile uint32_t seq;
+	int32_t in_use;
+	jack_uuid_t client_id;
+	uint32_t cycles;                /* ran to completion in the window */
+	uint32_t timeouts;
+	float mean_usecs;               /* awake_at .. finished_at */
+	float max_usecs;
+	float p99_usecs;
+	float wake_mean_usecs;          /* signalled_at .. awake_at */
+	float wake_max_usecs;
+	uint32_t reserved;
+	uint32_t wake_histogram[JACK_STATS_BUCKETS];
+	char name[JACK_CLIENT_NAME_SIZE];
+	char pad[(8 - JACK_CLIENT_NAME_SIZE % 8) % 8];
+} POST_PACKED_STRUCTURE jack_client_stats_t;
+
+typedef struct {
+	uint32_t nclients;                      /* records */
+	uint32_t pad;
+	jack_client_stats_t clients[0];
+} POST_PACKED_STRUCTURE jack_stats_header_t;
+
+JACK_STATIC_ASSERT (sizeof(jack_client_stats_t) % 8 == 0, client_stats_size);
+JACK_STATIC_ASSERT (sizeof(jack_stats_header_t) % 8 == 0, stats_header_size);
+
+/* Histogram bucket b counts times from jack_stats_bucket_floor (b) up
+ * to jack_stats_bucket_floor (b + 1) usecs: one bucket per usec below
+ * 4, then four per power of two. The last bucket also takes anything
+ * longer.
+ */
+static inline uint32_t
+jack_stats_bucket (uint64_t usecs)
+{
+	uint32_t e, b;
+
+	if (usecs < 4) {
+		return (uint32_t)usecs;
+	}
+
+	e = 63 - __builtin_clzll (usecs);
+	b = 4 * (e - 1) + ((usecs >> (e - 2)) & 3);
+
+	return b < JACK_STATS_BUCKETS ? b : JACK_STATS_BUCKETS - 1;
+}
+
+static inline uint64_t
+jack_stats_bucket_floor (uint32_t b)
+{
+	if (b < 4) {
+		return b;
+	}
+
+	return (uint64_t)(4 + (b & 3)) << (b / 4 - 1);
+}
+
 /* JACK engine shared memory data structure. */
 typedef struct {
 
+	/* kept first so that the futex words are naturally aligned */
+	jack_wakeup_slot_t wakeup[JACK_WAKEUP_SLOTS];
+	int32_t futex_wakeup;                   /* chain uses wakeup[], not FIFOs */
+
 	jack_transport_state_t transport_state;
 	volatile transport_command_t transport_cmd;
 	transport_command_t previous_cmd;       /* previous transport_cmd */
@@ -185,12 +333,29 @@ typedef struct {
 	float max_delayed_usecs;
 	uint32_t port_max;
 	int32_t engine_ok;
+	volatile uint32_t port_generation JACK_SHM_ALIGNED(4); /* any port name changed */
+	volatile uint32_t cycle JACK_SHM_ALIGNED(4); /* bumped before each process cycle, never 0 */
+	volatile uint32_t lock_null_cycles JACK_SHM_ALIGNED(4);    /* rt_lock was busy */
+	volatile uint32_t problem_null_cycles JACK_SHM_ALIGNED(4); /* client problems */
+	int8_t share_mixdowns;                  /* ports may share identical mixdowns */
+	jack_shm_registry_index_t trace_shm_index; /* cycle trace ring, or -1 */
+	jack_shm_registry_index_t graph_shm_index; /* connection snapshot, or -1 */
+	jack_shm_registry_index_t stats_shm_index; /* client DSP load, or -1 */
 	jack_port_type_id_t n_port_types;
 	jack_port_type_info_t port_types[JACK_MAX_PORT_TYPES];
 	jack_port_shared_t ports[0];
 
 } POST_PACKED_STRUCTURE jack_control_t;
 
+JACK_STATIC_ASSERT (offsetof (jack_control_t, port_generation) % 4 == 0,
+		    port_generation);
+JACK_STATIC_ASSERT (offsetof (jack_control_t, cycle) % 4 == 0,
+		    cycle);
+JACK_STATIC_ASSERT (offsetof (jack_control_t, lock_null_cycles) % 4 == 0,
+		    lock_null_cycles);
+JACK_STATIC_ASSERT (offsetof (jack_control_t, problem_null_cycles) % 4 == 0,
+		    problem_null_cycles);
+
 typedef enum  {
 	BufferSizeChange,
 	SampleRateChange,
@@ -208,7 +373,8 @@ typedef enum  {
 	SaveSession,
 	LatencyCallback,
 	PropertyChange,
-	PortRename
+	PortRename,
+	EventsQueued            /* look in the event ring; needs no answer */
 } JackEventType;
 
 const char* jack_event_type_name (JackEventType);
@@ -234,6 +400,16 @@ typedef struct {
 	} z;
 } POST_PACKED_STRUCTURE jack_event_t;
 
+/* Notifications that need no answer go through a ring in the client's
+ * control block instead of a round trip on the event socket. The
+ * server is the only writer of event_head and the client the only
+ * writer of event_tail, which doubles as the acknowledgement: slots
+ * below it may be reused. The server sends one EventsQueued on the
+ * socket when it adds to a ring the client had emptied; the client
+ * keeps draining until it sees no new head after moving the tail.
+ */
+#define JACK_EVENT_RING_SIZE 32         /* must be a power of two */
+
 typedef enum {
 	ClientInternal, /* connect request just names .so */
 	ClientDriver,   /* code is loaded along with driver */
@@ -247,58 +423,6 @@ typedef enum {
 	Finished
 } jack_client_state_t;
 
-/* JACK client shared memory data structure. */
-typedef volatile struct {
-
-	jack_uuid_t uuid;                       /* w: engine r: engine and client */
-	volatile jack_client_state_t state;     /* w: engine and client r: engine */
-	volatile char name[JACK_CLIENT_NAME_SIZE];
-	volatile char session_command[JACK_PORT_NAME_SIZE];
-	volatile jack_session_flags_t session_flags;
-	volatile ClientType type;               /* w: engine r: engine and client */
-	volatile int8_t active;                 /* w: engine r: engine and client */
-	volatile int8_t dead;                   /* r/w: engine */
-	volatile int8_t timed_out;              /* r/w: engine */
-	volatile int8_t is_timebase;            /* w: engine, r: engine and client */
-	volatile int8_t timebase_new;           /* w: engine and client, r: engine */
-	volatile int8_t is_slowsync;            /* w: engine, r: engine and client */
-	volatile int8_t active_slowsync;        /* w: engine, r: engine and client */
-	volatile int8_t sync_poll;              /* w: engine and client, r: engine */
-	volatile int8_t sync_new;               /* w: engine and client, r: engine */
-	volatile pid_t pid;                     /* w: client r: engine; client pid */
-	volatile pid_t pgrp;                    /* w: client r: engine; client pgrp */
-	volatile uint64_t signalled_at;
-	volatile uint64_t awake_at;
-	volatile uint64_t finished_at;
-	volatile int32_t last_status;        /* w: client, r: engine and client */
-
-	/* indicators for whether callbacks have been set for this client.
-	   We do not include ptrs to the callbacks here (or their arguments)
-	   so that we can avoid 32/64 bit pointer size mismatches between
-	   the jack server and a client. The pointers are in the client-
-	   local structure which is part of the libjack compiled for
-	   either 32 bit or 64 bit clients.
-	 */
-	volatile uint8_t process_cbset;
-	volatile uint8_t thread_init_cbset;
-	volatile uint8_t bufsize_cbset;
-	volatile uint8_t srate_cbset;
-	volatile uint8_t port_register_cbset;
-	volatile uint8_t port_connect_cbset;
-	volatile uint8_t graph_order_cbset;
-	volatile uint8_t xrun_cbset;
-	volatile uint8_t sync_cb_cbset;
-	volatile uint8_t timebase_cb_cbset;
-	volatile uint8_t freewheel_cb_cbset;
-	volatile uint8_t client_register_cbset;
-	volatile uint8_t thread_cb_cbset;
-	volatile uint8_t session_cbset;
-	volatile uint8_t latency_cbset;
-	volatile uint8_t property_cbset;
-	volatile uint8_t port_rename_cbset;
-
-} POST_PACKED_STRUCTURE jack_client_control_t;
-
 typedef struct {
 
 	uint32_t protocol_v;            /* protocol version, must go first */
@@ -383,9 +507,24 @@ typedef enum {
 	SessionReply = 31,
 	SessionHasCallback = 32,
 	PropertyChangeNotify = 33,
-	PortNameChanged = 34
+	PortNameChanged = 34,
+	ConnectPortsMany = 35,
+	EnableRequestRing = 36,
+	RequestsQueued = 37
 } RequestType;
 
+/* One step of a ConnectPortsMany request. External clients send the
+ * steps right after the request itself, the way a property key
+ * follows a PropertyChangeNotify.
+ */
+typedef struct {
+	char source_port[JACK_PORT_NAME_SIZE];
+	char destination_port[JACK_PORT_NAME_SIZE];
+	int32_t connect;        /* 1 to connect, 0 to disconnect */
+} POST_PACKED_STRUCTURE jack_connection_op_t;
+
+#define JACK_CONNECTION_OPS_MAX 4096    /* per request */
+
 struct _jack_request {
 
 	//RequestType type;
@@ -421,6 +560,11 @@ struct _jack_request {
 			                       comparing the 64 and 32 bit versions.
 			                     */
 		} POST_PACKED_STRUCTURE port_connections;
+		struct {
+			uint32_t nops;
+			jack_connection_op_t *ops; /* not delivered inline to server,
+			                              see oop_client_deliver_request() */
+		} POST_PACKED_STRUCTURE connections;
 		struct {
 			jack_uuid_t client_id;
 			int32_t conditional;
@@ -452,6 +596,131 @@ struct _jack_request {
 	int32_t status;
 } POST_PACKED_STRUCTURE;
 
+/* Clients that opt in with JACK_SHM_REQUESTS pass simple requests
+ * through a ring in their control block rather than over the request
+ * socket. The client is the only writer of request_head and the server
+ * the only writer of request_tail; a slot below the tail holds the
+ * reply. The client rings the doorbell, a bare RequestsQueued on the
+ * socket, only when it finds request_armed set, which the server does
+ * once it has drained the ring. Replies are signalled on request_tail
+ * with a futex, so this is only used where futexes are.
+ */
+#define JACK_REQUEST_RING_SIZE 4        /* must be a power of two */
+
+static inline int
+jack_request_via_shm (uint32_t type)
+{
+	/* nothing with trailing data or a reply of its own */
+	switch (type) {
+	case RegisterPort:
+	case UnRegisterPort:
+	case ConnectPorts:
+	case DisconnectPorts:
+	case DisconnectPort:
+	case RecomputeTotalLatencies:
+	case RecomputeTotalLatency:
+	case SetSyncTimeout:
+	case GetClientByUUID:
+	case GetUUIDByClientName:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* JACK client shared memory data structure. */
+typedef volatile struct {
+
+	jack_uuid_t uuid;                       /* w: engine r: engine and client */
+	volatile jack_client_state_t state;     /* w: engine and client r: engine */
+	volatile char name[JACK_CLIENT_NAME_SIZE];
+	volatile char session_command[JACK_PORT_NAME_SIZE];
+	volatile jack_session_flags_t session_flags;
+	volatile ClientType type;               /* w: engine r: engine and client */
+	volatile int8_t active;                 /* w: engine r: engine and client */
+	volatile int8_t dead;                   /* r/w: engine */
+	volatile int8_t timed_out;              /* r/w: engine */
+	volatile int8_t is_timebase;            /* w: engine, r: engine and client */
+	volatile int8_t timebase_new;           /* w: engine and client, r: engine */
+	volatile int8_t is_slowsync;            /* w: engine, r: engine and client */
+	volatile int8_t active_slowsync;        /* w: engine, r: engine and client */
+	volatile int8_t sync_poll;              /* w: engine and client, r: engine */
+	volatile int8_t sync_new;               /* w: engine and client, r: engine */
+	volatile int8_t events_elsewhere;       /* w: client r: engine; events not handled by the process thread */
+	volatile pid_t pid;                     /* w: client r: engine; client pid */
+	volatile pid_t pgrp;                    /* w: client r: engine; client pgrp */
+	volatile uint64_t signalled_at;
+	volatile uint64_t awake_at;
+	volatile uint64_t finished_at;
+	volatile int32_t last_status;        /* w: client, r: engine and client */
+
+	/* indicators for whether callbacks have been set for this client.
+	   We do not include ptrs to the callbacks here (or their arguments)
+	   so that we can avoid 32/64 bit pointer size mismatches between
+	   the jack server and a client. The pointers are in the client-
+	   local structure which is part of the libjack compiled for
+	   either 32 bit or 64 bit clients.
+	 */
+	volatile uint8_t process_cbset;
+	volatile uint8_t thread_init_cbset;
+	volatile uint8_t bufsize_cbset;
+	volatile uint8_t srate_cbset;
+	volatile uint8_t port_register_cbset;
+	volatile uint8_t port_connect_cbset;
+	volatile uint8_t graph_order_cbset;
+	volatile uint8_t xrun_cbset;
+	volatile uint8_t sync_cb_cbset;
+	volatile uint8_t timebase_cb_cbset;
+	volatile uint8_t freewheel_cb_cbset;
+	volatile uint8_t client_register_cbset;
+	volatile uint8_t thread_cb_cbset;
+	volatile uint8_t session_cbset;
+	volatile uint8_t latency_cbset;
+	volatile uint8_t property_cbset;
+	volatile uint8_t port_rename_cbset;
+
+	volatile uint32_t event_head JACK_SHM_ALIGNED(64); /* w: engine r: engine and client */
+	volatile uint32_t event_tail JACK_SHM_ALIGNED(64); /* w: client r: engine and client */
+	jack_event_t event_ring[JACK_EVENT_RING_SIZE];
+
+	volatile uint32_t request_head JACK_SHM_ALIGNED(64);  /* w: client r: engine and client */
+	volatile uint32_t request_tail JACK_SHM_ALIGNED(64);  /* w: engine r: engine and client */
+	volatile uint32_t request_armed JACK_SHM_ALIGNED(64); /* w: engine and client */
+	volatile uint32_t request_waiters JACK_SHM_ALIGNED(4); /* w: client r: engine */
+	jack_request_t request_ring[JACK_REQUEST_RING_SIZE];
+
+} POST_PACKED_STRUCTURE jack_client_control_t;
+
+/* the event ring indices are used with atomics, and each is written
+   by a different side */
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, event_head) % 4 == 0,
+		    event_head);
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, event_tail) % 4 == 0,
+		    event_tail);
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, event_head) / 64 !=
+		    offsetof (jack_client_control_t, event_tail) / 64,
+		    event_tail_own_line);
+
+/* the request ring indices are used with atomics and futexes, which
+   fail with EINVAL on a misaligned word. request_tail is what clients
+   sleep on and the server writes once per request, so it is kept
+   clear of everything the clients write */
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, request_head) % 4 == 0,
+		    request_head);
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, request_tail) % 4 == 0,
+		    request_tail);
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, request_armed) % 4 == 0,
+		    request_armed);
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, request_waiters) % 4 == 0,
+		    request_waiters);
+JACK_STATIC_ASSERT (offsetof (jack_client_control_t, request_tail) / 64 !=
+		    offsetof (jack_client_control_t, request_head) / 64 &&
+		    offsetof (jack_client_control_t, request_tail) / 64 !=
+		    offsetof (jack_client_control_t, request_armed) / 64 &&
+		    offsetof (jack_client_control_t, request_tail) / 64 !=
+		    offsetof (jack_client_control_t, request_waiters) / 64,
+		    request_tail_own_line);
+
 /* Per-client structure allocated in the server's address space.
  * It's here because its not part of the engine structure.
  */
@@ -469,8 +738,22 @@ typedef struct _jack_client_internal {
 	JSList    *sortfeeds;   /* protected by engine->client_lock */
 	int fedcount;
 	int tfedcount;
+	unsigned long sort_visit; /* jack_client_feeds_transitive() stamp */
+	int subgraph_start_slot;
+	int subgraph_wait_slot;
+	int wakeup_slot;        /* futex slot the client is waiting on, or -1 */
 	jack_shm_info_t control_shm;
 	unsigned long execution_order;
+	long chain_order;       /* position jack_rechain_graph() gave it, or -1 */
+	int chain_upstream;     /* ... and whether its upstream is jackd */
+	int chain_moved;        /* ... and whether it must be told first */
+	long reorder_order;     /* position in the last GraphReordered sent, or -1 */
+	int reorder_upstream;   /* ... and whether its upstream was jackd */
+	int plan_index;         /* scratch for jack_publish_plan() */
+	int retiring;           /* being removed: never chained again */
+	int latency_dirty;      /* ports changed: owed both LatencyCallbacks */
+	int shm_requests;       /* client sends requests via control->request_ring */
+	int stats_slot;         /* DSP load record, or -1 */
 	struct  _jack_client_internal *next_client;     /* not a linked list! */
 	dlhandle handle;
 	int (*initialize)(jack_client_t*, const char*); /* int. clients only */
@@ -540,6 +823,8 @@ extern jack_port_t *jack_port_by_id_int(const jack_client_t *client,
 extern jack_port_t *jack_port_by_name_int(jack_client_t *client,
                                           const char *port_name, int* free);
 extern int jack_port_name_equals(jack_port_shared_t* port, const char* target);
+extern const char *jack_port_name_canonical(const char* target, char *buf,
+					    size_t size);
 
 /** Get the size (in bytes) of the data structure used to store
  *  MIDI events internally.
@@ -548,6 +833,92 @@ extern size_t jack_midi_internal_event_size();
 
 extern int jack_client_handle_latency_callback(jack_client_t *client, jack_event_t *event, int is_driver);
 
+/* Copy trace records starting at *position into records[], up to max.
+ * *position is advanced past what was consumed; records that were
+ * overwritten before they could be read are skipped. Returns the
+ * number of records copied, or -1 if the trace is unavailable.
+ */
+extern int jack_get_cycle_trace(jack_client_t *client,
+				jack_trace_record_t *records,
+				uint32_t max, uint64_t *position);
+extern void jack_trace_detach(jack_client_t *client);
+
+/* Null cycles the engine has run so far, because rt_lock was held by
+ * a graph change (*lock) or because of client problems (*problem).
+ */
+extern void jack_get_null_cycles(jack_client_t *client,
+				 uint32_t *lock, uint32_t *problem);
+
+/* Read the connections of port_id from the engine's connection
+ * snapshot, without a request. On success *ports is set as
+ * jack_port_get_all_connections() would return it and 0 is returned;
+ * -1 means the snapshot cannot answer and the server must be asked.
+ */
+extern int jack_graph_get_connections(jack_client_t *client,
+				      jack_port_id_t port_id,
+				      const char ***ports);
+
+/* Store the generation of the connection snapshot in *generation. It
+ * changes whenever any connection is made or broken, so pollers can
+ * skip rereading the graph while it stays the same. Returns 0, or -1
+ * if the server does not publish a snapshot.
+ */
+extern int jack_get_connection_generation(jack_client_t *client,
+					  uint32_t *generation);
+extern void jack_graph_detach(jack_client_t *client);
+
+/* Copy the DSP load records of up to max clients into stats[]. Returns
+ * the number copied, or -1 if the server does not publish them.
+ * jackctl_server_get_client_stats() does the same inside the server.
+ */
+extern int jack_get_client_stats(jack_client_t *client,
+				 jack_client_stats_t *stats, uint32_t max);
+extern int jack_stats_copy(jack_stats_header_t *header,
+			   jack_client_stats_t *stats, uint32_t max);
+extern void jack_stats_detach(jack_client_t *client);
+
+/* Silence tracking. An output port is known silent in a cycle once its
+ * writer has called jack_port_set_silent() in that cycle; the mark
+ * lapses by itself when the next cycle starts. An input port is known
+ * silent when it has no connections or all of its sources are.
+ * Consumers that skip work on silent buffers count the bytes they did
+ * not touch, per kind of work, in this process.
+ */
+typedef enum {
+	JackSilenceMixdown,             /* sources left out of a mixdown */
+	JackSilenceConvert,             /* samples not converted for a device */
+	JackSilenceEncode,              /* samples not encoded for the network */
+	JackSilenceKinds
+} jack_silence_kind_t;
+
+typedef struct {
+	uint64_t skipped_bytes[JackSilenceKinds];
+} jack_silence_stats_t;
+
+extern int jack_port_set_silent(jack_port_t *port, jack_nframes_t nframes);
+extern int jack_port_is_silent(jack_port_t *port);
+extern void jack_silence_skipped(jack_silence_kind_t kind, size_t bytes);
+extern void jack_get_silence_stats(jack_silence_stats_t *stats);
+
+/* Connect (or disconnect) sources[i] to destinations[i] for every i
+ * below count, sorting the graph and notifying clients of the new
+ * order once for the whole lot instead of once per connection. Either
+ * every pair is done or none is; pairs that are already connected
+ * count as connected. Batches larger than JACK_CONNECTION_OPS_MAX go
+ * to the server in pieces of that size, each of which is all or
+ * nothing, and the first piece that fails ends the call. Returns 0 if
+ * every pair was done, the number of pairs that were not otherwise,
+ * or -1 if the server could not be asked.
+ */
+extern int jack_connect_many(jack_client_t *client,
+			     const char **sources,
+			     const char **destinations,
+			     size_t count);
+extern int jack_disconnect_many(jack_client_t *client,
+				const char **sources,
+				const char **destinations,
+				size_t count);
+
 #ifdef __GNUC__
 #  define likely(x)     __builtin_expect ((x), 1)
 #  define unlikely(x)   __builtin_expect ((x), 0)
@@ -98,6 +98,12 @@ sample_memcpy (jack_default_audio_sample_t *dst, jack_default_audio_sample_t *sr
 	memcpy (dst, src, cnt * sizeof(jack_default_audio_sample_t));
 }
 
+void sample_mix_move(char *dst, const jack_default_audio_sample_t **srcs, int nsrcs,
+		     unsigned long offset, unsigned long nsamples, unsigned long dst_skip,
+		     dither_state_t *state,
+		     void (*move)(char *, jack_default_audio_sample_t *, unsigned long, unsigned long, dither_state_t *),
+		     jack_default_audio_sample_t *copy);
+
 void memset_interleave(char *dst, char val, unsigned long bytes, unsigned long unit_bytes, unsigned long skip_bytes);
 void memcpy_fake(char *dst, char *src, unsigned long src_bytes, unsigned long foo, unsigned long bar);
 
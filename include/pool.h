@@ -21,8 +21,33 @@
 #define __jack_pool_h__
 
 #include <sys/types.h>
+#include <stdint.h>
+
+/* Blocks up to JACK_POOL_MAX_BLOCK bytes come from locked, size-classed
+ * free lists and can be allocated and released from a realtime thread
+ * as long as enough of them were set aside with jack_pool_reserve().
+ * Larger requests, and requests that find their class empty, fall back
+ * to the system allocator and are counted as misses.
+ */
+
+#define JACK_POOL_MIN_BLOCK     64
+#define JACK_POOL_CLASSES       11      /* 64 bytes .. 64 kB */
+#define JACK_POOL_MAX_BLOCK     (JACK_POOL_MIN_BLOCK << (JACK_POOL_CLASSES - 1))
+
+typedef struct {
+	uint64_t allocs;
+	uint64_t releases;
+	uint64_t misses;                /* served by the system allocator */
+	size_t   reserved_bytes;        /* carved from the arena so far */
+	size_t   locked_bytes;          /* ... of which mlock()ed */
+	uint32_t free_blocks[JACK_POOL_CLASSES]; /* on the shared lists */
+} jack_pool_stats_t;
 
 void * jack_pool_alloc(size_t bytes);
 void   jack_pool_release(void *);
+int    jack_pool_reserve(size_t bytes, unsigned int count);
+int    jack_pool_size_class(size_t bytes);
+void   jack_pool_thread_init(void);
+void   jack_pool_get_stats(jack_pool_stats_t *stats);
 
 #endif /* __jack_pool_h__ */
@@ -108,6 +108,7 @@ typedef struct _jack_port_shared {
 	volatile jack_nframes_t total_latency;
 	volatile jack_latency_range_t playback_latency;
 	volatile jack_latency_range_t capture_latency;
+	volatile uint32_t silent_cycle;         /* buffer known silent in this cycle */
 	volatile uint8_t monitor_requests;
 
 	char has_mixdown;               /* port has a mixdown function */
@@ -154,6 +155,16 @@ struct _jack_port {
 	jack_port_functions_t fptr;
 	pthread_mutex_t connection_lock;
 	JSList                   *connections;
+
+	volatile uint32_t        *port_generation; /* bumped on name changes */
+
+	/* input mixdown of the current cycle; see jack_port_get_buffer() */
+	volatile uint32_t        *cycle;        /* engine cycle counter */
+	uint32_t                  mix_cycle;    /* cycle mix_result is for, 0 = none */
+	jack_nframes_t            mix_nframes;  /* frames valid in mix_result */
+	void                     *mix_result;   /* mix_buffer, or a shared one */
+	uint32_t                  mix_key;      /* hash of the sources, 0 = unshared */
+	int                       mix_cache;    /* no source is written by us */
 };
 
 /*  Inline would be cleaner, but it needs to be fast even in
@@ -165,9 +176,13 @@ struct _jack_port {
 		 *(p)->client_segment_base + (p)->shared->offset))
 #define jack_output_port_buffer(p) \
 	((void*)(*(p)->client_segment_base + (p)->shared->offset))
+#define jack_output_port_silent(p) \
+	(*(p)->cycle != 0 && (p)->shared->silent_cycle == *(p)->cycle)
 
 /* not for use by JACK applications */
 size_t jack_port_type_buffer_size(jack_port_type_info_t* port_type_info, jack_nframes_t nframes);
+int jack_port_mix_sources(jack_port_t *port, jack_nframes_t nframes,
+			  const jack_default_audio_sample_t **srcs, int max);
 
 #endif /* __jack_port_h__ */
 
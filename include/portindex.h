@@ -0,0 +1,60 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+ */
+
+#ifndef __jack_portindex_h__
+#define __jack_portindex_h__
+
+/* Hash index from port name (and aliases) to port id.
+ *
+ * Each port has three entries, one each for its name, alias1 and
+ * alias2, numbered 3 * port_id + n. An entry is on at most one bucket
+ * chain. Names and aliases live in shared memory and clients may change
+ * them without telling anybody, so the index is only a hint: every hit
+ * is checked against the port itself, and callers must be prepared to
+ * fall back to a scan on a miss.
+ */
+
+#include <stdint.h>
+
+#include "port.h"
+
+typedef struct _jack_port_index {
+	uint32_t nports;
+	uint32_t mask;          /* buckets - 1 */
+	int32_t *buckets;       /* first entry, or -1 */
+	int32_t *next;          /* next entry on the same chain, or -1 */
+	uint32_t *hash;         /* hash the entry was filed under */
+	char *linked;           /* entry is on a chain */
+} jack_port_index_t;
+
+int  jack_port_index_init(jack_port_index_t *index, uint32_t nports);
+void jack_port_index_free(jack_port_index_t *index);
+
+/* (re)file port under its current name and aliases */
+void jack_port_index_update(jack_port_index_t *index,
+			    jack_port_shared_t *port);
+void jack_port_index_remove(jack_port_index_t *index, jack_port_id_t id);
+
+/* drop everything and file every port that is in use */
+void jack_port_index_rebuild(jack_port_index_t *index,
+			     jack_port_shared_t *ports);
+
+jack_port_shared_t *jack_port_index_find(jack_port_index_t *index,
+					 jack_port_shared_t *ports,
+					 const char *name);
+
+#endif /* __jack_portindex_h__ */
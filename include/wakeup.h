@@ -0,0 +1,128 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+ */
+
+#ifndef __jack_wakeup_h__
+#define __jack_wakeup_h__
+
+/* Futex based graph wakeups.
+ *
+ * Slot n of jack_control_t.wakeup[] stands in for inter-client FIFO
+ * n: whoever would have written a byte to FIFO n sets a bit in the
+ * slot instead, and whoever would have polled it waits on the futex.
+ * A waiter advertises itself with JACK_WAKEUP_WAITER so that the
+ * signalling side only enters the kernel when somebody is asleep.
+ */
+
+#include "internal.h"
+
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static inline void
+jack_wakeup_signal (jack_wakeup_slot_t *slot, uint32_t bits)
+{
+	if (__atomic_fetch_or (&slot->word, bits, __ATOMIC_RELEASE)
+	    & JACK_WAKEUP_WAITER) {
+		syscall (SYS_futex, &slot->word, FUTEX_WAKE, INT_MAX,
+			 NULL, NULL, 0);
+	}
+}
+
+static inline void
+jack_wakeup_clear (jack_wakeup_slot_t *slot, uint32_t bits)
+{
+	__atomic_fetch_and (&slot->word, ~bits, __ATOMIC_RELAXED);
+}
+
+/* Wait until any of `mask' is set in the slot, clear those bits and
+ * return them. Returns 0 if nothing arrived within `timeout_usecs'.
+ */
+static inline uint32_t
+jack_wakeup_wait (jack_wakeup_slot_t *slot, uint32_t mask,
+		  uint64_t timeout_usecs)
+{
+	struct timespec ts;
+	uint32_t word;
+
+	for (;;) {
+		word = __atomic_load_n (&slot->word, __ATOMIC_ACQUIRE);
+
+		if (word & mask) {
+			word = __atomic_fetch_and (&slot->word,
+						   ~(mask | JACK_WAKEUP_WAITER),
+						   __ATOMIC_ACQUIRE);
+			return word & mask;
+		}
+
+		if (!(word & JACK_WAKEUP_WAITER)) {
+			if (!__atomic_compare_exchange_n (
+				    &slot->word, &word,
+				    word | JACK_WAKEUP_WAITER, 0,
+				    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				continue;
+			}
+			word |= JACK_WAKEUP_WAITER;
+		}
+
+		ts.tv_sec = timeout_usecs / 1000000;
+		ts.tv_nsec = (timeout_usecs % 1000000) * 1000;
+
+		if (syscall (SYS_futex, &slot->word, FUTEX_WAIT, word,
+			     &ts, NULL, 0) < 0 && errno == ETIMEDOUT) {
+			/* one last look before giving up, and stop
+			   asking to be woken */
+			word = __atomic_fetch_and (&slot->word,
+						   ~(mask | JACK_WAKEUP_WAITER),
+						   __ATOMIC_ACQUIRE);
+			return word & mask;
+		}
+
+		/* woken, interrupted or the word changed under us:
+		   look again */
+	}
+}
+
+/* Plain futex calls on a 32 bit word in shared memory, for waiters
+ * that keep their own count of sleepers.
+ */
+static inline void
+jack_futex_wake (volatile uint32_t *word)
+{
+	syscall (SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static inline void
+jack_futex_wait (volatile uint32_t *word, uint32_t val,
+		 uint64_t timeout_usecs)
+{
+	struct timespec ts;
+
+	ts.tv_sec = timeout_usecs / 1000000;
+	ts.tv_nsec = (timeout_usecs % 1000000) * 1000;
+
+	syscall (SYS_futex, word, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+#endif /* JACK_HAVE_FUTEX_WAKEUP */
+
+#endif /* __jack_wakeup_h__ */
@@ -183,6 +183,15 @@ jack_remove_client (jack_engine_t *engine, jack_client_internal_t *client)
 
 	VERBOSE (engine, "removing client \"%s\"", client->control->name);
 
+	/* take it out of the cycle before anything else; it stays in
+	   the plan, unchained, until it is off the client list */
+
+	client->retiring = 1;
+	jack_publish_plan (engine);
+
+	/* a cycle started before may still be about to call it */
+	jack_plan_quiesce (engine);
+
 	if (client->control->type == ClientInternal) {
 		/* unload it while its still a regular client */
 
@@ -213,6 +222,7 @@ jack_remove_client (jack_engine_t *engine, jack_client_internal_t *client)
 
 		/* try to force the server thread to return from poll */
 
+		jack_engine_unwatch_client (engine, client);
 		close (client->event_fd);
 		close (client->request_fd);
 	}
@@ -230,6 +240,10 @@ jack_remove_client (jack_engine_t *engine, jack_client_internal_t *client)
 
 	VERBOSE (engine, "after: client list contains %d", jack_slist_length (engine->clients));
 
+	jack_publish_plan (engine);
+
+	/* ... or to look at its control block */
+	jack_plan_quiesce (engine);
 	jack_client_delete (engine, client);
 
 	if (engine->temporary) {
@@ -268,15 +282,16 @@ jack_remove_client (jack_engine_t *engine, jack_client_internal_t *client)
 int
 jack_check_clients (jack_engine_t* engine, int with_timeout_check)
 {
-	/* CALLER MUST HOLD graph read lock */
+	/* called from the cycle, which has acquired engine->plan_in_use */
 
-	JSList* node;
+	jack_plan_t *plan = engine->plan_in_use;
 	jack_client_internal_t* client;
+	unsigned int n;
 	int errs = 0;
 
-	for (node = engine->clients; node; node = jack_slist_next (node)) {
+	for (n = 0; n < plan->nclients; n++) {
 
-		client = (jack_client_internal_t*)node->data;
+		client = plan->clients[n].client;
 
 		if (client->error) {
 			VERBOSE (engine, "client %s already marked with error = %d\n", client->control->name, client->error);
@@ -577,7 +592,19 @@ jack_setup_client_control (jack_engine_t *engine, int fd, ClientType type, const
 	client->ports = 0;
 	client->truefeeds = 0;
 	client->sortfeeds = 0;
+	client->sort_visit = 0;
 	client->execution_order = UINT_MAX;
+	client->chain_order = -1;
+	client->chain_upstream = -1;
+	client->chain_moved = 0;
+	client->reorder_order = -1;
+	client->reorder_upstream = -1;
+	client->plan_index = -1;
+	client->retiring = 0;
+	client->latency_dirty = 1;
+	client->subgraph_start_slot = -1;
+	client->subgraph_wait_slot = -1;
+	client->wakeup_slot = -1;
 	client->next_client = NULL;
 	client->handle = NULL;
 	client->finish = NULL;
@@ -586,8 +613,19 @@ jack_setup_client_control (jack_engine_t *engine, int fd, ClientType type, const
 
 	if (type != ClientExternal) {
 
+		/* the ring indices sit on cache lines of their own */
+#ifdef HAVE_POSIX_MEMALIGN
+		void *control;
+
+		if (posix_memalign (&control, 64,
+				    sizeof(jack_client_control_t))) {
+			control = NULL;
+		}
+		client->control = (jack_client_control_t*)control;
+#else
 		client->control = (jack_client_control_t*)
 				  malloc (sizeof(jack_client_control_t));
+#endif
 
 	} else {
 
@@ -615,6 +653,7 @@ jack_setup_client_control (jack_engine_t *engine, int fd, ClientType type, const
 	client->control->active = 0;
 	client->control->dead = FALSE;
 	client->control->timed_out = 0;
+	client->control->events_elsewhere = 0;
 
 	if (jack_uuid_empty (uuid)) {
 		client->control->uuid = jack_client_uuid_generate ();
@@ -623,6 +662,7 @@ jack_setup_client_control (jack_engine_t *engine, int fd, ClientType type, const
 	}
 
 	strcpy ((char*)client->control->name, name);
+	jack_engine_stats_add_client (engine, client);
 	client->subgraph_start_fd = -1;
 	client->subgraph_wait_fd = -1;
 
@@ -640,6 +680,12 @@ jack_setup_client_control (jack_engine_t *engine, int fd, ClientType type, const
 	client->control->session_cbset = FALSE;
 	client->control->property_cbset = FALSE;
 	client->control->latency_cbset = FALSE;
+	client->control->event_head = 0;
+	client->control->event_tail = 0;
+	client->control->request_head = 0;
+	client->control->request_tail = 0;
+	client->control->request_armed = 0;
+	client->control->request_waiters = 0;
 
 #if 0
 	if (type != ClientExternal) {
@@ -761,6 +807,8 @@ setup_client (jack_engine_t *engine, ClientType type, char *name,
 	/* add new client to the clients list */
 	jack_lock_graph (engine);
 	engine->clients = jack_slist_prepend (engine->clients, client);
+	jack_publish_plan (engine);
+	jack_engine_watch_client (engine, client);
 	jack_engine_reset_rolling_usecs (engine);
 
 	if (jack_client_is_internal (client)) {
@@ -1108,6 +1156,8 @@ jack_client_delete (jack_engine_t *engine, jack_client_internal_t *client)
 	 */
 	jack_property_change_notify (engine, PropertyDeleted, uuid, NULL);
 
+	jack_engine_stats_remove_client (engine, client);
+
 	if (jack_client_is_internal (client)) {
 
 		free (client->private_client);
@@ -116,6 +116,22 @@ struct jackctl_server {
 	/* int, timeout thres... */
 	union jackctl_parameter_value timothres;
 	union jackctl_parameter_value default_timothres;
+
+	/* bool, run independent subgraphs in parallel */
+	union jackctl_parameter_value parallel;
+	union jackctl_parameter_value default_parallel;
+
+	/* bool, chain clients through futexes instead of FIFOs */
+	union jackctl_parameter_value futex_wakeup;
+	union jackctl_parameter_value default_futex_wakeup;
+
+	/* bool, let ports that are never live together share buffers */
+	union jackctl_parameter_value share_buffers;
+	union jackctl_parameter_value default_share_buffers;
+
+	/* bool, mix input ports with the same sources only once */
+	union jackctl_parameter_value share_mixdowns;
+	union jackctl_parameter_value default_share_mixdowns;
 };
 
 struct jackctl_driver {
@@ -1049,6 +1065,62 @@ jackctl_server_t * jackctl_server_create (
 		goto fail_free_parameters;
 	}
 
+	value.b = false;
+	if (jackctl_add_parameter (
+		    &server_ptr->parameters,
+		    'G',
+		    "parallel",
+		    "run independent subgraphs in parallel",
+		    "",
+		    JackParamBool,
+		    &server_ptr->parallel,
+		    &server_ptr->default_parallel,
+		    value, NULL) == NULL) {
+		goto fail_free_parameters;
+	}
+
+	value.b = false;
+	if (jackctl_add_parameter (
+		    &server_ptr->parameters,
+		    'W',
+		    "futex-wakeup",
+		    "wake clients through futexes instead of FIFOs",
+		    "",
+		    JackParamBool,
+		    &server_ptr->futex_wakeup,
+		    &server_ptr->default_futex_wakeup,
+		    value, NULL) == NULL) {
+		goto fail_free_parameters;
+	}
+
+	value.b = false;
+	if (jackctl_add_parameter (
+		    &server_ptr->parameters,
+		    'B',
+		    "share-buffers",
+		    "share audio buffers between ports that are never live at once",
+		    "",
+		    JackParamBool,
+		    &server_ptr->share_buffers,
+		    &server_ptr->default_share_buffers,
+		    value, NULL) == NULL) {
+		goto fail_free_parameters;
+	}
+
+	value.b = false;
+	if (jackctl_add_parameter (
+		    &server_ptr->parameters,
+		    'x',
+		    "share-mixdowns",
+		    "mix input ports that have the same sources only once per cycle",
+		    "",
+		    JackParamBool,
+		    &server_ptr->share_mixdowns,
+		    &server_ptr->default_share_mixdowns,
+		    value, NULL) == NULL) {
+		goto fail_free_parameters;
+	}
+
 	//TODO: need
 	//JackServerGlobals::on_device_acquire = on_device_acquire;
 	//JackServerGlobals::on_device_release = on_device_release;
@@ -1154,7 +1226,10 @@ jackctl_server_start (
 						   server_ptr->do_mlock.b, server_ptr->do_unlock.b, server_ptr->name.str,
 						   server_ptr->temporary.b, server_ptr->verbose.b, server_ptr->client_timeout.i,
 						   server_ptr->port_max.i, getpid (), frame_time_offset,
-						   server_ptr->nozombies.b, server_ptr->timothres.ui, drivers)) == 0) {
+						   server_ptr->nozombies.b, server_ptr->timothres.ui,
+						   server_ptr->parallel.b, server_ptr->futex_wakeup.b,
+						   server_ptr->share_buffers.b,
+						   server_ptr->share_mixdowns.b, drivers)) == 0) {
 		jack_error ("cannot create engine");
 		goto fail_unregister;
 	}
@@ -1414,6 +1489,23 @@ const JSList * jackctl_internal_get_parameters (jackctl_internal_t *internal_ptr
 	return internal_ptr->parameters;
 }
 
+/* Copy the DSP load records of up to max clients into stats[], see
+ * jack_get_client_stats(). Returns the number copied, or -1 if the
+ * server is not running or does not keep them.
+ */
+int
+jackctl_server_get_client_stats (
+	jackctl_server_t * server_ptr,
+	jack_client_stats_t * stats,
+	uint32_t max)
+{
+	if (server_ptr->engine == NULL || server_ptr->engine->stats == NULL) {
+		return -1;
+	}
+
+	return jack_stats_copy (server_ptr->engine->stats, stats, max);
+}
+
 bool jackctl_server_load_internal (
 	jackctl_server_t * server_ptr,
 	jackctl_internal_t * internal)
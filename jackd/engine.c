@@ -48,6 +48,7 @@
 #include "messagebuffer.h"
 #include "driver.h"
 #include "shm.h"
+#include "wakeup.h"
 
 #include <sysdeps/poll.h>
 #include <sysdeps/ipc.h>
@@ -67,6 +68,10 @@
 
 #include "libjack/local.h"
 
+#ifdef JACK_USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 typedef struct {
 
 	jack_port_internal_t *source;
@@ -91,6 +96,9 @@ static jack_port_internal_t *jack_get_port_by_name(jack_engine_t *,
 						   const char *name);
 static int  jack_rechain_graph(jack_engine_t *engine);
 static void jack_clear_fifos(jack_engine_t *engine);
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+static void jack_clear_wakeups(jack_engine_t *engine);
+#endif
 static int  jack_port_do_connect(jack_engine_t *engine,
 				 const char *source_port,
 				 const char *destination_port);
@@ -99,6 +107,9 @@ static int  jack_port_do_disconnect(jack_engine_t *engine,
 				    const char *destination_port);
 static int  jack_port_do_disconnect_all(jack_engine_t *engine,
 					jack_port_id_t);
+static int  jack_port_do_connect_many(jack_engine_t *engine,
+				      jack_connection_op_t *ops,
+				      uint32_t nops);
 static int  jack_port_do_unregister(jack_engine_t *engine, jack_request_t *);
 static int  jack_port_do_register(jack_engine_t *engine, jack_request_t *, int);
 static int  jack_do_get_port_connections(jack_engine_t *engine,
@@ -110,6 +121,9 @@ static int  jack_send_connection_notification(jack_engine_t *,
 					      jack_uuid_t,
 					      jack_port_id_t,
 					      jack_port_id_t, int);
+static int  jack_post_event(jack_engine_t *engine,
+			    jack_client_internal_t *client,
+			    const jack_event_t *event);
 static void jack_deliver_event_to_all(jack_engine_t *engine,
 				      jack_event_t *event);
 static void jack_notify_all_port_interested_clients(jack_engine_t *engine,
@@ -125,12 +139,12 @@ static int   jack_run_one_cycle(jack_engine_t *engine, jack_nframes_t nframes,
 				float delayed_usecs);
 static void jack_engine_delay(jack_engine_t *engine,
 			      float delayed_usecs);
+static void jack_deliver_xruns(jack_engine_t *engine);
+static void jack_wake_server_thread(jack_engine_t* engine);
 static void jack_engine_driver_exit(jack_engine_t* engine);
 static int  jack_start_freewheeling(jack_engine_t* engine, jack_uuid_t);
 static int jack_client_feeds_transitive(jack_client_internal_t *source,
 					jack_client_internal_t *dest);
-static int jack_client_sort(jack_client_internal_t *a,
-			    jack_client_internal_t *b);
 static void jack_check_acyclic(jack_engine_t* engine);
 static void jack_compute_all_port_total_latencies(jack_engine_t *engine);
 static void jack_compute_port_total_latency(jack_engine_t *engine, jack_port_shared_t*);
@@ -141,7 +155,10 @@ static void jack_do_get_client_by_uuid(jack_engine_t *engine, jack_request_t *re
 static void jack_do_get_uuid_by_client_name(jack_engine_t *engine, jack_request_t *req);
 static void jack_do_reserve_name(jack_engine_t *engine, jack_request_t *req);
 static void jack_do_session_reply(jack_engine_t *engine, jack_request_t *req );
-static void jack_compute_new_latency(jack_engine_t *engine);
+static void jack_compute_new_latency(jack_engine_t *engine, int force);
+static void jack_plan_shared_buffers(jack_engine_t *engine);
+static void jack_apply_shared_buffers(jack_engine_t *engine);
+static void jack_share_port_buffers(jack_engine_t *engine);
 static int jack_do_has_session_cb(jack_engine_t *engine, jack_request_t *req);
 
 static inline int
@@ -390,7 +407,10 @@ jack_engine_place_port_buffers (jack_engine_t* engine,
 			if (port->in_use &&
 			    (port->flags & JackPortIsOutput) &&
 			    port->ptype_id == ptid) {
-				bi = engine->internal_ports[i].buffer_info;
+				jack_port_internal_t *iport =
+					&engine->internal_ports[i];
+				bi = (iport->live_buffer ?
+				      iport->live_buffer : iport->buffer_info);
 				if (bi) {
 					port->offset = bi->offset;
 				}
@@ -578,20 +598,31 @@ jack_set_buffer_size_request (jack_engine_t *engine, jack_nframes_t nframes)
 }
 
 
-static JSList *
-jack_process_internal (jack_engine_t *engine, JSList *node,
-		       jack_nframes_t nframes)
+/* Plans are built once per graph change and read by every cycle. */
+static inline int
+jack_plan_entry_runs (jack_plan_entry_t *entry)
+{
+	/* chained when the plan was built; deactivation and zombies
+	   take effect before the next plan is out */
+	return entry->chained && entry->control->active &&
+	       !entry->control->dead;
+}
+
+static unsigned int
+jack_process_internal (jack_engine_t *engine, jack_plan_t *plan,
+		       unsigned int n, jack_nframes_t nframes)
 {
 	jack_client_internal_t *client;
 	jack_client_control_t *ctl;
 
-	client = (jack_client_internal_t*)node->data;
-	ctl = client->control;
+	client = plan->clients[n].client;
+	ctl = plan->clients[n].control;
 
 	/* internal client */
 
 	DEBUG ("invoking an internal client's (%s) callbacks", ctl->name);
 	ctl->state = Running;
+	ctl->signalled_at = ctl->awake_at = jack_get_microseconds ();
 	engine->current_client = client;
 
 	/* XXX how to time out an internal client? */
@@ -611,12 +642,13 @@ jack_process_internal (jack_engine_t *engine, JSList *node,
 		jack_call_timebase_master (client->private_client);
 	}
 
+	ctl->finished_at = jack_get_microseconds ();
 	ctl->state = Finished;
 
 	if (engine->process_errors) {
-		return NULL;            /* will stop the loop */
+		return plan->nclients;  /* will stop the loop */
 	} else {
-		return jack_slist_next (node);
+		return n + 1;
 	}
 }
 
@@ -657,14 +689,15 @@ linux_poll_bug_encountered (jack_engine_t* engine, jack_time_t then, jack_time_t
 #endif
 
 #ifdef JACK_USE_MACH_THREADS
-static JSList *
-jack_process_external (jack_engine_t *engine, JSList *node)
+static unsigned int
+jack_process_external (jack_engine_t *engine, jack_plan_t *plan,
+		       unsigned int n)
 {
-	jack_client_internal_t * client = (jack_client_internal_t*)node->data;
+	jack_client_internal_t *client;
 	jack_client_control_t *ctl;
 
-	client = (jack_client_internal_t*)node->data;
-	ctl = client->control;
+	client = plan->clients[n].client;
+	ctl = plan->clients[n].control;
 
 	engine->current_client = client;
 
@@ -677,25 +710,28 @@ jack_process_external (jack_engine_t *engine, JSList *node)
 		ctl->state = Finished;
 	}
 
-	return jack_slist_next (node);
+	return n + 1;
 }
 #else /* !JACK_USE_MACH_THREADS */
-static JSList *
-jack_process_external (jack_engine_t *engine, JSList *node)
+static unsigned int
+jack_process_external (jack_engine_t *engine, jack_plan_t *plan,
+		       unsigned int n)
 {
 	int status = 0;
 	char c = 0;
 	struct pollfd pfd[1];
 	int poll_timeout;
 	jack_time_t poll_timeout_usecs;
+	jack_plan_entry_t *entry;
 	jack_client_internal_t *client;
 	jack_client_control_t *ctl;
 	jack_time_t now, then;
 	int pollret;
 
-	client = (jack_client_internal_t*)node->data;
+	entry = &plan->clients[n];
+	client = entry->client;
 
-	ctl = client->control;
+	ctl = entry->control;
 
 	/* external subgraph */
 
@@ -707,14 +743,14 @@ jack_process_external (jack_engine_t *engine, JSList *node)
 	engine->current_client = client;
 
 	DEBUG ("calling process() on an external subgraph, fd==%d",
-	       client->subgraph_start_fd);
+	       entry->start_fd);
 
-	if (write (client->subgraph_start_fd, &c, sizeof(c)) != sizeof(c)) {
+	if (write (entry->start_fd, &c, sizeof(c)) != sizeof(c)) {
 		jack_error ("cannot initiate graph processing (%s)",
 			    strerror (errno));
 		engine->process_errors++;
 		jack_engine_signal_problems (engine);
-		return NULL; /* will stop the loop */
+		return plan->nclients; /* will stop the loop */
 	}
 
 	then = jack_get_microseconds ();
@@ -729,11 +765,11 @@ jack_process_external (jack_engine_t *engine, JSList *node)
 
 again:
 	poll_timeout = 1 + poll_timeout_usecs / 1000;
-	pfd[0].fd = client->subgraph_wait_fd;
+	pfd[0].fd = entry->wait_fd;
 	pfd[0].events = POLLERR | POLLIN | POLLHUP | POLLNVAL;
 
 	DEBUG ("waiting on fd==%d for process() subgraph to finish (timeout = %d, period_usecs = %d)",
-	       client->subgraph_wait_fd, poll_timeout, engine->driver->period_usecs);
+	       entry->wait_fd, poll_timeout, engine->driver->period_usecs);
 
 	if ((pollret = poll (pfd, 1, poll_timeout)) < 0) {
 		jack_error ("poll on subgraph processing failed (%s)",
@@ -761,7 +797,7 @@ again:
 
 		if (engine->freewheeling) {
 			if (jack_check_client_status (engine)) {
-				return NULL;
+				return plan->nclients;
 			} else {
 				/* all clients are fine - we're just not done yet. since
 				   we're freewheeling, that is fine.
@@ -783,7 +819,7 @@ again:
 		jack_error ("subgraph starting at %s timed out "
 			    "(subgraph_wait_fd=%d, status = %d, state = %s, pollret = %d revents = 0x%x)",
 			    client->control->name,
-			    client->subgraph_wait_fd, status,
+			    entry->wait_fd, status,
 			    jack_client_state_name (client),
 			    pollret, pfd[0].revents);
 		status = 1;
@@ -801,7 +837,7 @@ again:
 			 " awa = %" PRIu64 " fin = %" PRIu64
 			 " dur=%" PRIu64,
 			 now,
-			 client->subgraph_wait_fd,
+			 entry->wait_fd,
 			 now - then,
 			 status,
 			 ctl->signalled_at,
@@ -813,7 +849,7 @@ again:
 		if (jack_check_clients (engine, 1)) {
 
 			engine->process_errors++;
-			return NULL;            /* will stop the loop */
+			return plan->nclients;  /* will stop the loop */
 		}
 	} else {
 		engine->timeout_count = 0;
@@ -821,9 +857,9 @@ again:
 
 
 	DEBUG ("reading byte from subgraph_wait_fd==%d",
-	       client->subgraph_wait_fd);
+	       entry->wait_fd);
 
-	if (read (client->subgraph_wait_fd, &c, sizeof(c)) != sizeof(c)) {
+	if (read (entry->wait_fd, &c, sizeof(c)) != sizeof(c)) {
 		if (errno == EAGAIN) {
 			jack_error ("pp: cannot clean up byte from graph wait "
 				    "fd - no data present");
@@ -832,56 +868,399 @@ again:
 				    strerror (errno));
 			client->error++;
 		}
-		return NULL;    /* will stop the loop */
+		return plan->nclients;  /* will stop the loop */
 	}
 
 	/* Move to next internal client (or end of client list) */
-	while (node) {
-		if (jack_client_is_internal ((jack_client_internal_t*)
-					     node->data)) {
+	for (n++; n < plan->nclients; n++) {
+		if (plan->clients[n].internal) {
 			break;
 		}
-		node = jack_slist_next (node);
 	}
 
-	return node;
+	return n;
 }
 
 #endif /* JACK_USE_MACH_THREADS */
 
-static int
-jack_engine_process (jack_engine_t *engine, jack_nframes_t nframes)
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+static unsigned int
+jack_process_external_futex (jack_engine_t *engine, jack_plan_t *plan,
+			     unsigned int n)
 {
-	/* precondition: caller has graph_lock */
+	int status = 0;
+	jack_wakeup_slot_t *wait_slot;
+	jack_time_t poll_timeout_usecs;
+	jack_plan_entry_t *entry;
 	jack_client_internal_t *client;
-	JSList *node;
+	jack_client_control_t *ctl;
+	jack_time_t now, then;
+
+	entry = &plan->clients[n];
+	client = entry->client;
+
+	ctl = entry->control;
+
+	/* external subgraph, chained through wakeup slots rather
+	   than FIFOs. the logic mirrors jack_process_external().
+	 */
+
+	wait_slot = &engine->control->wakeup[entry->wait_slot];
+
+	/* a race exists if we do this after signalling */
+	ctl->state = Triggered;
+
+	ctl->signalled_at = jack_get_microseconds ();
+
+	engine->current_client = client;
+
+	DEBUG ("calling process() on an external subgraph, slot==%d",
+	       entry->start_slot);
+
+	jack_wakeup_signal (&engine->control->wakeup[entry->start_slot],
+			    JACK_WAKEUP_GRAPH);
+
+	then = jack_get_microseconds ();
+
+	if (engine->freewheeling) {
+		poll_timeout_usecs = 250000; /* 0.25 seconds */
+	} else {
+		poll_timeout_usecs = (engine->client_timeout_msecs > 0 ?
+				      engine->client_timeout_msecs * 1000 :
+				      engine->driver->period_usecs);
+	}
+
+again:
+	if (jack_wakeup_wait (wait_slot, JACK_WAKEUP_GRAPH,
+			      poll_timeout_usecs) == 0) {
+
+		if (engine->freewheeling) {
+			if (jack_check_client_status (engine)) {
+				return plan->nclients;
+			} else {
+				goto again;
+			}
+		}
+
+		jack_error ("subgraph starting at %s timed out "
+			    "(subgraph_wait_slot=%d, state = %s)",
+			    client->control->name,
+			    entry->wait_slot,
+			    jack_client_state_name (client));
+		status = 1;
+	}
+
+	now = jack_get_microseconds ();
+
+	if (status != 0) {
+		VERBOSE (engine, "at %" PRIu64
+			 " waiting on slot %d for %" PRIu64
+			 " usecs, status = %d sig = %" PRIu64
+			 " awa = %" PRIu64 " fin = %" PRIu64
+			 " dur=%" PRIu64,
+			 now,
+			 entry->wait_slot,
+			 now - then,
+			 status,
+			 ctl->signalled_at,
+			 ctl->awake_at,
+			 ctl->finished_at,
+			 ctl->finished_at ? (ctl->finished_at -
+					     ctl->signalled_at) : 0);
+
+		if (jack_check_clients (engine, 1)) {
+			engine->process_errors++;
+		}
+		return plan->nclients;  /* will stop the loop */
+	}
+
+	engine->timeout_count = 0;
+
+	/* Move to next internal client (or end of client list) */
+	for (n++; n < plan->nclients; n++) {
+		if (plan->clients[n].internal) {
+			break;
+		}
+	}
+
+	return n;
+}
+#endif /* JACK_HAVE_FUTEX_WAKEUP */
+
+#ifndef JACK_USE_MACH_THREADS
+
+/* Parallel graph execution.
+ *
+ * jack_rechain_graph() gives every external client its own one-hop
+ * subgraph when engine->parallel is set, so the engine can start any
+ * of them independently. The plan records, for every client, the
+ * number of sortfeeds edges leading into it; each cycle starts from
+ * those counts and a client whose count drops to zero is ready.
+ * All ready external clients are triggered at once and we then poll
+ * on their wait FIFOs together. When one finishes, its sortfeeds
+ * successors are released and may become ready in turn. Internal
+ * clients run in this thread as soon as they are ready.
+ */
+
+static inline void
+jack_sched_release (jack_plan_t *plan, jack_plan_entry_t *entry)
+{
+	unsigned int i;
+
+	entry->pending = -1;
+
+	for (i = 0; i < entry->nsuccs; i++) {
+		plan->clients[entry->succs[i]].pending--;
+	}
+}
+
+static int
+jack_sched_trigger (jack_engine_t *engine, jack_plan_t *plan,
+		    jack_plan_entry_t *entry, size_t *nrunning)
+{
+	jack_client_control_t *ctl = entry->control;
+	char c = 0;
+
+	/* a race exists if we do this after the write(2) */
+	ctl->state = Triggered;
+	ctl->signalled_at = jack_get_microseconds ();
+
+	engine->current_client = entry->client;
+	entry->pending = -1;
+
+	DEBUG ("triggering external client %s, fd==%d",
+	       ctl->name, entry->start_fd);
+
+	if (write (entry->start_fd, &c, sizeof(c)) != sizeof(c)) {
+		jack_error ("cannot initiate graph processing (%s)",
+			    strerror (errno));
+		engine->process_errors++;
+		jack_engine_signal_problems (engine);
+		return -1;
+	}
+
+	/* every entry is triggered at most once, so the plan's
+	   scheduler tables are always big enough */
+	plan->sched_client[*nrunning] = entry;
+	plan->sched_pfd[*nrunning].fd = entry->wait_fd;
+	plan->sched_pfd[*nrunning].events = POLLERR | POLLIN | POLLHUP | POLLNVAL;
+	plan->sched_pfd[*nrunning].revents = 0;
+	(*nrunning)++;
+
+	return 0;
+}
+
+static int
+jack_engine_process_parallel (jack_engine_t *engine, jack_plan_t *plan,
+			      jack_nframes_t nframes)
+{
+	jack_plan_entry_t *entry;
+	size_t nrunning = 0;
+	size_t i;
+	unsigned int n;
+	int progress;
+	int status;
+	int pollret;
+	char c;
+	jack_time_t then, poll_timeout_usecs;
+
+	for (n = 0; n < plan->nclients; n++) {
+		plan->clients[n].pending = plan->clients[n].npreds;
+	}
+
+	then = jack_get_microseconds ();
+
+	if (engine->freewheeling) {
+		poll_timeout_usecs = 250000; /* 0.25 seconds */
+	} else {
+		poll_timeout_usecs = (engine->client_timeout_msecs > 0 ?
+				      engine->client_timeout_msecs * 1000 :
+				      engine->driver->period_usecs);
+	}
+
+	while (engine->process_errors == 0) {
+
+		/* start everything that is ready. external clients
+		   go first so that they are running while we execute
+		   internal clients in this thread.
+		 */
+
+		do {
+			progress = 0;
+
+			for (n = 0; engine->process_errors == 0 &&
+			     n < plan->nclients; n++) {
+
+				entry = &plan->clients[n];
+
+				if (entry->pending != 0) {
+					continue;
+				}
+
+				if (!jack_plan_entry_runs (entry)) {
+					jack_sched_release (plan, entry);
+					progress = 1;
+				} else if (!entry->internal) {
+					jack_sched_trigger (engine, plan, entry,
+							    &nrunning);
+				}
+			}
+
+			for (n = 0; engine->process_errors == 0 &&
+			     n < plan->nclients; n++) {
+
+				entry = &plan->clients[n];
+
+				if (entry->pending == 0 && entry->internal) {
+					jack_process_internal (engine, plan, n,
+							       nframes);
+					jack_sched_release (plan, entry);
+					progress = 1;
+				}
+			}
+
+		} while (progress && engine->process_errors == 0);
+
+		if (engine->process_errors || nrunning == 0) {
+			break;
+		}
+
+		status = 0;
+
+		DEBUG ("waiting on %d running subgraphs (timeout = %" PRIu64
+		       " usecs)", (int)nrunning, poll_timeout_usecs);
+
+		if ((pollret = poll (plan->sched_pfd, nrunning,
+				     1 + poll_timeout_usecs / 1000)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			jack_error ("poll on subgraph processing failed (%s)",
+				    strerror (errno));
+			status = -1;
+
+		} else if (pollret == 0) {
+
+			if (engine->freewheeling) {
+				if (jack_check_client_status (engine)) {
+					break;
+				}
+				continue;
+			}
+
+#ifdef __linux
+			if (linux_poll_bug_encountered (engine, then, &poll_timeout_usecs)) {
+				continue;
+			}
+#endif
+			for (i = 0; i < nrunning; i++) {
+				jack_error ("subgraph starting at %s timed out "
+					    "(subgraph_wait_fd=%d, state = %s)",
+					    plan->sched_client[i]->control->name,
+					    plan->sched_client[i]->wait_fd,
+					    jack_client_state_name (plan->sched_client[i]->client));
+			}
+			status = 1;
+		}
+
+		for (i = 0; status == 0 && i < nrunning; ) {
+
+			entry = plan->sched_client[i];
+
+			if (plan->sched_pfd[i].revents & ~POLLIN) {
+				jack_error ("subgraph starting at %s lost client",
+					    entry->control->name);
+				status = -2;
+				break;
+			}
+
+			if (!(plan->sched_pfd[i].revents & POLLIN)) {
+				i++;
+				continue;
+			}
+
+			if (read (entry->wait_fd, &c, sizeof(c)) != sizeof(c)) {
+				jack_error ("pp: cannot clean up byte from graph wait fd (%s)",
+					    strerror (errno));
+				entry->client->error++;
+				status = -1;
+				break;
+			}
+
+			jack_sched_release (plan, entry);
+
+			/* fill the hole with the last running client */
+			nrunning--;
+			plan->sched_client[i] = plan->sched_client[nrunning];
+			plan->sched_pfd[i] = plan->sched_pfd[nrunning];
+		}
+
+		if (status != 0) {
+			VERBOSE (engine, "parallel cycle stopped with %d subgraphs "
+				 "outstanding, status = %d", (int)nrunning, status);
+			if (jack_check_clients (engine, 1)) {
+				engine->process_errors++;
+			}
+			break;
+		}
+
+		/* every hop gets the full timeout, as in the serial case */
+		engine->timeout_count = 0;
+		then = jack_get_microseconds ();
+		if (!engine->freewheeling) {
+			poll_timeout_usecs = (engine->client_timeout_msecs > 0 ?
+					      engine->client_timeout_msecs * 1000 :
+					      engine->driver->period_usecs);
+		}
+	}
+
+	return engine->process_errors > 0;
+}
+
+#endif /* !JACK_USE_MACH_THREADS */
+
+static int
+jack_engine_process (jack_engine_t *engine, jack_plan_t *plan,
+		     jack_nframes_t nframes)
+{
+	/* precondition: caller has acquired plan */
+	jack_plan_entry_t *entry;
+	jack_client_control_t *ctl;
+	unsigned int n;
 
 	engine->process_errors = 0;
 
-	for (node = engine->clients; node; node = jack_slist_next (node)) {
-		jack_client_control_t *ctl =
-			((jack_client_internal_t*)node->data)->control;
+	for (n = 0; n < plan->nclients; n++) {
+		ctl = plan->clients[n].control;
 		ctl->state = NotTriggered;
 		ctl->timed_out = 0;
 		ctl->awake_at = 0;
 		ctl->finished_at = 0;
 	}
 
-	for (node = engine->clients; engine->process_errors == 0 && node; ) {
+#ifndef JACK_USE_MACH_THREADS
+	if (engine->parallel) {
+		return jack_engine_process_parallel (engine, plan, nframes);
+	}
+#endif
 
-		client = (jack_client_internal_t*)node->data;
+	for (n = 0; engine->process_errors == 0 && n < plan->nclients; ) {
 
-		DEBUG ("considering client %s for processing",
-		       client->control->name);
+		entry = &plan->clients[n];
 
-		if (!client->control->active ||
-		    (!client->control->process_cbset && !client->control->thread_cb_cbset) ||
-		    client->control->dead) {
-			node = jack_slist_next (node);
-		} else if (jack_client_is_internal (client)) {
-			node = jack_process_internal (engine, node, nframes);
+		DEBUG ("considering client %s for processing",
+		       entry->control->name);
+
+		if (!jack_plan_entry_runs (entry)) {
+			n++;
+		} else if (entry->internal) {
+			n = jack_process_internal (engine, plan, n, nframes);
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+		} else if (plan->futex_wakeup) {
+			n = jack_process_external_futex (engine, plan, n);
+#endif
 		} else {
-			node = jack_process_external (engine, node);
+			n = jack_process_external (engine, plan, n);
 		}
 	}
 
@@ -944,54 +1323,502 @@ jack_calc_cpu_load (jack_engine_t *engine)
 }
 
 static void
-jack_engine_post_process (jack_engine_t *engine)
+jack_engine_trace_init (jack_engine_t *engine)
 {
-	/* precondition: caller holds the graph lock. */
+	size_t size = sizeof(jack_trace_header_t)
+		      + sizeof(jack_trace_record_t) * JACK_TRACE_RECORDS;
 
-	jack_transport_cycle_end (engine);
-	jack_calc_cpu_load (engine);
-	jack_check_clients (engine, 0);
-}
+	engine->trace = NULL;
+	engine->trace_cycle = 0;
+	engine->trace_xrun = 0;
+	engine->control->trace_shm_index = JACK_SHM_NULL_INDEX;
 
+	if (jack_shmalloc (size, &engine->trace_shm)) {
+		jack_error ("cannot create cycle trace shared memory "
+			    "segment (%s)", strerror (errno));
+		return;
+	}
 
-static jack_driver_info_t *
-jack_load_driver (jack_engine_t *engine, jack_driver_desc_t * driver_desc)
-{
-	const char *errstr;
-	jack_driver_info_t *info;
+	if (jack_attach_shm (&engine->trace_shm)) {
+		jack_error ("cannot attach to cycle trace shared memory "
+			    "(%s)", strerror (errno));
+		jack_destroy_shm (&engine->trace_shm);
+		return;
+	}
 
-	info = (jack_driver_info_t*)calloc (1, sizeof(*info));
+	engine->trace = (jack_trace_header_t*)
+			jack_shm_addr (&engine->trace_shm);
+	memset (engine->trace, 0, size);
+	engine->trace->size = JACK_TRACE_RECORDS;
 
-	info->handle = dlopen (driver_desc->file, RTLD_NOW | RTLD_GLOBAL);
+	engine->control->trace_shm_index = engine->trace_shm.index;
+}
 
-	if (info->handle == NULL) {
-		if ((errstr = dlerror ()) != 0) {
-			jack_error ("can't load \"%s\": %s", driver_desc->file,
-				    errstr);
-		} else {
-			jack_error ("bizarre error loading driver shared "
-				    "object %s", driver_desc->file);
-		}
-		goto fail;
-	}
+static void
+jack_engine_graph_init (jack_engine_t *engine)
+{
+	uint32_t nports = engine->port_max;
+	uint32_t max_edges = nports * JACK_GRAPH_EDGES_PER_PORT;
+	size_t size = sizeof(uint32_t) * (nports + 1 + max_edges);
 
-	info->initialize = dlsym (info->handle, "driver_initialize");
+	engine->graph = NULL;
+	engine->control->graph_shm_index = JACK_SHM_NULL_INDEX;
 
-	if ((errstr = dlerror ()) != 0) {
-		jack_error ("no initialize function in shared object %s\n",
-			    driver_desc->file);
-		goto fail;
+	if ((engine->graph_scratch = (uint32_t*)malloc (size)) == NULL) {
+		jack_error ("cannot allocate memory for connection snapshot");
+		return;
 	}
 
-	info->finish = dlsym (info->handle, "driver_finish");
+	if (jack_shmalloc (sizeof(jack_graph_snapshot_t) + size,
+			   &engine->graph_shm)) {
+		jack_error ("cannot create connection snapshot shared memory "
+			    "segment (%s)", strerror (errno));
+		goto fail;
+	}
 
-	if ((errstr = dlerror ()) != 0) {
-		jack_error ("no finish function in in shared driver object %s",
-			    driver_desc->file);
+	if (jack_attach_shm (&engine->graph_shm)) {
+		jack_error ("cannot attach to connection snapshot shared memory "
+			    "(%s)", strerror (errno));
+		jack_destroy_shm (&engine->graph_shm);
 		goto fail;
 	}
 
-	info->client_name = (char*)dlsym (info->handle, "driver_client_name");
+	engine->graph = (jack_graph_snapshot_t*)
+			jack_shm_addr (&engine->graph_shm);
+	memset (engine->graph, 0, sizeof(jack_graph_snapshot_t) + size);
+	engine->graph->nports = nports;
+	engine->graph->max_edges = max_edges;
+	engine->graph->complete = 1;
+
+	engine->control->graph_shm_index = engine->graph_shm.index;
+	return;
+
+fail:
+	free (engine->graph_scratch);
+	engine->graph_scratch = NULL;
+}
+
+static void
+jack_engine_stats_init (jack_engine_t *engine)
+{
+	size_t size = sizeof(jack_stats_header_t)
+		      + sizeof(jack_client_stats_t) * JACK_STATS_CLIENTS;
+
+	engine->stats = NULL;
+	engine->stats_cycles = 0;
+	engine->control->stats_shm_index = JACK_SHM_NULL_INDEX;
+
+	if ((engine->stats_window = (jack_stats_window_t*)
+	     calloc (JACK_STATS_CLIENTS, sizeof(jack_stats_window_t))) == NULL) {
+		jack_error ("cannot allocate memory for client statistics");
+		return;
+	}
+
+	if (jack_shmalloc (size, &engine->stats_shm)) {
+		jack_error ("cannot create client statistics shared memory "
+			    "segment (%s)", strerror (errno));
+		goto fail;
+	}
+
+	if (jack_attach_shm (&engine->stats_shm)) {
+		jack_error ("cannot attach to client statistics shared memory "
+			    "(%s)", strerror (errno));
+		jack_destroy_shm (&engine->stats_shm);
+		goto fail;
+	}
+
+	engine->stats = (jack_stats_header_t*)
+			jack_shm_addr (&engine->stats_shm);
+	memset (engine->stats, 0, size);
+	engine->stats->nclients = JACK_STATS_CLIENTS;
+
+	engine->control->stats_shm_index = engine->stats_shm.index;
+	return;
+
+fail:
+	free (engine->stats_window);
+	engine->stats_window = NULL;
+}
+
+void
+jack_engine_stats_add_client (jack_engine_t *engine,
+			      jack_client_internal_t *client)
+{
+	jack_client_stats_t *rec;
+	int slot;
+
+	client->stats_slot = -1;
+
+	if (engine->stats == NULL) {
+		return;
+	}
+
+	for (slot = 0; slot < JACK_STATS_CLIENTS; slot++) {
+		if (!engine->stats->clients[slot].in_use) {
+			break;
+		}
+	}
+
+	if (slot == JACK_STATS_CLIENTS) {
+		VERBOSE (engine, "no room for statistics of client %s",
+			 client->control->name);
+		return;
+	}
+
+	/* nobody else writes the record until the client is in a
+	   plan, and jack_publish_plan() orders this before that */
+
+	rec = &engine->stats->clients[slot];
+
+	__atomic_store_n (&rec->seq, rec->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+
+	memset ((char*)rec + sizeof(rec->seq), 0, sizeof(*rec) - sizeof(rec->seq));
+	rec->in_use = 1;
+	rec->client_id = client->control->uuid;
+	snprintf (rec->name, sizeof(rec->name), "%s",
+		  (const char*)client->control->name);
+
+	__atomic_store_n (&rec->seq, rec->seq + 1, __ATOMIC_RELEASE);
+
+	memset (&engine->stats_window[slot], 0, sizeof(jack_stats_window_t));
+	client->stats_slot = slot;
+}
+
+void
+jack_engine_stats_remove_client (jack_engine_t *engine,
+				 jack_client_internal_t *client)
+{
+	/* the client is in no plan any more, so this thread is the
+	   only writer of its record */
+
+	jack_client_stats_t *rec;
+
+	if (client->stats_slot < 0) {
+		return;
+	}
+
+	rec = &engine->stats->clients[client->stats_slot];
+
+	__atomic_store_n (&rec->seq, rec->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	rec->in_use = 0;
+	__atomic_store_n (&rec->seq, rec->seq + 1, __ATOMIC_RELEASE);
+
+	client->stats_slot = -1;
+}
+
+/* smallest time that at least `percent' of the samples did not exceed,
+ * to histogram resolution */
+static float
+jack_stats_percentile (const uint32_t *histogram, uint32_t count,
+		       jack_time_t max, unsigned int percent)
+{
+	uint64_t rank = ((uint64_t)count * percent + 99) / 100;
+	uint64_t seen = 0;
+	uint64_t top;
+	uint32_t b;
+
+	if (count == 0) {
+		return 0.0f;
+	}
+
+	for (b = 0; b < JACK_STATS_BUCKETS - 1; b++) {
+		if ((seen += histogram[b]) >= rank) {
+			break;
+		}
+	}
+
+	top = jack_stats_bucket_floor (b + 1);
+
+	return (float)(top < max ? top : max);
+}
+
+static void
+jack_engine_stats_publish (jack_engine_t *engine, jack_plan_t *plan)
+{
+	jack_stats_window_t *w;
+	jack_client_stats_t *rec;
+	unsigned int n;
+	int slot;
+
+	for (n = 0; n < plan->nclients; n++) {
+
+		if ((slot = plan->clients[n].client->stats_slot) < 0) {
+			continue;
+		}
+
+		w = &engine->stats_window[slot];
+		rec = &engine->stats->clients[slot];
+
+		__atomic_store_n (&rec->seq, rec->seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence (__ATOMIC_RELEASE);
+
+		rec->cycles = w->cycles;
+		rec->timeouts = w->timeouts;
+
+		if (w->cycles) {
+			rec->mean_usecs = (float)w->run_total / w->cycles;
+			rec->wake_mean_usecs = (float)w->wake_total / w->cycles;
+		} else {
+			rec->mean_usecs = 0.0f;
+			rec->wake_mean_usecs = 0.0f;
+		}
+
+		rec->max_usecs = w->run_max;
+		rec->p99_usecs = jack_stats_percentile (w->run_histogram,
+							w->cycles, w->run_max, 99);
+		rec->wake_max_usecs = w->wake_max;
+		memcpy (rec->wake_histogram, w->wake_histogram,
+			sizeof(rec->wake_histogram));
+
+		__atomic_store_n (&rec->seq, rec->seq + 1, __ATOMIC_RELEASE);
+
+		memset (w, 0, sizeof(*w));
+	}
+}
+
+static void
+jack_engine_stats_cycle (jack_engine_t *engine)
+{
+	/* precondition: called from the cycle. while a client is in
+	   the plan, this thread is the only writer of its record.
+	 */
+
+	jack_plan_t *plan = engine->plan_in_use;
+	jack_client_control_t *ctl;
+	jack_stats_window_t *w;
+	jack_time_t run, wake;
+	unsigned int n;
+	int slot;
+
+	if (engine->stats == NULL) {
+		return;
+	}
+
+	for (n = 0; n < plan->nclients; n++) {
+
+		if ((slot = plan->clients[n].client->stats_slot) < 0) {
+			continue;
+		}
+
+		ctl = plan->clients[n].control;
+		w = &engine->stats_window[slot];
+
+		if (ctl->timed_out) {
+			w->timeouts++;
+			continue;
+		}
+
+		if (ctl->state != Finished
+		    || ctl->awake_at < ctl->signalled_at
+		    || ctl->finished_at < ctl->awake_at) {
+			continue;
+		}
+
+		wake = ctl->awake_at - ctl->signalled_at;
+		run = ctl->finished_at - ctl->awake_at;
+
+		w->cycles++;
+		w->run_total += run;
+		w->wake_total += wake;
+		if (run > w->run_max) {
+			w->run_max = run;
+		}
+		if (wake > w->wake_max) {
+			w->wake_max = wake;
+		}
+		w->run_histogram[jack_stats_bucket (run)]++;
+		w->wake_histogram[jack_stats_bucket (wake)]++;
+	}
+
+	if (++engine->stats_cycles % engine->rolling_interval == 0) {
+		jack_engine_stats_publish (engine, plan);
+	}
+}
+
+/* Rebuild the connection snapshot and publish it if anything changed.
+ * CALLER holds the graph lock.
+ */
+static void
+jack_publish_connections (jack_engine_t *engine)
+{
+	jack_graph_snapshot_t *graph = engine->graph;
+	jack_port_internal_t *port;
+	jack_connection_internal_t *connection;
+	JSList *node;
+	uint32_t *start, *edges;
+	uint32_t p, nports, nedges = 0;
+	int complete = 1;
+	size_t len;
+
+	if (graph == NULL) {
+		return;
+	}
+
+	nports = graph->nports;
+	start = engine->graph_scratch;
+	edges = start + nports + 1;
+
+	for (p = 0; p < nports; p++) {
+
+		start[p] = nedges;
+		port = &engine->internal_ports[p];
+
+		if (!port->shared->in_use) {
+			continue;
+		}
+
+		for (node = port->connections; node; node = jack_slist_next (node)) {
+
+			if (nedges == graph->max_edges) {
+				complete = 0;
+				break;
+			}
+
+			connection = (jack_connection_internal_t*)node->data;
+
+			if (connection->source == port) {
+				edges[nedges++] = connection->destination->shared->id;
+			} else {
+				edges[nedges++] = connection->source->shared->id;
+			}
+		}
+	}
+
+	start[nports] = nedges;
+	len = sizeof(uint32_t) * (nports + 1 + nedges);
+
+	if (graph->complete == complete
+	    && memcmp (graph->data, start, len) == 0) {
+		return;
+	}
+
+	__atomic_store_n (&graph->generation, graph->generation + 1,
+			  __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+
+	memcpy (graph->data, start, len);
+	graph->complete = complete;
+
+	__atomic_store_n (&graph->generation, graph->generation + 1,
+			  __ATOMIC_RELEASE);
+
+	if (!complete) {
+		VERBOSE (engine, "connection snapshot is full, clients will "
+			 "have to ask for connections");
+	}
+}
+
+static void
+jack_engine_trace_cycle (jack_engine_t *engine)
+{
+	/* precondition: called from the cycle. this thread is the
+	   only writer, readers detect torn records by the sequence
+	   stamps.
+	 */
+
+	jack_trace_header_t *trace = engine->trace;
+	jack_plan_t *plan = engine->plan_in_use;
+	jack_trace_record_t *rec;
+	jack_client_control_t *ctl;
+	unsigned int n;
+	uint64_t pos;
+	uint32_t flags = 0;
+
+	if (trace == NULL) {
+		return;
+	}
+
+	if (engine->trace_xrun) {
+		flags |= JACK_TRACE_XRUN;
+		engine->trace_xrun = 0;
+	}
+
+	pos = trace->head;
+
+	for (n = 0; n < plan->nclients; n++) {
+
+		ctl = plan->clients[n].control;
+
+		if (ctl->state == NotTriggered) {
+			continue;
+		}
+
+		rec = &trace->records[pos & (JACK_TRACE_RECORDS - 1)];
+
+		__atomic_store_n (&rec->seq, (uint32_t)(2 * pos + 1),
+				  __ATOMIC_RELAXED);
+		__atomic_thread_fence (__ATOMIC_RELEASE);
+
+		rec->cycle = engine->trace_cycle;
+		rec->client_id = ctl->uuid;
+		rec->signalled_at = ctl->signalled_at;
+		rec->awake_at = ctl->awake_at;
+		rec->finished_at = ctl->finished_at;
+		rec->nframes = engine->control->buffer_size;
+		rec->flags = flags | (ctl->timed_out ? JACK_TRACE_TIMEOUT : 0);
+
+		__atomic_store_n (&rec->seq, (uint32_t)(2 * pos + 2),
+				  __ATOMIC_RELEASE);
+		pos++;
+	}
+
+	__atomic_store_n (&trace->head, pos, __ATOMIC_RELEASE);
+	engine->trace_cycle++;
+}
+
+static void
+jack_engine_post_process (jack_engine_t *engine)
+{
+	/* precondition: called from the cycle. */
+
+	jack_transport_cycle_end (engine);
+	jack_calc_cpu_load (engine);
+	jack_check_clients (engine, 0);
+	jack_engine_trace_cycle (engine);
+	jack_engine_stats_cycle (engine);
+}
+
+
+static jack_driver_info_t *
+jack_load_driver (jack_engine_t *engine, jack_driver_desc_t * driver_desc)
+{
+	const char *errstr;
+	jack_driver_info_t *info;
+
+	info = (jack_driver_info_t*)calloc (1, sizeof(*info));
+
+	info->handle = dlopen (driver_desc->file, RTLD_NOW | RTLD_GLOBAL);
+
+	if (info->handle == NULL) {
+		if ((errstr = dlerror ()) != 0) {
+			jack_error ("can't load \"%s\": %s", driver_desc->file,
+				    errstr);
+		} else {
+			jack_error ("bizarre error loading driver shared "
+				    "object %s", driver_desc->file);
+		}
+		goto fail;
+	}
+
+	info->initialize = dlsym (info->handle, "driver_initialize");
+
+	if ((errstr = dlerror ()) != 0) {
+		jack_error ("no initialize function in shared object %s\n",
+			    driver_desc->file);
+		goto fail;
+	}
+
+	info->finish = dlsym (info->handle, "driver_finish");
+
+	if ((errstr = dlerror ()) != 0) {
+		jack_error ("no finish function in in shared driver object %s",
+			    driver_desc->file);
+		goto fail;
+	}
+
+	info->client_name = (char*)dlsym (info->handle, "driver_client_name");
 
 	if ((errstr = dlerror ()) != 0) {
 		jack_error ("no client name in in shared driver object %s",
@@ -1236,6 +2063,12 @@ do_request (jack_engine_t *engine, jack_request_t *req, int *reply_fd)
 				      req->x.connect.destination_port);
 		break;
 
+	case ConnectPortsMany:
+		req->status = jack_port_do_connect_many
+				      (engine, req->x.connections.ops,
+				      req->x.connections.nops);
+		break;
+
 	case DisconnectPort:
 		req->status = jack_port_do_disconnect_all
 				      (engine, req->x.port_info.port_id);
@@ -1311,7 +2144,7 @@ do_request (jack_engine_t *engine, jack_request_t *req, int *reply_fd)
 	case SetBufferSize:
 		req->status = jack_set_buffer_size_request (engine, req->x.nframes);
 		jack_lock_graph (engine);
-		jack_compute_new_latency (engine);
+		jack_compute_new_latency (engine, TRUE);
 		jack_unlock_graph (engine);
 		break;
 
@@ -1334,7 +2167,7 @@ do_request (jack_engine_t *engine, jack_request_t *req, int *reply_fd)
 	case RecomputeTotalLatencies:
 		jack_lock_graph (engine);
 		jack_compute_all_port_total_latencies (engine);
-		jack_compute_new_latency (engine);
+		jack_compute_new_latency (engine, TRUE);
 		jack_unlock_graph (engine);
 		req->status = 0;
 		break;
@@ -1409,6 +2242,78 @@ internal_client_request (void* ptr, jack_request_t *request)
 	return request->status;
 }
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+
+/* Serve everything the client has queued in its control block and
+ * re-arm its doorbell. This runs on the server thread, which is the
+ * only one that removes clients, so the client stays put while the
+ * graph lock is dropped around do_request().
+ */
+static void
+jack_serve_request_ring (jack_engine_t *engine, jack_client_internal_t *client)
+{
+	jack_client_control_t *control = client->control;
+	jack_request_t req;
+	jack_request_t *slot;
+	uint32_t head, tail;
+	int reply_fd;
+
+	tail = control->request_tail;
+
+	for (;;) {
+		head = __atomic_load_n (&control->request_head, __ATOMIC_ACQUIRE);
+
+		if (head - tail > JACK_REQUEST_RING_SIZE) {
+			jack_error ("client %s has a bad request ring (%" PRIu32
+				    "/%" PRIu32 ")", (char*)control->name, head, tail);
+			return;
+		}
+
+		while (tail != head) {
+			slot = (jack_request_t*)&control->request_ring[tail & (JACK_REQUEST_RING_SIZE - 1)];
+			memcpy (&req, slot, sizeof(req));
+
+			if (jack_request_via_shm (req.type)) {
+				reply_fd = -1;
+				jack_unlock_graph (engine);
+				do_request (engine, &req, &reply_fd);
+				jack_lock_graph (engine);
+			} else {
+				jack_error ("request type %" PRIu32 " cannot go through"
+					    " the request ring", req.type);
+				req.status = -1;
+			}
+
+			memcpy (slot, &req, sizeof(req));
+			__atomic_store_n (&control->request_tail, ++tail,
+					  __ATOMIC_SEQ_CST);
+
+			if (__atomic_load_n (&control->request_waiters,
+					     __ATOMIC_SEQ_CST)) {
+				jack_futex_wake (&control->request_tail);
+			}
+		}
+
+		/* the client rings only if it finds the doorbell armed
+		   after queueing, so look at the ring once more */
+		__atomic_store_n (&control->request_armed, 1, __ATOMIC_SEQ_CST);
+
+		if (__atomic_load_n (&control->request_head,
+				     __ATOMIC_SEQ_CST) == tail) {
+			break;
+		}
+
+		if (!__atomic_exchange_n (&control->request_armed, 0,
+					  __ATOMIC_SEQ_CST)) {
+			/* the client saw it armed: its doorbell is on
+			   the way and will bring us back here */
+			break;
+		}
+	}
+}
+
+#endif /* JACK_HAVE_FUTEX_WAKEUP */
+
 static int
 handle_external_client_request (jack_engine_t *engine, int fd)
 {
@@ -1417,15 +2322,22 @@ handle_external_client_request (jack_engine_t *engine, int fd)
 	jack_request_t req;
 	jack_client_internal_t *client = 0;
 	int reply_fd;
-	JSList *node;
 	ssize_t r;
 
-	for (node = engine->clients; node; node = jack_slist_next (node)) {
+#ifdef JACK_USE_EPOLL
+	if (fd < engine->fd_clients_size) {
+		client = engine->fd_clients[fd];
+	}
+#else
+	JSList *node;
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
 		if (((jack_client_internal_t*)node->data)->request_fd == fd) {
 			client = (jack_client_internal_t*)node->data;
 			break;
 		}
 	}
+#endif
 
 	if (client == NULL) {
 		jack_error ("client input on unknown fd %d!", fd);
@@ -1459,6 +2371,27 @@ handle_external_client_request (jack_engine_t *engine, int fd)
 		}
 	}
 
+	if (req.type == RequestsQueued) {
+		/* doorbell only, the replies go back through the ring */
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+		if (client->shm_requests) {
+			jack_serve_request_ring (engine, client);
+		}
+#endif
+		return 0;
+	}
+
+	if (req.type == EnableRequestRing) {
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+		client->shm_requests = 1;
+		__atomic_store_n (&client->control->request_armed, 1,
+				  __ATOMIC_SEQ_CST);
+		req.status = 0;
+#else
+		req.status = -1;
+#endif
+	}
+
 	if (req.type == PropertyChangeNotify) {
 		if (req.x.property.keylen) {
 			req.x.property.key = (char*)malloc (req.x.property.keylen);
@@ -1472,6 +2405,33 @@ handle_external_client_request (jack_engine_t *engine, int fd)
 		}
 	}
 
+	if (req.type == ConnectPortsMany) {
+		size_t len = req.x.connections.nops * sizeof(jack_connection_op_t);
+		size_t got = 0;
+
+		if (req.x.connections.nops > JACK_CONNECTION_OPS_MAX) {
+			jack_error ("too many connections in one request (%" PRIu32 ")",
+				    req.x.connections.nops);
+			return -1;
+		}
+		req.x.connections.ops = (jack_connection_op_t*)malloc (len);
+		if (len && req.x.connections.ops == NULL) {
+			jack_error ("cannot allocate memory for connection request");
+			return -1;
+		}
+		while (got < len) {
+			if ((r = read (client->request_fd,
+				       (char*)req.x.connections.ops + got,
+				       len - got)) <= 0) {
+				jack_error ("cannot read connections from client (%d/%d/%s)",
+					    r, len, strerror (errno));
+				free (req.x.connections.ops);
+				return -1;
+			}
+			got += r;
+		}
+	}
+
 	reply_fd = client->request_fd;
 
 	jack_unlock_graph (engine);
@@ -1482,6 +2442,10 @@ handle_external_client_request (jack_engine_t *engine, int fd)
 		free ((char*)req.x.property.key);
 	}
 
+	if (req.type == ConnectPortsMany) {
+		free (req.x.connections.ops);
+	}
+
 	if (reply_fd >= 0) {
 		DEBUG ("replying to client");
 		if (write (reply_fd, &req, sizeof(req))
@@ -1529,143 +2493,368 @@ handle_client_ack_connection (jack_engine_t *engine, int client_fd)
 }
 
 
-static void *
-jack_server_thread (void *arg)
+#ifdef JACK_USE_EPOLL
+
+#define JACK_SERVER_EPOLL_EVENTS 64
 
+/* Keep a client's request fd in the server thread's epoll set, and
+ * note which client it belongs to. Called with the graph write lock.
+ */
+void
+jack_engine_watch_client (jack_engine_t *engine, jack_client_internal_t *client)
 {
-	jack_engine_t *engine = (jack_engine_t*)arg;
-	struct sockaddr_un client_addr;
-	socklen_t client_addrlen;
-	int problemsProblemsPROBLEMS = 0;
-	int client_socket;
-	int done = 0;
-	int i;
-	const int fixed_fd_cnt = 3;
-	int stop_freewheeling;
+	struct epoll_event ev;
+	jack_client_internal_t **table;
+	int fd = client->request_fd;
+	int size;
 
-	while (!done) {
-		JSList* node;
-		int clients;
+	if (jack_client_is_internal (client) || fd < 0) {
+		return;
+	}
 
-		jack_rdlock_graph (engine);
+	if (fd >= engine->fd_clients_size) {
+		size = engine->fd_clients_size ? engine->fd_clients_size : 64;
+		while (size <= fd) {
+			size *= 2;
+		}
+		table = (jack_client_internal_t**)
+			realloc (engine->fd_clients, sizeof(*table) * size);
+		if (table == NULL) {
+			jack_error ("cannot allocate memory to watch client fds");
+			return;
+		}
+		memset (table + engine->fd_clients_size, 0,
+			sizeof(*table) * (size - engine->fd_clients_size));
+		engine->fd_clients = table;
+		engine->fd_clients_size = size;
+	}
 
-		clients = jack_slist_length (engine->clients);
+	memset (&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLPRI;
+	ev.data.fd = fd;
 
-		if (engine->pfd_size < fixed_fd_cnt + clients) {
-			if (engine->pfd) {
-				free (engine->pfd);
-			}
+	if (epoll_ctl (engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		jack_error ("cannot watch request fd of client %s (%s)",
+			    client->control->name, strerror (errno));
+		return;
+	}
 
-			engine->pfd = (struct pollfd*)malloc (sizeof(struct pollfd) *
-							      (fixed_fd_cnt + clients));
+	engine->fd_clients[fd] = client;
+}
 
-			if (engine->pfd == NULL) {
-				/*
-				 * this can happen if limits.conf was changed
-				 * but the user hasn't logged out and back in yet
-				 */
-				if (errno == EAGAIN) {
-					jack_error ("malloc failed (%s) - make"
-						    "sure you log out and back"
-						    "in after changing limits"
-						    ".conf!", strerror (errno));
-				} else {
-					jack_error ("malloc failed (%s)", strerror (errno));
-				}
+/* Called with the graph write lock, before the fd is closed. */
+void
+jack_engine_unwatch_client (jack_engine_t *engine, jack_client_internal_t *client)
+{
+	int fd = client->request_fd;
 
-				break;
-			}
+	if (fd < 0 || fd >= engine->fd_clients_size ||
+	    engine->fd_clients[fd] != client) {
+		return;
+	}
+
+	/* it may be gone already if the socket failed */
+	epoll_ctl (engine->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	engine->fd_clients[fd] = NULL;
+}
+
+static int
+jack_engine_watch_fd (jack_engine_t *engine, int fd)
+{
+	struct epoll_event ev;
+
+	memset (&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+
+	return epoll_ctl (engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/* Wait for something to happen and deal with client requests. Only
+ * the fds that are ready are looked at, and the set of fds is only
+ * changed when clients come and go. What happened on the two server
+ * sockets is left in *listen_events and *ack_events as poll(2) bits.
+ * Returns -1 when the server thread should stop.
+ */
+static int
+jack_server_wait (jack_engine_t *engine, short *listen_events,
+		  short *ack_events)
+{
+	struct epoll_event events[JACK_SERVER_EPOLL_EVENTS];
+	jack_client_internal_t *client;
+	struct epoll_event ev;
+	int nready, i, fd;
+	short revents;
+	char c;
+
+	*listen_events = 0;
+	*ack_events = 0;
+
+	VERBOSE (engine, "start epoll wait");
+
+	if ((nready = epoll_wait (engine->epoll_fd, events,
+				  JACK_SERVER_EPOLL_EVENTS, -1)) < 0) {
+		if (errno == EINTR) {
+			return 0;
 		}
+		jack_error ("epoll_wait failed (%s)", strerror (errno));
+		return -1;
+	}
 
-		engine->pfd[0].fd = engine->fds[0];
-		engine->pfd[0].events = POLLIN | POLLERR;
-		engine->pfd[1].fd = engine->fds[1];
-		engine->pfd[1].events = POLLIN | POLLERR;
-		engine->pfd[2].fd = engine->cleanup_fifo[0];
-		engine->pfd[2].events = POLLIN | POLLERR;
-		engine->pfd_max = fixed_fd_cnt;
+	VERBOSE (engine, "server thread back from epoll, %d ready", nready);
 
-		for (node = engine->clients; node; node = node->next) {
+	pthread_testcancel ();
 
-			jack_client_internal_t* client = (jack_client_internal_t*)(node->data);
+	jack_rdlock_graph (engine);
 
-			if (client->request_fd < 0 || client->error >= JACK_ERROR_WITH_SOCKETS) {
-				continue;
+	for (i = 0; i < nready; i++) {
+
+		fd = events[i].data.fd;
+		revents = ((events[i].events & EPOLLIN ? POLLIN : 0) |
+			   (events[i].events & EPOLLPRI ? POLLPRI : 0) |
+			   (events[i].events & EPOLLERR ? POLLERR : 0) |
+			   (events[i].events & EPOLLHUP ? POLLHUP : 0));
+
+		if (fd == engine->cleanup_fifo[0]) {
+			if (revents & ~POLLIN) {
+				/* time to die */
+				jack_unlock_graph (engine);
+				return -1;
 			}
-			if ( client->control->dead ) {
-				engine->pfd[engine->pfd_max].fd = client->request_fd;
-				engine->pfd[engine->pfd_max].events = POLLHUP | POLLNVAL;
-				engine->pfd_max++;
-				continue;
+			while (read (engine->cleanup_fifo[0], &c, 1) == 1) ;
+			continue;
+		}
+
+		if (fd == engine->fds[0]) {
+			*listen_events = revents;
+			continue;
+		}
+
+		if (fd == engine->fds[1]) {
+			*ack_events = revents;
+			continue;
+		}
+
+		client = (fd < engine->fd_clients_size ?
+			  engine->fd_clients[fd] : NULL);
+
+		if (client == NULL ||
+		    client->error >= JACK_ERROR_WITH_SOCKETS) {
+			/* on its way out: stop listening */
+			epoll_ctl (engine->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+			continue;
+		}
+
+		if (client->control->dead && !(revents & ~(POLLIN | POLLPRI))) {
+			/* only a hangup is of interest from now on */
+			memset (&ev, 0, sizeof(ev));
+			ev.data.fd = fd;
+			epoll_ctl (engine->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+			continue;
+		}
+
+		if (revents & ~POLLIN) {
+
+			jack_mark_client_socket_error (engine, fd);
+			jack_engine_signal_problems (engine);
+			VERBOSE (engine, "non-POLLIN events on fd %d", fd);
+		} else if (revents & POLLIN) {
+
+			if (handle_external_client_request (engine, fd)) {
+				jack_error ("could not handle external"
+					    " client request");
+				jack_engine_signal_problems (engine);
 			}
-			engine->pfd[engine->pfd_max].fd = client->request_fd;
-			engine->pfd[engine->pfd_max].events = POLLIN | POLLPRI | POLLERR | POLLHUP | POLLNVAL;
-			engine->pfd_max++;
 		}
+	}
 
-		jack_unlock_graph (engine);
+	jack_unlock_graph (engine);
 
-		VERBOSE (engine, "start poll on %d fd's", engine->pfd_max);
+	return 0;
+}
 
-		/* go to sleep for a long, long time, or until a request
-		   arrives, or until a communication channel is broken
-		 */
+#else /* !JACK_USE_EPOLL */
 
-		if (poll (engine->pfd, engine->pfd_max, -1) < 0) {
-			if (errno == EINTR) {
-				continue;
+/* the server thread picks clients up from engine->clients every
+   time around */
+
+void
+jack_engine_watch_client (jack_engine_t *engine, jack_client_internal_t *client)
+{
+}
+
+void
+jack_engine_unwatch_client (jack_engine_t *engine, jack_client_internal_t *client)
+{
+}
+
+/* Wait for something to happen and deal with client requests. What
+ * happened on the two server sockets is left in *listen_events and
+ * *ack_events. Returns -1 when the server thread should stop.
+ */
+static int
+jack_server_wait (jack_engine_t *engine, short *listen_events,
+		  short *ack_events)
+{
+	const int fixed_fd_cnt = 3;
+	JSList* node;
+	int clients;
+	int i;
+
+	*listen_events = 0;
+	*ack_events = 0;
+
+	jack_rdlock_graph (engine);
+
+	clients = jack_slist_length (engine->clients);
+
+	if (engine->pfd_size < fixed_fd_cnt + clients) {
+		if (engine->pfd) {
+			free (engine->pfd);
+		}
+
+		engine->pfd = (struct pollfd*)malloc (sizeof(struct pollfd) *
+						      (fixed_fd_cnt + clients));
+
+		if (engine->pfd == NULL) {
+			/*
+			 * this can happen if limits.conf was changed
+			 * but the user hasn't logged out and back in yet
+			 */
+			if (errno == EAGAIN) {
+				jack_error ("malloc failed (%s) - make"
+					    "sure you log out and back"
+					    "in after changing limits"
+					    ".conf!", strerror (errno));
+			} else {
+				jack_error ("malloc failed (%s)", strerror (errno));
 			}
-			jack_error ("poll failed (%s)", strerror (errno));
-			break;
+
+			engine->pfd_size = 0;
+			jack_unlock_graph (engine);
+			return -1;
 		}
 
-		VERBOSE (engine, "server thread back from poll");
+		engine->pfd_size = fixed_fd_cnt + clients;
+	}
 
-		/* Stephane Letz: letz@grame.fr : has to be added
-		 * otherwise pthread_cancel() does not work on MacOSX */
-		pthread_testcancel ();
+	engine->pfd[0].fd = engine->fds[0];
+	engine->pfd[0].events = POLLIN | POLLERR;
+	engine->pfd[1].fd = engine->fds[1];
+	engine->pfd[1].events = POLLIN | POLLERR;
+	engine->pfd[2].fd = engine->cleanup_fifo[0];
+	engine->pfd[2].events = POLLIN | POLLERR;
+	engine->pfd_max = fixed_fd_cnt;
 
+	for (node = engine->clients; node; node = node->next) {
 
-		/* empty cleanup FIFO if necessary */
+		jack_client_internal_t* client = (jack_client_internal_t*)(node->data);
 
-		if (engine->pfd[2].revents & ~POLLIN) {
-			/* time to die */
-			break;
+		if (client->request_fd < 0 || client->error >= JACK_ERROR_WITH_SOCKETS) {
+			continue;
+		}
+		if ( client->control->dead ) {
+			engine->pfd[engine->pfd_max].fd = client->request_fd;
+			engine->pfd[engine->pfd_max].events = POLLHUP | POLLNVAL;
+			engine->pfd_max++;
+			continue;
 		}
+		engine->pfd[engine->pfd_max].fd = client->request_fd;
+		engine->pfd[engine->pfd_max].events = POLLIN | POLLPRI | POLLERR | POLLHUP | POLLNVAL;
+		engine->pfd_max++;
+	}
 
-		if (engine->pfd[2].revents & POLLIN) {
-			char c;
-			while (read (engine->cleanup_fifo[0], &c, 1) == 1) ;
+	jack_unlock_graph (engine);
+
+	VERBOSE (engine, "start poll on %d fd's", engine->pfd_max);
+
+	/* go to sleep for a long, long time, or until a request
+	   arrives, or until a communication channel is broken
+	 */
+
+	if (poll (engine->pfd, engine->pfd_max, -1) < 0) {
+		if (errno == EINTR) {
+			return 0;
 		}
+		jack_error ("poll failed (%s)", strerror (errno));
+		return -1;
+	}
 
-		/* check each client socket before handling other request*/
+	VERBOSE (engine, "server thread back from poll");
 
-		jack_rdlock_graph (engine);
+	/* Stephane Letz: letz@grame.fr : has to be added
+	 * otherwise pthread_cancel() does not work on MacOSX */
+	pthread_testcancel ();
 
-		for (i = fixed_fd_cnt; i < engine->pfd_max; i++) {
 
-			if (engine->pfd[i].fd < 0) {
-				continue;
-			}
+	/* empty cleanup FIFO if necessary */
 
-			if (engine->pfd[i].revents & ~POLLIN) {
+	if (engine->pfd[2].revents & ~POLLIN) {
+		/* time to die */
+		return -1;
+	}
 
-				jack_mark_client_socket_error (engine, engine->pfd[i].fd);
-				jack_engine_signal_problems (engine);
-				VERBOSE (engine, "non-POLLIN events on fd %d", engine->pfd[i].fd);
-			} else if (engine->pfd[i].revents & POLLIN) {
+	if (engine->pfd[2].revents & POLLIN) {
+		char c;
+		while (read (engine->cleanup_fifo[0], &c, 1) == 1) ;
+	}
 
-				if (handle_external_client_request (engine, engine->pfd[i].fd)) {
-					jack_error ("could not handle external"
-						    " client request");
-					jack_engine_signal_problems (engine);
-				}
+	/* check each client socket before handling other request*/
+
+	jack_rdlock_graph (engine);
+
+	for (i = fixed_fd_cnt; i < engine->pfd_max; i++) {
+
+		if (engine->pfd[i].fd < 0) {
+			continue;
+		}
+
+		if (engine->pfd[i].revents & ~POLLIN) {
+
+			jack_mark_client_socket_error (engine, engine->pfd[i].fd);
+			jack_engine_signal_problems (engine);
+			VERBOSE (engine, "non-POLLIN events on fd %d", engine->pfd[i].fd);
+		} else if (engine->pfd[i].revents & POLLIN) {
+
+			if (handle_external_client_request (engine, engine->pfd[i].fd)) {
+				jack_error ("could not handle external"
+					    " client request");
+				jack_engine_signal_problems (engine);
 			}
 		}
+	}
+
+	jack_unlock_graph (engine);
 
-		problemsProblemsPROBLEMS = engine->problems;
+	*listen_events = engine->pfd[0].revents;
+	*ack_events = engine->pfd[1].revents;
 
-		jack_unlock_graph (engine);
+	return 0;
+}
+
+#endif /* JACK_USE_EPOLL */
+
+static void *
+jack_server_thread (void *arg)
+
+{
+	jack_engine_t *engine = (jack_engine_t*)arg;
+	struct sockaddr_un client_addr;
+	socklen_t client_addrlen;
+	int problemsProblemsPROBLEMS = 0;
+	int client_socket;
+	int done = 0;
+	int stop_freewheeling;
+	short listen_events, ack_events;
+
+	while (!done) {
+
+		if (jack_server_wait (engine, &listen_events, &ack_events)) {
+			break;
+		}
+
+		problemsProblemsPROBLEMS = __atomic_load_n (&engine->problems,
+							    __ATOMIC_ACQUIRE);
 
 		/* need to take write lock since we may/will rip out some clients,
 		   and reset engine->problems
@@ -1684,10 +2873,10 @@ jack_server_thread (void *arg)
 			}
 			jack_unlock_graph (engine);
 
-			jack_lock_problems (engine);
-			engine->problems -= problemsProblemsPROBLEMS;
-			problemsProblemsPROBLEMS = engine->problems;
-			jack_unlock_problems (engine);
+			problemsProblemsPROBLEMS =
+				__atomic_sub_fetch (&engine->problems,
+						    problemsProblemsPROBLEMS,
+						    __ATOMIC_ACQ_REL);
 
 			VERBOSE (engine, "after removing clients, problems = %d", problemsProblemsPROBLEMS);
 		}
@@ -1696,15 +2885,17 @@ jack_server_thread (void *arg)
 			jack_stop_freewheeling (engine, 0);
 		}
 
+		jack_deliver_xruns (engine);
+
 		/* check the master server socket */
 
-		if (engine->pfd[0].revents & POLLERR) {
+		if (listen_events & POLLERR) {
 			jack_error ("error on server socket");
 			break;
 		}
 
-		if (engine->control->engine_ok && engine->pfd[0].revents & POLLIN) {
-			DEBUG ("pfd[0].revents & POLLIN");
+		if (engine->control->engine_ok && listen_events & POLLIN) {
+			DEBUG ("server socket ready");
 
 			memset (&client_addr, 0, sizeof(client_addr));
 			client_addrlen = sizeof(client_addr);
@@ -1724,13 +2915,13 @@ jack_server_thread (void *arg)
 
 		/* check the ACK server socket */
 
-		if (engine->pfd[1].revents & POLLERR) {
+		if (ack_events & POLLERR) {
 			jack_error ("error on server ACK socket");
 			break;
 		}
 
-		if (engine->control->engine_ok && engine->pfd[1].revents & POLLIN) {
-			DEBUG ("pfd[1].revents & POLLIN");
+		if (engine->control->engine_ok && ack_events & POLLIN) {
+			DEBUG ("ACK socket ready");
 
 			memset (&client_addr, 0, sizeof(client_addr));
 			client_addrlen = sizeof(client_addr);
@@ -1757,7 +2948,9 @@ jack_engine_t *
 jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 		 const char *server_name, int temporary, int verbose,
 		 int client_timeout, unsigned int port_max, pid_t wait_pid,
-		 jack_nframes_t frame_time_offset, int nozombies, int timeout_count_threshold, JSList *drivers)
+		 jack_nframes_t frame_time_offset, int nozombies, int timeout_count_threshold,
+		 int parallel, int futex_wakeup, int share_buffers,
+		 int share_mixdowns, JSList *drivers)
 {
 	jack_engine_t *engine;
 	unsigned int i;
@@ -1816,6 +3009,7 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	engine->client_timeout_msecs = client_timeout;
 	engine->timeout_count = 0;
 	engine->problems = 0;
+	engine->xruns_pending = 0;
 
 	engine->port_max = port_max;
 	engine->server_thread = 0;
@@ -1831,6 +3025,34 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	engine->wait_pid = wait_pid;
 	engine->nozombies = nozombies;
 	engine->timeout_count_threshold = timeout_count_threshold;
+#ifdef JACK_USE_MACH_THREADS
+	if (parallel) {
+		jack_error ("parallel graph execution is not supported "
+			    "with Mach threads; running serially");
+	}
+	engine->parallel = 0;
+#else
+	engine->parallel = parallel;
+#endif
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	engine->futex_wakeup = futex_wakeup;
+#else
+	if (futex_wakeup) {
+		jack_error ("futex wakeups are not supported on this "
+			    "platform; using FIFOs");
+	}
+	engine->futex_wakeup = 0;
+#endif
+	if (share_buffers && engine->parallel) {
+		jack_error ("port buffers cannot be shared when running "
+			    "in parallel; not sharing");
+		share_buffers = 0;
+	}
+	engine->share_buffers = share_buffers;
+	engine->share_mixdowns = share_mixdowns;
+	engine->live_pos = NULL;
+	engine->live_next = NULL;
+	engine->live_changed = 0;
 	engine->removing_clients = 0;
 	engine->new_clients_allowed = 1;
 
@@ -1848,7 +3070,8 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	pthread_rwlock_init (&engine->client_lock, 0);
 	pthread_mutex_init (&engine->port_lock, 0);
 	pthread_mutex_init (&engine->request_lock, 0);
-	pthread_mutex_init (&engine->problem_lock, 0);
+	pthread_mutex_init (&engine->rt_lock, 0);
+	pthread_mutex_init (&engine->event_lock, 0);
 
 	engine->clients = 0;
 	engine->reserved_client_names = 0;
@@ -1857,6 +3080,13 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	engine->pfd_max = 0;
 	engine->pfd = 0;
 
+	engine->plan = NULL;
+	engine->plan_in_use = NULL;
+	engine->plans_retired = NULL;
+	engine->plan_version = 0;
+	engine->lock_null_cycles = 0;
+	engine->problem_null_cycles = 0;
+
 	engine->fifo_size = 16;
 	engine->fifo = (int*)malloc (sizeof(int) * engine->fifo_size);
 	for (i = 0; i < engine->fifo_size; i++)
@@ -1899,6 +3129,10 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	engine->control = (jack_control_t*)
 			  jack_shm_addr (&engine->control_shm);
 
+	jack_engine_trace_init (engine);
+	jack_engine_graph_init (engine);
+	jack_engine_stats_init (engine);
+
 	/* Setup port type information from builtins. buffer space is
 	 * allocated when the driver calls jack_driver_buffer_size().
 	 */
@@ -1943,14 +3177,49 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	engine->internal_ports = (jack_port_internal_t*)
 				 malloc (sizeof(jack_port_internal_t) * engine->port_max);
 
-	for (i = 0; i < engine->port_max; i++)
+	for (i = 0; i < engine->port_max; i++) {
 		engine->internal_ports[i].connections = 0;
+		engine->internal_ports[i].live_buffer = NULL;
+	}
+
+	if (engine->share_buffers) {
+		engine->live_pos = (int*)
+				   malloc (sizeof(int) * engine->port_max);
+		engine->live_next = (jack_port_buffer_info_t**)
+				    malloc (sizeof(jack_port_buffer_info_t*) * engine->port_max);
+		if (engine->live_pos == NULL || engine->live_next == NULL) {
+			jack_error ("cannot allocate port buffer sharing tables");
+			return NULL;
+		}
+	}
+
+	if (jack_port_index_init (&engine->port_index, engine->port_max)) {
+		jack_error ("cannot allocate port name index");
+		return NULL;
+	}
 
 	if (make_sockets (engine->server_name, engine->fds) < 0) {
 		jack_error ("cannot create server sockets");
 		return NULL;
 	}
 
+#ifdef JACK_USE_EPOLL
+	engine->fd_clients = NULL;
+	engine->fd_clients_size = 0;
+
+	if ((engine->epoll_fd = epoll_create1 (EPOLL_CLOEXEC)) < 0) {
+		jack_error ("cannot create epoll instance (%s)", strerror (errno));
+		return NULL;
+	}
+
+	if (jack_engine_watch_fd (engine, engine->fds[0]) ||
+	    jack_engine_watch_fd (engine, engine->fds[1]) ||
+	    jack_engine_watch_fd (engine, engine->cleanup_fifo[0])) {
+		jack_error ("cannot watch server sockets (%s)", strerror (errno));
+		return NULL;
+	}
+#endif
+
 	engine->control->port_max = engine->port_max;
 	engine->control->real_time = realtime;
 
@@ -1970,6 +3239,14 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	engine->control->do_mlock = do_mlock;
 	engine->control->do_munlock = do_unlock;
 	engine->control->cpu_load = 0;
+	engine->control->futex_wakeup = 0;
+	engine->control->cycle = 0;
+	engine->control->lock_null_cycles = 0;
+	engine->control->problem_null_cycles = 0;
+	engine->control->port_generation = 0;
+	engine->control->share_mixdowns = share_mixdowns;
+	for (i = 0; i < JACK_WAKEUP_SLOTS; i++)
+		engine->control->wakeup[i].word = 0;
 	engine->control->xrun_delayed_usecs = 0;
 	engine->control->max_delayed_usecs = 0;
 
@@ -2038,6 +3315,10 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 
 	(void)jack_get_fifo_fd (engine, 0);
 
+	if (jack_publish_plan (engine)) {
+		return NULL;
+	}
+
 	jack_client_create_thread (NULL, &engine->server_thread, 0, FALSE,
 				   &jack_server_thread, engine);
 
@@ -2047,19 +3328,48 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 static void
 jack_engine_delay (jack_engine_t *engine, float delayed_usecs)
 {
-	jack_event_t event;
-
 	engine->control->frame_timer.reset_pending = 1;
 
 	engine->control->xrun_delayed_usecs = delayed_usecs;
+	engine->trace_xrun = 1;
 
 	if (delayed_usecs > engine->control->max_delayed_usecs) {
 		engine->control->max_delayed_usecs = delayed_usecs;
 	}
 
+	/* this is the driver thread, which must not wait for the graph
+	   lock or talk to clients: the server thread tells them */
+	__atomic_fetch_add (&engine->xruns_pending, 1, __ATOMIC_RELEASE);
+	jack_wake_server_thread (engine);
+}
+
+/* Send the XRuns jack_engine_delay() counted, one per xrun. Runs on
+ * the server thread.
+ */
+static void
+jack_deliver_xruns (jack_engine_t *engine)
+{
+	jack_event_t event;
+	JSList *node;
+	int xruns, i;
+
+	if ((xruns = __atomic_exchange_n (&engine->xruns_pending, 0,
+					  __ATOMIC_ACQ_REL)) == 0) {
+		return;
+	}
+
 	event.type = XRun;
 
-	jack_deliver_event_to_all (engine, &event);
+	/* nobody has to answer this one, so don't wait for them */
+	jack_rdlock_graph (engine);
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		for (i = 0; i < xruns; i++) {
+			jack_post_event (engine,
+					 (jack_client_internal_t*)node->data,
+					 &event);
+		}
+	}
+	jack_unlock_graph (engine);
 }
 
 static void*
@@ -2267,10 +3577,163 @@ jack_stop_freewheeling (jack_engine_t* engine, int engine_exiting)
 	return 0;
 }
 
-static int
+/* The cycle announces the plan it is about to run from in
+ * engine->plan_in_use, then checks that it is still the published one;
+ * jack_publish_plan() frees a plan only once it is neither. Sequential
+ * consistency orders the store before the second load on both sides.
+ */
+static inline jack_plan_t *
+jack_plan_acquire (jack_engine_t *engine)
+{
+	jack_plan_t *plan;
+
+	do {
+		plan = __atomic_load_n (&engine->plan, __ATOMIC_SEQ_CST);
+		__atomic_store_n (&engine->plan_in_use, plan, __ATOMIC_SEQ_CST);
+	} while (plan != __atomic_load_n (&engine->plan, __ATOMIC_SEQ_CST));
+
+	return plan;
+}
+
+static inline void
+jack_plan_release (jack_engine_t *engine)
+{
+	__atomic_store_n (&engine->plan_in_use, NULL, __ATOMIC_RELEASE);
+}
+
+/* Replace the published plan. Replaced plans wait on
+ * engine->plans_retired until a later call finds that the cycle is
+ * not running from them, so publishing never waits for a cycle to
+ * finish. Caller must hold client_lock.
+ */
+static void
+jack_plan_retire (jack_engine_t *engine, jack_plan_t *plan)
+{
+	jack_plan_t *old = engine->plan;
+	jack_plan_t *in_use, **prev, *p;
+
+	__atomic_store_n (&engine->plan, plan, __ATOMIC_SEQ_CST);
+
+	if (old) {
+		old->retired_next = engine->plans_retired;
+		engine->plans_retired = old;
+	}
+
+	in_use = __atomic_load_n (&engine->plan_in_use, __ATOMIC_SEQ_CST);
+
+	for (prev = &engine->plans_retired; (p = *prev) != NULL; ) {
+		if (p == in_use) {
+			prev = &p->retired_next;
+		} else {
+			*prev = p->retired_next;
+			free (p);
+		}
+	}
+}
+
+/* Wait for a cycle that may still run from a plan published before
+ * the current one to finish. The cycle acquires its plan under
+ * rt_lock and lets it go before unlocking, so once we have held the
+ * lock every later cycle runs from engine->plan. Caller must hold
+ * client_lock and not rt_lock.
+ */
+void
+jack_plan_quiesce (jack_engine_t *engine)
+{
+	jack_lock_rt (engine);
+	jack_unlock_rt (engine);
+}
+
+int
+jack_publish_plan (jack_engine_t *engine)
+{
+	/* caller must hold client_lock */
+
+	JSList *node, *fnode;
+	jack_client_internal_t *client, *peer;
+	jack_plan_entry_t *entry;
+	jack_plan_t *plan;
+	unsigned int nclients = 0, nsuccs = 0;
+	unsigned int *succs;
+	size_t size;
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		client->plan_index = nclients++;
+		nsuccs += jack_slist_length (client->sortfeeds);
+	}
+
+	/* one block: header, entries, scheduler tables, successors */
+	size = sizeof(jack_plan_t)
+	       + nclients * (sizeof(jack_plan_entry_t)
+			     + sizeof(jack_plan_entry_t*)
+			     + sizeof(struct pollfd))
+	       + nsuccs * sizeof(unsigned int);
+
+	if ((plan = (jack_plan_t*)malloc (size)) == NULL) {
+		/* the old plan may name clients that are about to go
+		   away, so it cannot be kept */
+		jack_error ("cannot allocate process plan; the engine "
+			    "will run null cycles until the graph changes");
+		jack_plan_retire (engine, NULL);
+		return -1;
+	}
+
+	plan->version = ++engine->plan_version;
+	plan->futex_wakeup = engine->control->futex_wakeup;
+	plan->nclients = nclients;
+	plan->clients = (jack_plan_entry_t*)(plan + 1);
+	plan->sched_client = (jack_plan_entry_t**)(plan->clients + nclients);
+	plan->sched_pfd = (struct pollfd*)(plan->sched_client + nclients);
+	succs = (unsigned int*)(plan->sched_pfd + nclients);
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		entry = &plan->clients[client->plan_index];
+
+		entry->client = client;
+		entry->control = client->control;
+		entry->internal = jack_client_is_internal (client);
+		entry->chained = !client->retiring &&
+				 client->control->active &&
+				 (client->control->process_cbset ||
+				  client->control->thread_cb_cbset);
+		entry->start_fd = client->subgraph_start_fd;
+		entry->wait_fd = client->subgraph_wait_fd;
+		entry->start_slot = client->subgraph_start_slot;
+		entry->wait_slot = client->subgraph_wait_slot;
+		entry->nsuccs = 0;
+		entry->npreds = 0;
+		entry->pending = 0;
+	}
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		entry = &plan->clients[client->plan_index];
+		entry->succs = succs;
+
+		for (fnode = client->sortfeeds; fnode;
+		     fnode = jack_slist_next (fnode)) {
+			peer = (jack_client_internal_t*)fnode->data;
+			entry->succs[entry->nsuccs++] = peer->plan_index;
+			plan->clients[peer->plan_index].npreds++;
+		}
+
+		succs += entry->nsuccs;
+	}
+
+	jack_plan_retire (engine, plan);
+
+	DEBUG ("published plan %lu with %u clients", plan->version, nclients);
+
+	return 0;
+}
+
+static int
 jack_check_client_status (jack_engine_t* engine)
 {
-	JSList *node;
+	jack_plan_t *plan = engine->plan_in_use;
+	unsigned int n;
 	int err = 0;
 
 	/* we are already late, or something else went wrong,
@@ -2278,10 +3741,8 @@ jack_check_client_status (jack_engine_t* engine)
 	   clients.
 	 */
 
-	for (node = engine->clients; node;
-	     node = jack_slist_next (node)) {
-		jack_client_internal_t *client =
-			(jack_client_internal_t*)node->data;
+	for (n = 0; n < plan->nclients; n++) {
+		jack_client_internal_t *client = plan->clients[n].client;
 
 		if (client->control->type == ClientExternal) {
 			if (kill (client->control->pid, 0)) {
@@ -2312,6 +3773,8 @@ jack_run_one_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 		    float delayed_usecs)
 {
 	jack_driver_t* driver = engine->driver;
+	jack_plan_t *plan;
+	int problems;
 	int ret = -1;
 	static int consecutive_excessive_delays = 0;
 
@@ -2340,8 +3803,9 @@ jack_run_one_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 		consecutive_excessive_delays = 0;
 	}
 
-	DEBUG ("trying to acquire read lock (FW = %d)", engine->freewheeling);
-	if (jack_try_rdlock_graph (engine)) {
+	DEBUG ("trying to acquire rt lock (FW = %d)", engine->freewheeling);
+	if (jack_trylock_rt (engine)) {
+		engine->control->lock_null_cycles = ++engine->lock_null_cycles;
 		VERBOSE (engine, "lock-driven null cycle");
 		if (!engine->freewheeling) {
 			driver->null_cycle (driver, nframes);
@@ -2352,22 +3816,16 @@ jack_run_one_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 		return 0;
 	}
 
-	if (jack_trylock_problems (engine)) {
-		VERBOSE (engine, "problem-lock-driven null cycle");
-		jack_unlock_graph (engine);
-		if (!engine->freewheeling) {
-			driver->null_cycle (driver, nframes);
-		} else {
-			/* don't return too fast */
-			usleep (1000);
-		}
-		return 0;
-	}
+	plan = jack_plan_acquire (engine);
+	problems = __atomic_load_n (&engine->problems, __ATOMIC_ACQUIRE);
 
-	if (engine->problems || (engine->timeout_count_threshold && (engine->timeout_count > (1 + engine->timeout_count_threshold * 1000 / engine->driver->period_usecs) ))) {
-		VERBOSE (engine, "problem-driven null cycle problems=%d", engine->problems);
-		jack_unlock_problems (engine);
-		jack_unlock_graph (engine);
+	if (plan == NULL || problems || (engine->timeout_count_threshold && (engine->timeout_count > (1 + engine->timeout_count_threshold * 1000 / engine->driver->period_usecs) ))) {
+		engine->control->problem_null_cycles =
+			++engine->problem_null_cycles;
+		VERBOSE (engine, "problem-driven null cycle problems=%d plan=%p",
+			 problems, plan);
+		jack_plan_release (engine);
+		jack_unlock_rt (engine);
 		if (!engine->freewheeling) {
 			driver->null_cycle (driver, nframes);
 		} else {
@@ -2377,7 +3835,11 @@ jack_run_one_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 		return 0;
 	}
 
-	jack_unlock_problems (engine);
+	/* clients key their cached input mixdowns on this; 0 means
+	   "nothing cached", so skip it when wrapping */
+	if (++engine->control->cycle == 0) {
+		engine->control->cycle = 1;
+	}
 
 	if (!engine->freewheeling) {
 		DEBUG ("waiting for driver read\n");
@@ -2388,7 +3850,7 @@ jack_run_one_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 
 	DEBUG ("run process\n");
 
-	if (jack_engine_process (engine, nframes) != 0) {
+	if (jack_engine_process (engine, plan, nframes) != 0) {
 		DEBUG ("engine process cycle failed");
 		jack_check_client_status (engine);
 	}
@@ -2408,7 +3870,8 @@ jack_run_one_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 	ret = 0;
 
 unlock:
-	jack_unlock_graph (engine);
+	jack_plan_release (engine);
+	jack_unlock_rt (engine);
 	DEBUG ("cycle finished, status = %d", ret);
 
 	return ret;
@@ -2543,6 +4006,7 @@ jack_run_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 void
 jack_engine_delete (jack_engine_t *engine)
 {
+	jack_plan_t *plan;
 	int i;
 
 	if (engine == NULL) {
@@ -2555,10 +4019,12 @@ jack_engine_delete (jack_engine_t *engine)
 
 	engine->control->engine_ok = 0; /* tell clients we're going away */
 
-	/* this will wake the server thread and cause it to exit */
+	/* this will wake the server thread and cause it to exit. The
+	   write end goes first: closing the read end would silently
+	   take it out of the epoll set. */
 
-	close (engine->cleanup_fifo[0]);
 	close (engine->cleanup_fifo[1]);
+	close (engine->cleanup_fifo[0]);
 
 	/* shutdown master socket to prevent new clients arriving */
 	shutdown (engine->fds[0], SHUT_RDWR);
@@ -2566,8 +4032,14 @@ jack_engine_delete (jack_engine_t *engine)
 
 	/* now really tell them we're going away */
 
+#ifdef JACK_USE_EPOLL
+	for (i = 0; i < engine->fd_clients_size; ++i)
+		if (engine->fd_clients[i])
+			shutdown (i, SHUT_RDWR);
+#else
 	for (i = 0; i < engine->pfd_max; ++i)
 		shutdown (engine->pfd[i].fd, SHUT_RDWR);
+#endif
 
 	if (engine->driver) {
 		jack_driver_t* driver = engine->driver;
@@ -2605,14 +4077,58 @@ jack_engine_delete (jack_engine_t *engine)
 	VERBOSE (engine, "max delay reported by backend: %.3f usecs",
 		 engine->control->max_delayed_usecs);
 
+	if (engine->trace) {
+		VERBOSE (engine, "freeing cycle trace memory");
+		engine->trace = NULL;
+		jack_release_shm (&engine->trace_shm);
+		jack_destroy_shm (&engine->trace_shm);
+	}
+
+	if (engine->graph) {
+		VERBOSE (engine, "freeing connection snapshot memory");
+		engine->graph = NULL;
+		jack_release_shm (&engine->graph_shm);
+		jack_destroy_shm (&engine->graph_shm);
+		free (engine->graph_scratch);
+	}
+
+	if (engine->stats) {
+		VERBOSE (engine, "freeing client statistics memory");
+		engine->stats = NULL;
+		jack_release_shm (&engine->stats_shm);
+		jack_destroy_shm (&engine->stats_shm);
+		free (engine->stats_window);
+	}
+
 	/* free engine control shm segment */
 	engine->control = NULL;
 	VERBOSE (engine, "freeing engine shared memory");
 	jack_release_shm (&engine->control_shm);
 	jack_destroy_shm (&engine->control_shm);
 
+	VERBOSE (engine, "null cycles: %lu lock-driven, %lu problem-driven",
+		 engine->lock_null_cycles, engine->problem_null_cycles);
+	VERBOSE (engine, "graph reorders: %lu clients notified, %lu skipped",
+		 engine->reorder_sent, engine->reorder_skipped);
+	VERBOSE (engine, "latency callbacks: %lu delivered, %lu skipped",
+		 engine->latency_sent, engine->latency_skipped);
+	VERBOSE (engine, "event rings: %lu queued, %lu wakeups, %lu overflowed",
+		 engine->events_queued, engine->events_kicked,
+		 engine->events_overflow);
 	VERBOSE (engine, "max usecs: %.3f, engine deleted", engine->max_usecs);
 
+	free (engine->plan);
+	while ((plan = engine->plans_retired) != NULL) {
+		engine->plans_retired = plan->retired_next;
+		free (plan);
+	}
+#ifdef JACK_USE_EPOLL
+	free (engine->fd_clients);
+	close (engine->epoll_fd);
+#endif
+	free (engine->live_pos);
+	free (engine->live_next);
+	jack_port_index_free (&engine->port_index);
 	free (engine);
 
 	jack_messagebuffer_exit ();
@@ -2921,7 +4437,7 @@ jack_notify_all_port_interested_clients (jack_engine_t *engine, jack_uuid_t src,
 		if (src_client != client &&  dst_client  != client && client->control->port_connect_cbset != FALSE) {
 
 			/* one of the ports belong to this client or it has a port connect callback */
-			jack_deliver_event (engine, client, &event);
+			jack_post_event (engine, client, &event);
 		}
 	}
 }
@@ -2976,8 +4492,18 @@ jack_deliver_event (jack_engine_t *engine, jack_client_internal_t *client,
 		switch (event->type) {
 		case PortConnected:
 		case PortDisconnected:
-			jack_client_handle_port_connection
-				(client->private_client, event);
+			/* process() walks these lists in the cycle; an
+			   inactive client is not run, so no need to hold
+			   up the cycle for it */
+			if (client->control->active) {
+				jack_lock_rt (engine);
+				jack_client_handle_port_connection
+					(client->private_client, event);
+				jack_unlock_rt (engine);
+			} else {
+				jack_client_handle_port_connection
+					(client->private_client, event);
+			}
 			break;
 
 		case BufferSizeChange:
@@ -3063,6 +4589,18 @@ jack_deliver_event (jack_engine_t *engine, jack_client_internal_t *client,
 				}
 			}
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+			/* a client chained through a wakeup slot sleeps on
+			   the futex rather than in poll(2) on the event fd,
+			   unless another thread of its own reads events
+			 */
+			if (client->wakeup_slot >= 0
+			    && !client->control->events_elsewhere) {
+				jack_wakeup_signal (&engine->control->wakeup[client->wakeup_slot],
+						    JACK_WAKEUP_EVENT);
+			}
+#endif
+
 			if (client->error) {
 				status = -1;
 			} else {
@@ -3185,25 +4723,212 @@ again:
 	return status;
 }
 
-int
-jack_rechain_graph (jack_engine_t *engine)
+/* Tell an external client that its event ring has something in it. */
+static void
+jack_kick_client (jack_engine_t *engine, jack_client_internal_t *client)
 {
-	JSList *node, *next;
-	unsigned long n;
-	int err = 0;
-	jack_client_internal_t *subgraph_client, *next_client;
 	jack_event_t event;
-	int upstream_is_jackd;
 
 	VALGRIND_MEMSET (&event, 0, sizeof(event));
 
-	jack_clear_fifos (engine);
+	event.type = EventsQueued;
 
-	subgraph_client = 0;
+	if (write (client->event_fd, &event, sizeof(event)) != sizeof(event)) {
+		jack_error ("cannot send event to client [%s] (%s)",
+			    client->control->name,
+			    strerror (errno));
+		client->error += JACK_ERROR_WITH_SOCKETS;
+		jack_engine_signal_problems (engine);
+		return;
+	}
 
-	VERBOSE (engine, "++ jack_rechain_graph():");
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (client->wakeup_slot >= 0 && !client->control->events_elsewhere) {
+		jack_wakeup_signal (&engine->control->wakeup[client->wakeup_slot],
+				    JACK_WAKEUP_EVENT);
+	}
+#endif
+}
+
+/* Deliver a notification whose answer nobody looks at. For external
+ * clients it goes into the client's event ring and we move on without
+ * waiting; only a client that had caught up with its ring is woken,
+ * so a burst of notifications costs one wakeup. Events still arrive
+ * in the order they were sent: the client empties its ring before it
+ * handles anything that comes over the socket. If the ring is full,
+ * or the client is not active and has no ring in use, this falls back
+ * to jack_deliver_event(), which waits.
+ */
+static int
+jack_post_event (jack_engine_t *engine, jack_client_internal_t *client,
+		 const jack_event_t *event)
+{
+	jack_client_control_t *ctl = client->control;
+	uint32_t head, tail;
+	int kick;
+
+	if (jack_client_is_internal (client)) {
+		return jack_deliver_event (engine, client, event);
+	}
+
+	if (ctl->dead || client->error >= JACK_ERROR_WITH_SOCKETS) {
+		return 0;
+	}
+
+	if (!ctl->active) {
+		return jack_deliver_event (engine, client, event);
+	}
+
+	pthread_mutex_lock (&engine->event_lock);
+
+	head = ctl->event_head;
+	tail = __atomic_load_n (&ctl->event_tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= JACK_EVENT_RING_SIZE) {
+		engine->events_overflow++;
+		pthread_mutex_unlock (&engine->event_lock);
+		return jack_deliver_event (engine, client, event);
+	}
+
+	memcpy ((void*)&ctl->event_ring[head & (JACK_EVENT_RING_SIZE - 1)],
+		event, sizeof(*event));
+
+	/* pairs with the client storing its tail and then reading
+	   the head again: either it sees this event, or we see
+	   that it had run dry and needs waking */
+	__atomic_store_n (&ctl->event_head, head + 1, __ATOMIC_SEQ_CST);
+	kick = (__atomic_load_n (&ctl->event_tail, __ATOMIC_SEQ_CST) == head);
+
+	engine->events_queued++;
+	if (kick) {
+		engine->events_kicked++;
+	}
+
+	pthread_mutex_unlock (&engine->event_lock);
+
+	if (kick) {
+		jack_kick_client (engine, client);
+	}
+
+	return 0;
+}
+
+/* Tell an external client where it now sits in the chain. */
+static void
+jack_deliver_reorder (jack_engine_t *engine, jack_client_internal_t *client,
+		      unsigned long *sent)
+{
+	jack_event_t event;
+
+	VALGRIND_MEMSET (&event, 0, sizeof(event));
 
 	event.type = GraphReordered;
+	event.x.n = client->chain_order;
+	event.y.n = client->chain_upstream;
+
+	client->reorder_order = client->chain_order;
+	client->reorder_upstream = client->chain_upstream;
+	jack_deliver_event (engine, client, &event);
+	engine->reorder_sent++;
+	(*sent)++;
+}
+
+/* Record an external client's new place in the chain. Reopening the
+ * FIFOs stalls the client, and must happen between two cycles, so only
+ * those whose position or upstream changed count as moved.
+ */
+static void
+jack_chain_client (jack_client_internal_t *client, unsigned long order,
+		   int upstream_is_jackd, int force)
+{
+	client->chain_moved = force ||
+			      client->reorder_order != (long)order ||
+			      client->reorder_upstream != upstream_is_jackd;
+	client->chain_order = order;
+	client->chain_upstream = upstream_is_jackd;
+}
+
+/* Clients that drop out of the chain must be told again when they
+ * come back.
+ */
+static void
+jack_unchain_client (jack_client_internal_t *client)
+{
+	client->chain_order = -1;
+	client->chain_upstream = -1;
+	client->chain_moved = 0;
+	client->reorder_order = -1;
+	client->reorder_upstream = -1;
+}
+
+#ifndef JACK_USE_MACH_THREADS
+
+/* Chain setup for parallel execution: every active external client is
+ * a subgraph of its own, waiting on FIFO n and signalling completion
+ * on FIFO n+1, which only the server reads. Clients see nothing
+ * different from an ordinary chain whose upstream is jackd.
+ */
+static void
+jack_rechain_graph_parallel (jack_engine_t *engine, int force)
+{
+	JSList *node;
+	unsigned long n = 0;
+	jack_client_internal_t *client;
+
+	VERBOSE (engine, "++ jack_rechain_graph_parallel():");
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+
+		client = (jack_client_internal_t*)node->data;
+
+		client->next_client = NULL;
+
+		if (!client->control->active ||
+		    (!client->control->process_cbset && !client->control->thread_cb_cbset)) {
+			jack_unchain_client (client);
+			continue;
+		}
+
+		client->execution_order = n;
+
+		if (jack_client_is_internal (client)) {
+			VERBOSE (engine, "client %s: internal client, "
+				 "execution_order=%lu.",
+				 client->control->name, n);
+			client->chain_order = n;
+			client->chain_moved = 0;
+			continue;
+		}
+
+		client->subgraph_start_fd = jack_get_fifo_fd (engine, n);
+		client->subgraph_wait_fd = jack_get_fifo_fd (engine, n + 1);
+
+		VERBOSE (engine, "client %s: start_fd=%d, wait_fd=%d, "
+			 "execution_order=%lu.", client->control->name,
+			 client->subgraph_start_fd, client->subgraph_wait_fd, n);
+
+		jack_chain_client (client, n, 1, force);
+		client->wakeup_slot = -1;
+		n += 2;
+	}
+
+	VERBOSE (engine, "-- jack_rechain_graph_parallel()");
+}
+
+#endif /* !JACK_USE_MACH_THREADS */
+
+static void
+jack_rechain_graph_serial (jack_engine_t *engine, int futex_wakeup,
+			   int force)
+{
+	JSList *node, *next;
+	unsigned long n;
+	jack_client_internal_t *subgraph_client, *next_client;
+	int upstream_is_jackd;
+
+	subgraph_client = 0;
+
+	VERBOSE (engine, "++ jack_rechain_graph_serial():");
 
 	for (n = 0, node = engine->clients, next = NULL; node; node = next) {
 
@@ -3212,13 +4937,16 @@ jack_rechain_graph (jack_engine_t *engine)
 		next = jack_slist_next (node);
 
 		if (!client->control->process_cbset && !client->control->thread_cb_cbset) {
+			jack_unchain_client (client);
 			continue;
 		}
 
 		VERBOSE (engine, "+++ client is now %s active ? %d",
 			 client->control->name, client->control->active);
 
-		if (client->control->active) {
+		if (!client->control->active) {
+			jack_unchain_client (client);
+		} else {
 
 			/* find the next active client. its ok for
 			 * this to be NULL */
@@ -3250,6 +4978,7 @@ jack_rechain_graph (jack_engine_t *engine)
 				 * client. */
 
 				if (subgraph_client) {
+					subgraph_client->subgraph_wait_slot = n;
 					subgraph_client->subgraph_wait_fd =
 						jack_get_fifo_fd (engine, n);
 					VERBOSE (engine, "client %s: wait_fd="
@@ -3267,11 +4996,8 @@ jack_rechain_graph (jack_engine_t *engine)
 					 "%lu.",
 					 client->control->name, n);
 
-				/* this does the right thing for
-				 * internal clients too
-				 */
-
-				jack_deliver_event (engine, client, &event);
+				client->chain_order = n;
+				client->chain_moved = 0;
 
 				subgraph_client = 0;
 
@@ -3286,6 +5012,7 @@ jack_rechain_graph (jack_engine_t *engine)
 					 */
 
 					subgraph_client = client;
+					subgraph_client->subgraph_start_slot = n;
 					subgraph_client->subgraph_start_fd =
 						jack_get_fifo_fd (engine, n);
 					VERBOSE (engine, "client %s: "
@@ -3312,6 +5039,7 @@ jack_rechain_graph (jack_engine_t *engine)
 						 subgraph_client->
 						 control->name, n);
 					subgraph_client->subgraph_wait_fd = -1;
+					subgraph_client->subgraph_wait_slot = -1;
 
 					/* this external client after
 					   this will have another
@@ -3327,15 +5055,17 @@ jack_rechain_graph (jack_engine_t *engine)
 				 */
 				(void)jack_get_fifo_fd (
 					engine, client->execution_order + 1);
-				event.x.n = client->execution_order;
-				event.y.n = upstream_is_jackd;
-				jack_deliver_event (engine, client, &event);
+				jack_chain_client (client, client->execution_order,
+						   upstream_is_jackd, force);
+				client->wakeup_slot = (futex_wakeup ?
+						       (int)client->execution_order : -1);
 				n++;
 			}
 		}
 	}
 
 	if (subgraph_client) {
+		subgraph_client->subgraph_wait_slot = n;
 		subgraph_client->subgraph_wait_fd =
 			jack_get_fifo_fd (engine, n);
 		VERBOSE (engine, "client %s: wait_fd=%d, "
@@ -3344,121 +5074,146 @@ jack_rechain_graph (jack_engine_t *engine)
 			 subgraph_client->subgraph_wait_fd, n);
 	}
 
-	VERBOSE (engine, "-- jack_rechain_graph()");
-
-	return err;
+	VERBOSE (engine, "-- jack_rechain_graph_serial()");
 }
 
-static jack_nframes_t
-jack_get_port_total_latency (jack_engine_t *engine,
-			     jack_port_internal_t *port, int hop_count,
-			     int toward_port)
+/* Lay out the chain again and publish a plan for it. The cycle keeps
+ * running from the old plan meanwhile; it only has to stop when some
+ * external client moves, because that client must reopen its FIFOs
+ * before the first cycle that uses the new chain.
+ */
+int
+jack_rechain_graph (jack_engine_t *engine)
 {
 	JSList *node;
-	jack_nframes_t latency;
-	jack_nframes_t max_latency = 0;
-
-#ifdef DEBUG_TOTAL_LATENCY_COMPUTATION
-	char prefix[32];
-	int i;
-
-	for (i = 0; i < hop_count; ++i)
-		prefix[i] = '\t';
-
-	prefix[i] = '\0';
-#endif
+	jack_client_internal_t *client;
+	jack_event_t event;
+	int futex_wakeup = 0;
+	int force;
+	int err;
+	unsigned long moved = 0, sent = 0, nexternal = 0;
 
-	/* call tree must hold engine->client_lock. */
+	VALGRIND_MEMSET (&event, 0, sizeof(event));
 
-	latency = port->shared->latency;
+	VERBOSE (engine, "++ jack_rechain_graph():");
 
-	/* we don't prevent cyclic graphs, so we have to do something
-	   to bottom out in the event that they are created.
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	/* every hop needs a slot of its own; rather than run out,
+	   fall back to FIFOs until the graph shrinks again.
 	 */
+	futex_wakeup =
+		engine->futex_wakeup && !engine->parallel &&
+		(2 * jack_slist_length (engine->clients) + 2 <= JACK_WAKEUP_SLOTS);
 
-	if (hop_count > 8) {
-		return latency;
+	if (engine->futex_wakeup && !engine->parallel && !futex_wakeup) {
+		VERBOSE (engine, "too many clients for futex wakeups, "
+			 "using FIFOs");
 	}
-
-#ifdef DEBUG_TOTAL_LATENCY_COMPUTATION
-	jack_info ("%sFor port %s (%s)", prefix, port->shared->name, (toward_port ? "toward" : "away"));
 #endif
 
-	for (node = port->connections; node; node = jack_slist_next (node)) {
-
-		jack_nframes_t this_latency;
-		jack_connection_internal_t *connection;
+	/* switching between FIFOs and wakeup slots changes what every
+	   client waits on, even if its position stays the same */
+	force = (futex_wakeup != engine->control->futex_wakeup);
 
-		connection = (jack_connection_internal_t*)node->data;
+#ifndef JACK_USE_MACH_THREADS
+	if (engine->parallel) {
+		jack_rechain_graph_parallel (engine, force);
+	} else
+#endif
+	jack_rechain_graph_serial (engine, futex_wakeup, force);
 
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		if (!jack_client_is_internal (client) &&
+		    client->chain_order >= 0) {
+			nexternal++;
+			if (client->chain_moved) {
+				moved++;
+			}
+		}
+	}
 
-		if ((toward_port &&
-		     (connection->source->shared == port->shared)) ||
-		    (!toward_port &&
-		     (connection->destination->shared == port->shared))) {
+	/* new port buffer assignments go with the new order */
 
-#ifdef DEBUG_TOTAL_LATENCY_COMPUTATION
-			jack_info ("%s\tskip connection %s->%s",
-				   prefix,
-				   connection->source->shared->name,
-				   connection->destination->shared->name);
+	if (moved || force || engine->live_changed) {
+		jack_lock_rt (engine);
+		jack_clear_fifos (engine);
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+		engine->control->futex_wakeup = futex_wakeup;
+		jack_clear_wakeups (engine);
 #endif
+		if (engine->live_changed) {
+			jack_apply_shared_buffers (engine);
+		}
+		for (node = engine->clients; node; node = jack_slist_next (node)) {
+			client = (jack_client_internal_t*)node->data;
+			if (client->chain_moved) {
+				jack_deliver_reorder (engine, client, &sent);
+			}
+		}
+		err = jack_publish_plan (engine);
+		jack_unlock_rt (engine);
+	} else {
+		err = jack_publish_plan (engine);
+	}
+
+	/* everybody else only needs to know if they asked */
+
+	event.type = GraphReordered;
 
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		if (client->chain_order < 0 || client->chain_moved) {
 			continue;
 		}
+		if (jack_client_is_internal (client)) {
+			jack_deliver_event (engine, client, &event);
+		} else if (client->control->graph_order_cbset) {
+			jack_deliver_reorder (engine, client, &sent);
+		} else {
+			engine->reorder_skipped++;
+		}
+	}
 
-#ifdef DEBUG_TOTAL_LATENCY_COMPUTATION
-		jack_info ("%s\tconnection %s->%s ... ",
-			   prefix,
-			   connection->source->shared->name,
-			   connection->destination->shared->name);
-#endif
-		/* if we're a destination in the connection, recurse
-		   on the source to get its total latency
-		 */
-
-		if (connection->destination == port) {
+	VERBOSE (engine, "-- jack_rechain_graph(): %lu of %lu external "
+		 "clients notified, %lu moved", sent, nexternal, moved);
 
-			if (connection->source->shared->flags
-			    & JackPortIsTerminal) {
-				this_latency = connection->source->
-					       shared->latency;
-			} else {
-				this_latency =
-					jack_get_port_total_latency (
-						engine, connection->source,
-						hop_count + 1,
-						toward_port);
-			}
+	return err;
+}
 
-		} else {
+/* The old style total latency of a port is its own latency plus the
+ * largest latency of any port at the other end of its connections.
+ * Connections only join an output to an input, so this never goes
+ * further than one hop; each port is visited once per connection.
+ */
+static jack_nframes_t
+jack_get_port_total_latency (jack_engine_t *engine,
+			     jack_port_internal_t *port)
+{
+	JSList *node;
+	jack_connection_internal_t *connection;
+	jack_port_internal_t *other;
+	jack_nframes_t max_latency = 0;
 
-			/* "port" is the source, so get the latency of
-			 * the destination */
-			if (connection->destination->shared->flags
-			    & JackPortIsTerminal) {
-				this_latency = connection->destination->
-					       shared->latency;
-			} else {
-				this_latency =
-					jack_get_port_total_latency (
-						engine,
-						connection->destination,
-						hop_count + 1,
-						toward_port);
-			}
-		}
+	/* call tree must hold engine->client_lock. */
 
-		if (this_latency > max_latency) {
-			max_latency = this_latency;
+	for (node = port->connections; node; node = jack_slist_next (node)) {
+		connection = (jack_connection_internal_t*)node->data;
+		other = (connection->source == port ?
+			 connection->destination : connection->source);
+		if (other->shared->latency > max_latency) {
+			max_latency = other->shared->latency;
 		}
 	}
 
 #ifdef DEBUG_TOTAL_LATENCY_COMPUTATION
-	jack_info ("%s\treturn %lu + %lu = %lu", prefix, latency, max_latency, latency + max_latency);
+	jack_info ("port %s: %lu + %lu = %lu", port->shared->name,
+		   (unsigned long)port->shared->latency,
+		   (unsigned long)max_latency,
+		   (unsigned long)(port->shared->latency + max_latency));
 #endif
 
-	return latency + max_latency;
+	return port->shared->latency + max_latency;
 }
 
 static void
@@ -3467,8 +5222,7 @@ jack_compute_port_total_latency (jack_engine_t* engine, jack_port_shared_t* port
 	if (port->in_use) {
 		port->total_latency =
 			jack_get_port_total_latency (
-				engine, &engine->internal_ports[port->id],
-				0, !(port->flags & JackPortIsOutput));
+				engine, &engine->internal_ports[port->id]);
 	}
 }
 
@@ -3477,27 +5231,102 @@ jack_compute_all_port_total_latencies (jack_engine_t *engine)
 {
 	jack_port_shared_t *shared = engine->control->ports;
 	unsigned int i;
-	int toward_port;
 
 	for (i = 0; i < engine->control->port_max; i++) {
 		if (shared[i].in_use) {
+			shared[i].total_latency =
+				jack_get_port_total_latency (
+					engine, &engine->internal_ports[i]);
+		}
+	}
+}
 
-			if (shared[i].flags & JackPortIsOutput) {
-				toward_port = FALSE;
-			} else {
-				toward_port = TRUE;
+/* What a client would compute for the ports it recalculates in this
+ * pass (inputs for capture, outputs for playback) differs from what it
+ * computed last time. This is the same min/max that
+ * jack_port_recalculate_latency() does on the client side, over the
+ * values the other ends have right now. If none of them moved, the
+ * client would only write back what is already there.
+ */
+static int
+jack_latency_stale (jack_engine_t *engine, jack_client_internal_t *client,
+		    int playback)
+{
+	JSList *pnode, *cnode;
+	jack_port_internal_t *port, *other;
+	jack_connection_internal_t *connection;
+	jack_latency_range_t range, other_range, now;
+
+	if (client->latency_dirty) {
+		return TRUE;
+	}
+
+	for (pnode = client->ports; pnode; pnode = jack_slist_next (pnode)) {
+		port = (jack_port_internal_t*)pnode->data;
+
+		if (!port->shared->in_use ||
+		    !(port->shared->flags &
+		      (playback ? JackPortIsOutput : JackPortIsInput))) {
+			continue;
+		}
+
+		range.min = UINT32_MAX;
+		range.max = 0;
+
+		for (cnode = port->connections; cnode;
+		     cnode = jack_slist_next (cnode)) {
+			connection = (jack_connection_internal_t*)cnode->data;
+			other = (connection->source == port ?
+				 connection->destination : connection->source);
+			other_range = (playback ?
+				       other->shared->playback_latency :
+				       other->shared->capture_latency);
+			if (other_range.max > range.max) {
+				range.max = other_range.max;
 			}
+			if (other_range.min < range.min) {
+				range.min = other_range.min;
+			}
+		}
 
-			shared[i].total_latency =
-				jack_get_port_total_latency (
-					engine, &engine->internal_ports[i],
-					0, toward_port);
+		if (range.min == UINT32_MAX) {
+			range.min = 0;
+		}
+
+		now = (playback ? port->shared->playback_latency :
+		       port->shared->capture_latency);
+
+		if (now.min != range.min || now.max != range.max) {
+			return TRUE;
 		}
 	}
+
+	return FALSE;
+}
+
+static void
+jack_deliver_latency (jack_engine_t *engine, jack_client_internal_t *client,
+		      jack_event_t *event, int force)
+{
+	if (force || jack_latency_stale (engine, client, event->x.n)) {
+		jack_deliver_event (engine, client, event);
+		engine->latency_sent++;
+	} else {
+		engine->latency_skipped++;
+	}
 }
 
+/* Capture latencies flow downstream and playback latencies upstream,
+ * so the callbacks go out in graph order and then in reverse. Clients
+ * are asked in that order, and each one only when something it reads
+ * has changed since it last answered (or it has new or fewer ports),
+ * so a new connection costs callbacks for the clients it can affect
+ * instead of the whole graph. force asks everybody, for when latencies
+ * changed where the server cannot see it (a new buffer size, or a
+ * client that asked for a recompute after changing its own).
+ */
 static void
-jack_compute_new_latency (jack_engine_t *engine)
+jack_compute_new_latency (jack_engine_t *engine, int force)
 {
 	JSList *node;
 	JSList *reverse_list = NULL;
@@ -3516,11 +5345,12 @@ jack_compute_new_latency (jack_engine_t *engine)
 
 		jack_client_internal_t* client = (jack_client_internal_t*)node->data;
 		reverse_list = jack_slist_prepend (reverse_list, client);
-		jack_deliver_event (engine, client, &event);
+		jack_deliver_latency (engine, client, &event, force);
 	}
 
 	if (engine->driver) {
-		jack_deliver_event (engine, engine->driver->internal_client, &event);
+		jack_deliver_latency (engine, engine->driver->internal_client,
+				      &event, force);
 	}
 
 	/* now issue playback latency callbacks in reverse graphorder
@@ -3528,17 +5358,21 @@ jack_compute_new_latency (jack_engine_t *engine)
 	event.x.n  = 1;
 	for (node = reverse_list; node; node = jack_slist_next (node)) {
 		jack_client_internal_t* client = (jack_client_internal_t*)node->data;
-		jack_deliver_event (engine, client, &event);
+		jack_deliver_latency (engine, client, &event, force);
 	}
 
 	if (engine->driver) {
-		jack_deliver_event (engine, engine->driver->internal_client, &event);
+		jack_deliver_latency (engine, engine->driver->internal_client,
+				      &event, force);
+	}
+
+	for (node = reverse_list; node; node = jack_slist_next (node)) {
+		((jack_client_internal_t*)node->data)->latency_dirty = 0;
 	}
 
 	jack_slist_free (reverse_list);
 }
 
-
 /* How the sort works:
  *
  * Each client has a "sortfeeds" list of clients indicating which clients
@@ -3566,62 +5400,456 @@ jack_compute_new_latency (jack_engine_t *engine)
  *
  */
 
+/* Kahn's algorithm over the sortfeeds lists: every client starts with
+ * the number of sortfeeds edges leading into it, clients whose count
+ * reaches zero are ready and are emitted in the order they were found.
+ * Ready drivers are always taken before ready non-drivers, so drivers
+ * end up at the front as they did with the old comparison sort. This
+ * is O(clients + connections), where the comparison sort walked the
+ * transitive closure for every comparison.
+ */
+static int
+jack_sort_clients (jack_engine_t *engine)
+{
+	jack_client_internal_t **order;
+	jack_client_internal_t *client, *dst;
+	JSList *node, *fnode, *sorted = NULL;
+	size_t nclients, head, tail, i;
+	int pass;
+
+	nclients = jack_slist_length (engine->clients);
+
+	if (nclients == 0) {
+		return 0;
+	}
+
+	if ((order = (jack_client_internal_t**)
+		     malloc (sizeof(jack_client_internal_t*) * nclients))
+	    == NULL) {
+		return -1;
+	}
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		((jack_client_internal_t*)node->data)->tfedcount = 0;
+	}
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		for (fnode = client->sortfeeds; fnode;
+		     fnode = jack_slist_next (fnode)) {
+			((jack_client_internal_t*)fnode->data)->tfedcount++;
+		}
+	}
+
+	/* order[] is both the output and the work queue: order[head] is
+	   the next client to expand, order[tail] the next free slot.
+	   First run the sort over drivers only, so that drivers which are
+	   ready come out ahead of every other client, then seed the
+	   remaining ready clients and carry on over everything. */
+
+	head = tail = 0;
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		if (client->tfedcount == 0
+		    && client->control->type == ClientDriver) {
+			order[tail++] = client;
+		}
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+
+		if (pass == 1) {
+			for (node = engine->clients; node;
+			     node = jack_slist_next (node)) {
+				client = (jack_client_internal_t*)node->data;
+				if (client->tfedcount == 0
+				    && client->control->type != ClientDriver) {
+					order[tail++] = client;
+				}
+			}
+		}
+
+		while (head < tail) {
+
+			client = order[head++];
+
+			for (fnode = client->sortfeeds; fnode;
+			     fnode = jack_slist_next (fnode)) {
+
+				dst = (jack_client_internal_t*)fnode->data;
+
+				if (--dst->tfedcount == 0
+				    && (pass == 1
+					|| dst->control->type == ClientDriver)) {
+					order[tail++] = dst;
+				}
+			}
+		}
+	}
+
+	if (tail != nclients) {
+		/* the sortfeeds relation is supposed to be acyclic;
+		   keep whatever was left over in its old order */
+		jack_error ("client graph has a cycle in sortfeeds (%d of %d "
+			    "clients sorted)", (int)tail, (int)nclients);
+		for (node = engine->clients; node;
+		     node = jack_slist_next (node)) {
+			client = (jack_client_internal_t*)node->data;
+			if (client->tfedcount > 0) {
+				order[tail++] = client;
+			}
+		}
+	}
+
+	for (i = nclients; i > 0; i--) {
+		sorted = jack_slist_prepend (sorted, order[i - 1]);
+	}
+
+	jack_slist_free (engine->clients);
+	engine->clients = sorted;
+
+	free (order);
+
+	return 0;
+}
+
 void
 jack_sort_graph (jack_engine_t *engine)
 {
-	/* called, obviously, must hold engine->client_lock */
+	/* called, obviously, must hold engine->client_lock */
+
+	VERBOSE (engine, "++ jack_sort_graph");
+	if (jack_sort_clients (engine)) {
+		jack_error ("cannot allocate memory to sort the client graph");
+	}
+	jack_compute_all_port_total_latencies (engine);
+	jack_compute_new_latency (engine, FALSE);
+	jack_plan_shared_buffers (engine);
+	jack_rechain_graph (engine);
+	jack_publish_connections (engine);
+	engine->timeout_count = 0;
+	VERBOSE (engine, "-- jack_sort_graph");
+}
+
+/* --share-buffers: audio output ports whose signals are never alive at
+ * the same time in the serial chain can write to the same buffer. A
+ * signal is alive from the chain position of the client that writes
+ * it to that of the last client that reads it. The driver writes its
+ * capture ports before anyone else and reads its playback ports after
+ * everyone else. Anything that is read at or before the point where
+ * it is written (feedback, or a client reading its own outputs) has to
+ * survive into the next cycle and keeps a buffer to itself, as do the
+ * outputs of clients that are not in the chain and driver outputs that
+ * are not physical capture ports, such as the ALSA monitor outputs,
+ * which the driver writes at the end of the cycle.
+ */
+
+#define JACK_LIVE_NONE   (-2)
+#define JACK_LIVE_DRIVER (-1)
+
+typedef struct {
+	jack_port_id_t id;
+	int first;
+	int last;
+} jack_live_interval_t;
+
+static int
+jack_live_interval_cmp (const void *a, const void *b)
+{
+	const jack_live_interval_t *x = (const jack_live_interval_t*)a;
+	const jack_live_interval_t *y = (const jack_live_interval_t*)b;
+
+	if (x->first != y->first) {
+		return x->first < y->first ? -1 : 1;
+	}
+	return (x->id > y->id) - (x->id < y->id);
+}
+
+static int
+jack_live_buffer_cmp (const void *a, const void *b)
+{
+	const jack_port_buffer_info_t *x = *(jack_port_buffer_info_t* const*)a;
+	const jack_port_buffer_info_t *y = *(jack_port_buffer_info_t* const*)b;
+
+	return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+/* Work out which buffer every audio output port should use with the
+ * current client order and connections, leaving the result in
+ * engine->live_next. Must hold engine->client_lock.
+ */
+static void
+jack_plan_shared_buffers (jack_engine_t *engine)
+{
+	JSList *node, *pnode;
+	jack_client_internal_t *client;
+	jack_port_internal_t *port;
+	jack_connection_internal_t *connection;
+	jack_live_interval_t *intervals = NULL;
+	jack_port_buffer_info_t **buffers = NULL;
+	int *slot_of = NULL, *slot_end = NULL;
+	jack_port_buffer_info_t *now, *next;
+	jack_port_id_t i;
+	int nchained = 0, pos, rpos;
+	int nintervals = 0, nslots = 0, n, s;
+	int changed = 0;
+	size_t one_buffer;
+
+	if (!engine->share_buffers) {
+		return;
+	}
+
+	/* chain positions, in the order just sorted */
+
+	for (i = 0; i < engine->port_max; i++) {
+		engine->live_pos[i] = JACK_LIVE_NONE;
+		engine->live_next[i] = NULL;
+	}
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+
+		if (client->control->type == ClientDriver) {
+			pos = JACK_LIVE_DRIVER;
+		} else if (!client->retiring && client->control->active &&
+			   !client->control->dead &&
+			   (client->control->process_cbset ||
+			    client->control->thread_cb_cbset)) {
+			pos = nchained++;
+		} else {
+			pos = JACK_LIVE_NONE;
+		}
+
+		for (pnode = client->ports; pnode; pnode = jack_slist_next (pnode)) {
+			port = (jack_port_internal_t*)pnode->data;
+			if (!port->shared->in_use) {
+				continue;
+			}
+			if (pos == JACK_LIVE_DRIVER &&
+			    (port->shared->flags & JackPortIsOutput) &&
+			    !(port->shared->flags & JackPortIsPhysical)) {
+				engine->live_pos[port->shared->id] = JACK_LIVE_NONE;
+			} else {
+				engine->live_pos[port->shared->id] = pos;
+			}
+		}
+	}
+
+	intervals = (jack_live_interval_t*)
+		    malloc (sizeof(jack_live_interval_t) * engine->port_max);
+	buffers = (jack_port_buffer_info_t**)
+		  malloc (sizeof(jack_port_buffer_info_t*) * engine->port_max);
+	slot_of = (int*)malloc (sizeof(int) * engine->port_max);
+	slot_end = (int*)malloc (sizeof(int) * engine->port_max);
+
+	if (!intervals || !buffers || !slot_of || !slot_end) {
+		jack_error ("cannot allocate memory to share port buffers");
+		/* every port goes back to its own buffer */
+		nintervals = 0;
+		goto assign;
+	}
+
+	/* how long each signal lives */
+
+	for (i = 0; i < engine->port_max; i++) {
+		port = &engine->internal_ports[i];
+
+		if (!port->shared->in_use || port->buffer_info == NULL ||
+		    port->shared->ptype_id != JACK_AUDIO_PORT_TYPE ||
+		    !(port->shared->flags & JackPortIsOutput) ||
+		    engine->live_pos[i] == JACK_LIVE_NONE) {
+			continue;
+		}
+
+		pos = engine->live_pos[i];
+		intervals[nintervals].id = i;
+		intervals[nintervals].first = pos;
+		intervals[nintervals].last = pos;
+
+		for (pnode = port->connections; pnode;
+		     pnode = jack_slist_next (pnode)) {
+			connection = (jack_connection_internal_t*)pnode->data;
+			if (connection->source != port) {
+				continue;
+			}
+			rpos = engine->live_pos[connection->destination->shared->id];
+			if (rpos == JACK_LIVE_NONE) {
+				continue;
+			}
+			if (rpos == JACK_LIVE_DRIVER) {
+				rpos = nchained;
+			}
+			if (rpos <= pos) {
+				break;
+			}
+			if (rpos > intervals[nintervals].last) {
+				intervals[nintervals].last = rpos;
+			}
+		}
+
+		if (pnode == NULL) {
+			buffers[nintervals] = port->buffer_info;
+			nintervals++;
+		}
+	}
+
+	/* interval partitioning: each port takes the lowest numbered
+	   buffer whose previous signal is dead by the time it is written */
+
+	qsort (intervals, nintervals, sizeof(jack_live_interval_t),
+	       jack_live_interval_cmp);
+
+	for (n = 0; n < nintervals; n++) {
+		for (s = 0; s < nslots; s++) {
+			if (slot_end[s] < intervals[n].first) {
+				break;
+			}
+		}
+		if (s == nslots) {
+			nslots++;
+		}
+		slot_end[s] = intervals[n].last;
+		slot_of[n] = s;
+	}
+
+	/* buffers are taken from the ports that take part, lowest
+	   offsets first, so the ones in use sit close together */
+
+	qsort (buffers, nintervals, sizeof(jack_port_buffer_info_t*),
+	       jack_live_buffer_cmp);
+
+	for (n = 0; n < nintervals; n++) {
+		port = &engine->internal_ports[intervals[n].id];
+		if (buffers[slot_of[n]] != port->buffer_info) {
+			engine->live_next[intervals[n].id] = buffers[slot_of[n]];
+		}
+	}
+
+assign:
+	for (i = 0; i < engine->port_max; i++) {
+		port = &engine->internal_ports[i];
+		if (!port->shared->in_use || port->buffer_info == NULL) {
+			continue;
+		}
+		now = port->live_buffer ? port->live_buffer : port->buffer_info;
+		next = engine->live_next[i] ?
+		       engine->live_next[i] : port->buffer_info;
+		if (now != next) {
+			changed++;
+		}
+	}
+
+	if (nintervals) {
+		one_buffer = jack_port_type_buffer_size (
+			&engine->control->port_types[JACK_AUDIO_PORT_TYPE],
+			engine->control->buffer_size);
+		VERBOSE (engine, "%d audio output ports in %d buffers "
+			 "(%lu of %lu kB), %d reassigned",
+			 nintervals, nslots,
+			 (unsigned long)(nslots * one_buffer / 1024),
+			 (unsigned long)(nintervals * one_buffer / 1024),
+			 changed);
+	}
+
+	free (intervals);
+	free (buffers);
+	free (slot_of);
+	free (slot_end);
+
+	engine->live_changed = (changed != 0);
+}
+
+/* Switch ports over to the buffers chosen by
+ * jack_plan_shared_buffers(). Clients look the offset up every cycle,
+ * so this must happen between two cycles. Must hold engine->rt_lock.
+ */
+static void
+jack_apply_shared_buffers (jack_engine_t *engine)
+{
+	jack_port_internal_t *port;
+	jack_port_id_t i;
 
-	VERBOSE (engine, "++ jack_sort_graph");
-	engine->clients = jack_slist_sort (engine->clients,
-					   (JCompareFunc)jack_client_sort);
-	jack_compute_all_port_total_latencies (engine);
-	jack_compute_new_latency (engine);
-	jack_rechain_graph (engine);
-	engine->timeout_count = 0;
-	VERBOSE (engine, "-- jack_sort_graph");
+	for (i = 0; i < engine->port_max; i++) {
+		port = &engine->internal_ports[i];
+		if (!port->shared->in_use || port->buffer_info == NULL) {
+			continue;
+		}
+		port->live_buffer = engine->live_next[i];
+		port->shared->offset = (port->live_buffer ?
+					port->live_buffer : port->buffer_info)->offset;
+	}
+
+	engine->live_changed = 0;
 }
 
-static int
-jack_client_sort (jack_client_internal_t *a, jack_client_internal_t *b)
+/* Redo the assignment without touching the chain, e.g. when a port
+ * whose buffer was lent to others goes away.
+ */
+static void
+jack_share_port_buffers (jack_engine_t *engine)
 {
-	/* drivers are forced to the front, ie considered as sources
-	   rather than sinks for purposes of the sort */
+	jack_plan_shared_buffers (engine);
 
-	if (jack_client_feeds_transitive (a, b) ||
-	    (a->control->type == ClientDriver &&
-	     b->control->type != ClientDriver)) {
-		return -1;
-	} else if (jack_client_feeds_transitive (b, a) ||
-		   (b->control->type == ClientDriver &&
-		    a->control->type != ClientDriver)) {
-		return 1;
-	} else {
-		return 0;
+	if (engine->live_changed) {
+		jack_lock_rt (engine);
+		jack_apply_shared_buffers (engine);
+		jack_unlock_rt (engine);
 	}
 }
 
-/* transitive closure of the relation expressed by the sortfeeds lists. */
+/* transitive closure of the relation expressed by the sortfeeds lists.
+ *
+ * Iterative depth-first search; every client is visited at most once
+ * per query, so diamond shaped graphs no longer blow up the way the
+ * recursive version did.
+ */
 static int
 jack_client_feeds_transitive (jack_client_internal_t *source,
 			      jack_client_internal_t *dest )
 {
+	static unsigned long visit_stamp = 0;
 	jack_client_internal_t *med;
+	JSList *stack = NULL;
 	JSList *node;
+	int found = 0;
 
-	if (jack_slist_find (source->sortfeeds, dest)) {
-		return 1;
+	/* only ever called from the server thread with the
+	   client_lock held, so a plain counter is enough */
+	if (++visit_stamp == 0) {
+		visit_stamp = 1;
 	}
 
-	for (node = source->sortfeeds; node; node = jack_slist_next (node)) {
+	source->sort_visit = visit_stamp;
+	stack = jack_slist_prepend (stack, source);
+
+	while (stack && !found) {
 
+		node = stack;
 		med = (jack_client_internal_t*)node->data;
+		stack = jack_slist_remove_link (stack, node);
+		jack_slist_free_1 (node);
 
-		if (jack_client_feeds_transitive (med, dest)) {
-			return 1;
+		for (node = med->sortfeeds; node; node = jack_slist_next (node)) {
+
+			jack_client_internal_t *next =
+				(jack_client_internal_t*)node->data;
+
+			if (next == dest) {
+				found = 1;
+				break;
+			}
+
+			if (next->sort_visit != visit_stamp) {
+				next->sort_visit = visit_stamp;
+				stack = jack_slist_prepend (stack, next);
+			}
 		}
 	}
 
-	return 0;
+	jack_slist_free (stack);
+
+	return found;
 }
 
 /**
@@ -3794,14 +6022,19 @@ void jack_dump_configuration (jack_engine_t *engine, int take_lock)
 	jack_info ("engine.c: <-- dump ends -->");
 }
 
+/* Look up the two ports named in a connection request and check that
+ * they can be connected. Returns 0 and sets *srcp and *dstp if so,
+ * EEXIST if they are connected already and -1 if they cannot be.
+ * Must hold engine->client_lock.
+ */
 static int
-jack_port_do_connect (jack_engine_t *engine,
-		      const char *source_port,
-		      const char *destination_port)
+jack_port_check_connect (jack_engine_t *engine,
+			 const char *source_port,
+			 const char *destination_port,
+			 jack_port_internal_t **srcp,
+			 jack_port_internal_t **dstp)
 {
-	jack_connection_internal_t *connection;
 	jack_port_internal_t *srcport, *dstport;
-	jack_port_id_t src_id, dst_id;
 	jack_client_internal_t *srcclient, *dstclient;
 	JSList *it;
 
@@ -3873,227 +6106,285 @@ jack_port_do_connect (jack_engine_t *engine,
 		}
 	}
 
-	connection = (jack_connection_internal_t*)
-		     malloc (sizeof(jack_connection_internal_t));
-
-	connection->source = srcport;
-	connection->destination = dstport;
-	connection->srcclient = srcclient;
-	connection->dstclient = dstclient;
-
-	src_id = srcport->shared->id;
-	dst_id = dstport->shared->id;
-
-	jack_lock_graph (engine);
-
 	if (dstport->connections && !dstport->shared->has_mixdown) {
 		jack_port_type_info_t *port_type =
 			jack_port_type_info (engine, dstport);
 		jack_error ("cannot make multiple connections to a port of"
 			    " type [%s]", port_type->type_name);
-		free (connection);
-		jack_unlock_graph (engine);
 		return -1;
-	} else {
-
-		if (dstclient->control->type == ClientDriver) {
-			/* Ignore output connections to drivers for purposes
-			   of sorting. Drivers are executed first in the sort
-			   order anyway, and we don't want to treat graphs
-			   such as driver -> client -> driver as containing
-			   feedback */
-
-			VERBOSE (engine,
-				 "connect %s and %s (output)",
-				 srcport->shared->name,
-				 dstport->shared->name);
+	}
 
-			connection->dir = 1;
+	*srcp = srcport;
+	*dstp = dstport;
 
-		} else if (srcclient != dstclient) {
+	return 0;
+}
 
-			srcclient->truefeeds = jack_slist_prepend
-						       (srcclient->truefeeds, dstclient);
+/* Add a connection that jack_port_check_connect() has accepted.
+ * Nobody is told and the graph is not sorted; the caller does both.
+ * Must hold engine->client_lock.
+ */
+static int
+jack_port_link (jack_engine_t *engine, jack_port_internal_t *srcport,
+		jack_port_internal_t *dstport)
+{
+	jack_connection_internal_t *connection;
+	jack_client_internal_t *srcclient, *dstclient;
 
-			dstclient->fedcount++;
+	srcclient = jack_client_internal_by_id (engine,
+						srcport->shared->client_id);
+	dstclient = jack_client_internal_by_id (engine,
+						dstport->shared->client_id);
 
-			if (jack_client_feeds_transitive (dstclient,
-							  srcclient ) ||
-			    (dstclient->control->type == ClientDriver &&
-			     srcclient->control->type != ClientDriver)) {
+	if ((connection = (jack_connection_internal_t*)
+			  malloc (sizeof(jack_connection_internal_t))) == NULL) {
+		jack_error ("cannot allocate memory for a connection");
+		return -1;
+	}
 
-				/* dest is running before source so
-				   this is a feedback connection */
+	connection->source = srcport;
+	connection->destination = dstport;
+	connection->srcclient = srcclient;
+	connection->dstclient = dstclient;
 
-				VERBOSE (engine,
-					 "connect %s and %s (feedback)",
-					 srcport->shared->name,
-					 dstport->shared->name);
+	if (dstclient->control->type == ClientDriver) {
+		/* Ignore output connections to drivers for purposes
+		   of sorting. Drivers are executed first in the sort
+		   order anyway, and we don't want to treat graphs
+		   such as driver -> client -> driver as containing
+		   feedback */
 
-				dstclient->sortfeeds = jack_slist_prepend
-							       (dstclient->sortfeeds, srcclient);
+		VERBOSE (engine,
+			 "connect %s and %s (output)",
+			 srcport->shared->name,
+			 dstport->shared->name);
 
-				connection->dir = -1;
-				engine->feedbackcount++;
-				VERBOSE (engine,
-					 "feedback count up to %d",
-					 engine->feedbackcount);
+		connection->dir = 1;
 
-			} else {
+	} else if (srcclient != dstclient) {
 
-				/* this is not a feedback connection */
+		srcclient->truefeeds = jack_slist_prepend
+					       (srcclient->truefeeds, dstclient);
 
-				VERBOSE (engine,
-					 "connect %s and %s (forward)",
-					 srcport->shared->name,
-					 dstport->shared->name);
+		dstclient->fedcount++;
 
-				srcclient->sortfeeds = jack_slist_prepend
-							       (srcclient->sortfeeds, dstclient);
+		if (jack_client_feeds_transitive (dstclient,
+						  srcclient ) ||
+		    (dstclient->control->type == ClientDriver &&
+		     srcclient->control->type != ClientDriver)) {
 
-				connection->dir = 1;
-			}
-		} else {
-			/* this is a connection to self */
+			/* dest is running before source so
+			   this is a feedback connection */
 
 			VERBOSE (engine,
-				 "connect %s and %s (self)",
+				 "connect %s and %s (feedback)",
 				 srcport->shared->name,
 				 dstport->shared->name);
 
-			connection->dir = 0;
-		}
+			dstclient->sortfeeds = jack_slist_prepend
+						       (dstclient->sortfeeds, srcclient);
 
-		dstport->connections =
-			jack_slist_prepend (dstport->connections, connection);
-		srcport->connections =
-			jack_slist_prepend (srcport->connections, connection);
+			connection->dir = -1;
+			engine->feedbackcount++;
+			VERBOSE (engine,
+				 "feedback count up to %d",
+				 engine->feedbackcount);
 
-		DEBUG ("actually sorted the graph...");
+		} else {
 
-		jack_send_connection_notification (engine,
-						   srcport->shared->client_id,
-						   src_id, dst_id, TRUE);
+			/* this is not a feedback connection */
 
+			VERBOSE (engine,
+				 "connect %s and %s (forward)",
+				 srcport->shared->name,
+				 dstport->shared->name);
 
-		jack_send_connection_notification (engine,
-						   dstport->shared->client_id,
-						   dst_id, src_id, TRUE);
+			srcclient->sortfeeds = jack_slist_prepend
+						       (srcclient->sortfeeds, dstclient);
 
-		/* send a port connection notification just once to everyone who cares excluding clients involved in the connection */
+			connection->dir = 1;
+		}
+	} else {
+		/* this is a connection to self */
 
-		jack_notify_all_port_interested_clients (engine, srcport->shared->client_id, dstport->shared->client_id, src_id, dst_id, 1);
+		VERBOSE (engine,
+			 "connect %s and %s (self)",
+			 srcport->shared->name,
+			 dstport->shared->name);
 
-		jack_sort_graph (engine);
+		connection->dir = 0;
 	}
 
-	jack_unlock_graph (engine);
+	dstport->connections =
+		jack_slist_prepend (dstport->connections, connection);
+	srcport->connections =
+		jack_slist_prepend (srcport->connections, connection);
 
 	return 0;
 }
 
-int
-jack_port_disconnect_internal (jack_engine_t *engine,
-			       jack_port_internal_t *srcport,
-			       jack_port_internal_t *dstport )
-
+/* Remove the connection from srcport to dstport, if there is one,
+ * without telling anybody or sorting the graph. Returns -1 if the
+ * ports were not connected. Must hold engine->client_lock.
+ */
+static int
+jack_port_unlink (jack_engine_t *engine, jack_port_internal_t *srcport,
+		  jack_port_internal_t *dstport)
 {
 	JSList *node;
 	jack_connection_internal_t *connect;
-	int ret = -1;
-	jack_port_id_t src_id, dst_id;
-	int check_acyclic = engine->feedbackcount;
 
-	/* call tree **** MUST HOLD **** engine->client_lock. */
 	for (node = srcport->connections; node;
 	     node = jack_slist_next (node)) {
 
 		connect = (jack_connection_internal_t*)node->data;
 
-		if (connect->source == srcport &&
-		    connect->destination == dstport) {
+		if (connect->source != srcport ||
+		    connect->destination != dstport) {
+			continue;
+		}
 
-			VERBOSE (engine, "DIS-connect %s and %s",
-				 srcport->shared->name,
-				 dstport->shared->name);
+		VERBOSE (engine, "DIS-connect %s and %s",
+			 srcport->shared->name,
+			 dstport->shared->name);
+
+		srcport->connections =
+			jack_slist_remove (srcport->connections,
+					   connect);
+		dstport->connections =
+			jack_slist_remove (dstport->connections,
+					   connect);
+
+		if (connect->dir) {
+
+			jack_client_internal_t *src;
+			jack_client_internal_t *dst;
+
+			src = jack_client_internal_by_id
+				      (engine, srcport->shared->client_id);
+
+			dst =  jack_client_internal_by_id
+				      (engine, dstport->shared->client_id);
+
+			src->truefeeds = jack_slist_remove
+						 (src->truefeeds, dst);
+
+			dst->fedcount--;
+
+			if (connect->dir == 1) {
+				/* normal connection: remove dest from
+				   source's sortfeeds list */
+				src->sortfeeds = jack_slist_remove
+							 (src->sortfeeds, dst);
+			} else {
+				/* feedback connection: remove source
+				   from dest's sortfeeds list */
+				dst->sortfeeds = jack_slist_remove
+							 (dst->sortfeeds, src);
+				engine->feedbackcount--;
+				VERBOSE (engine,
+					 "feedback count down to %d",
+					 engine->feedbackcount);
 
-			srcport->connections =
-				jack_slist_remove (srcport->connections,
-						   connect);
-			dstport->connections =
-				jack_slist_remove (dstport->connections,
-						   connect);
-
-			src_id = srcport->shared->id;
-			dst_id = dstport->shared->id;
-
-			/* this is a bit harsh, but it basically says
-			   that if we actually do a disconnect, and
-			   its the last one, then make sure that any
-			   input monitoring is turned off on the
-			   srcport. this isn't ideal for all
-			   situations, but it works better for most of
-			   them.
-			 */
-			if (srcport->connections == NULL) {
-				srcport->shared->monitor_requests = 0;
 			}
+		} /* else self-connection: do nothing */
+
+		free (connect);
+		return 0;
+	}
+
+	return -1;
+}
+
+/* Tell the owners of both ports, and everyone who registered for
+ * connection callbacks, that srcport and dstport were connected or
+ * disconnected. Must hold engine->client_lock.
+ */
+static void
+jack_port_notify_connection (jack_engine_t *engine,
+			     jack_port_internal_t *srcport,
+			     jack_port_internal_t *dstport, int connected)
+{
+	jack_port_id_t src_id = srcport->shared->id;
+	jack_port_id_t dst_id = dstport->shared->id;
+
+	/* this is a bit harsh, but it basically says that if we
+	   actually do a disconnect, and its the last one, then make
+	   sure that any input monitoring is turned off on the
+	   srcport. this isn't ideal for all situations, but it works
+	   better for most of them.
+	 */
+	if (!connected && srcport->connections == NULL) {
+		srcport->shared->monitor_requests = 0;
+	}
 
-			jack_send_connection_notification (
-				engine, srcport->shared->client_id, src_id,
-				dst_id, FALSE);
-			jack_send_connection_notification (
-				engine, dstport->shared->client_id, dst_id,
-				src_id, FALSE);
+	jack_send_connection_notification (engine,
+					   srcport->shared->client_id,
+					   src_id, dst_id, connected);
 
-			/* send a port connection notification just once to everyone who cares excluding clients involved in the connection */
+	jack_send_connection_notification (engine,
+					   dstport->shared->client_id,
+					   dst_id, src_id, connected);
 
-			jack_notify_all_port_interested_clients (engine, srcport->shared->client_id, dstport->shared->client_id, src_id, dst_id, 0);
+	/* send a port connection notification just once to everyone who cares excluding clients involved in the connection */
 
-			if (connect->dir) {
+	jack_notify_all_port_interested_clients (engine, srcport->shared->client_id, dstport->shared->client_id, src_id, dst_id, connected);
+}
 
-				jack_client_internal_t *src;
-				jack_client_internal_t *dst;
+static int
+jack_port_do_connect (jack_engine_t *engine,
+		      const char *source_port,
+		      const char *destination_port)
+{
+	jack_port_internal_t *srcport, *dstport;
+	int ret;
 
-				src = jack_client_internal_by_id
-					      (engine, srcport->shared->client_id);
+	jack_lock_graph (engine);
 
-				dst =  jack_client_internal_by_id
-					      (engine, dstport->shared->client_id);
+	if ((ret = jack_port_check_connect (engine, source_port,
+					    destination_port,
+					    &srcport, &dstport)) == 0 &&
+	    (ret = jack_port_link (engine, srcport, dstport)) == 0) {
 
-				src->truefeeds = jack_slist_remove
-							 (src->truefeeds, dst);
+		/* with --share-buffers the source may still be writing
+		   into a buffer that another port's signal lives in
+		   when the destination runs; give it the buffer of the
+		   new layout before anyone starts reading it */
 
-				dst->fedcount--;
+		jack_sort_graph (engine);
 
-				if (connect->dir == 1) {
-					/* normal connection: remove dest from
-					   source's sortfeeds list */
-					src->sortfeeds = jack_slist_remove
-								 (src->sortfeeds, dst);
-				} else {
-					/* feedback connection: remove source
-					   from dest's sortfeeds list */
-					dst->sortfeeds = jack_slist_remove
-								 (dst->sortfeeds, src);
-					engine->feedbackcount--;
-					VERBOSE (engine,
-						 "feedback count down to %d",
-						 engine->feedbackcount);
+		DEBUG ("actually sorted the graph...");
 
-				}
-			} /* else self-connection: do nothing */
+		jack_port_notify_connection (engine, srcport, dstport, TRUE);
+	}
 
-			free (connect);
-			ret = 0;
-			break;
-		}
+	jack_unlock_graph (engine);
+
+	return ret;
+}
+
+int
+jack_port_disconnect_internal (jack_engine_t *engine,
+			       jack_port_internal_t *srcport,
+			       jack_port_internal_t *dstport )
+
+{
+	int ret;
+	int check_acyclic = engine->feedbackcount;
+
+	/* call tree **** MUST HOLD **** engine->client_lock. */
+
+	if ((ret = jack_port_unlink (engine, srcport, dstport)) == 0) {
+		jack_port_notify_connection (engine, srcport, dstport, FALSE);
 	}
 
 	if (check_acyclic) {
 		jack_check_acyclic (engine);
 	}
 
+	/* after the notifications: the destination has to stop
+	   reading the source's buffer before it is lent to others */
+
 	jack_sort_graph (engine);
 
 	return ret;
@@ -4120,6 +6411,142 @@ jack_port_do_disconnect_all (jack_engine_t *engine,
 	return 0;
 }
 
+/* Apply a batch of connects and disconnects in order, all or none.
+ * Each step is made in the engine's graph as it is checked; if one
+ * fails, those before it are undone in reverse order, which puts the
+ * graph back exactly as it was, and nobody hears of any of them.
+ * Otherwise the graph is sorted once, disconnections being announced
+ * before it and connections after, for the same reasons as in
+ * jack_port_disconnect_internal() and jack_port_do_connect(). Pairs
+ * that are already connected are left alone. Returns 0, or the
+ * number of steps that were not made.
+ */
+static int
+jack_port_do_connect_many (jack_engine_t *engine,
+			   jack_connection_op_t *ops, uint32_t nops)
+{
+	jack_port_internal_t **ports;
+	uint32_t n, done;
+	int check_acyclic;
+	int ret = 0;
+
+	/* source and destination of each step, or NULL for a step
+	   that changed nothing */
+	if ((ports = (jack_port_internal_t**)
+		     calloc (2 * nops, sizeof(jack_port_internal_t*))) == NULL) {
+		jack_error ("cannot allocate memory for a connection batch");
+		return nops;
+	}
+
+	jack_lock_graph (engine);
+
+	check_acyclic = engine->feedbackcount;
+
+	for (done = 0; done < nops; done++) {
+		jack_connection_op_t *op = &ops[done];
+
+		op->source_port[JACK_PORT_NAME_SIZE - 1] = '\0';
+		op->destination_port[JACK_PORT_NAME_SIZE - 1] = '\0';
+
+		if (op->connect) {
+			ret = jack_port_check_connect (engine, op->source_port,
+						       op->destination_port,
+						       &ports[2 * done],
+						       &ports[2 * done + 1]);
+			if (ret == EEXIST) {
+				ret = 0;
+				continue;
+			}
+			if (ret == 0) {
+				ret = jack_port_link (engine, ports[2 * done],
+						      ports[2 * done + 1]);
+			}
+		} else {
+			ports[2 * done] =
+				jack_get_port_by_name (engine, op->source_port);
+			ports[2 * done + 1] =
+				jack_get_port_by_name (engine,
+						       op->destination_port);
+			if (ports[2 * done] == NULL ||
+			    ports[2 * done + 1] == NULL) {
+				jack_error ("unknown port in attempted "
+					    "disconnection of %s and %s",
+					    op->source_port,
+					    op->destination_port);
+				ret = -1;
+			} else {
+				ret = jack_port_unlink (engine,
+							ports[2 * done],
+							ports[2 * done + 1]);
+			}
+		}
+
+		if (ret) {
+			ports[2 * done] = NULL;
+			break;
+		}
+	}
+
+	if (ret) {
+		VERBOSE (engine, "connection batch: step %" PRIu32 " of %"
+			 PRIu32 " failed, undoing the steps before it",
+			 done + 1, nops);
+
+		for (n = done; n-- > 0; ) {
+			if (ports[2 * n] == NULL) {
+				continue;
+			}
+			if (ops[n].connect) {
+				jack_port_unlink (engine, ports[2 * n],
+						  ports[2 * n + 1]);
+			} else if (jack_port_link (engine, ports[2 * n],
+						   ports[2 * n + 1])) {
+				/* only malloc can fail here */
+				jack_port_notify_connection (
+					engine, ports[2 * n],
+					ports[2 * n + 1], FALSE);
+				check_acyclic = 1;
+			}
+		}
+
+		if (check_acyclic) {
+			jack_check_acyclic (engine);
+		}
+		jack_sort_graph (engine);
+		jack_unlock_graph (engine);
+		free (ports);
+		return nops;
+	}
+
+	for (n = 0; n < nops; n++) {
+		if (ports[2 * n] && !ops[n].connect) {
+			jack_port_notify_connection (engine, ports[2 * n],
+						     ports[2 * n + 1], FALSE);
+		}
+	}
+
+	if (check_acyclic) {
+		jack_check_acyclic (engine);
+	}
+
+	jack_sort_graph (engine);
+
+	for (n = 0; n < nops; n++) {
+		if (ports[2 * n] && ops[n].connect) {
+			jack_port_notify_connection (engine, ports[2 * n],
+						     ports[2 * n + 1], TRUE);
+		}
+	}
+
+	jack_unlock_graph (engine);
+
+	VERBOSE (engine, "connection batch: %" PRIu32 " steps", nops);
+
+	free (ports);
+
+	return 0;
+}
+
 static int
 jack_port_do_disconnect (jack_engine_t *engine,
 			 const char *source_port,
@@ -4233,6 +6660,25 @@ jack_clear_fifos (jack_engine_t *engine)
 	}
 }
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+static void
+jack_clear_wakeups (jack_engine_t *engine)
+{
+	/* caller must hold client_lock */
+
+	unsigned int i;
+
+	/* the equivalent of draining the FIFOs: drop tokens left
+	   behind by aborted cycles. only the graph bit is cleared, so
+	   that pending event and sleeping waiter marks survive.
+	 */
+	for (i = 0; i < JACK_WAKEUP_SLOTS; i++) {
+		jack_wakeup_clear (&engine->control->wakeup[i],
+				   JACK_WAKEUP_GRAPH);
+	}
+}
+#endif
+
 int
 jack_use_driver (jack_engine_t *engine, jack_driver_t *driver)
 {
@@ -4313,9 +6759,12 @@ jack_port_release (jack_engine_t *engine, jack_port_internal_t *port)
 
 
 	pthread_mutex_lock (&engine->port_lock);
+	jack_port_index_remove (&engine->port_index, port->shared->id);
 	port->shared->in_use = 0;
 	port->shared->alias1[0] = '\0';
 	port->shared->alias2[0] = '\0';
+	__atomic_fetch_add (&engine->control->port_generation, 1,
+			    __ATOMIC_RELEASE);
 
 	if (port->buffer_info) {
 		jack_port_buffer_list_t *blist =
@@ -4325,31 +6774,21 @@ jack_port_release (jack_engine_t *engine, jack_port_internal_t *port)
 			jack_slist_prepend (blist->freelist,
 					    port->buffer_info);
 		port->buffer_info = NULL;
+		port->live_buffer = NULL;
 		pthread_mutex_unlock (&blist->lock);
 	}
 	pthread_mutex_unlock (&engine->port_lock);
+
+	/* other ports may have been borrowing that buffer */
+	if (engine->share_buffers) {
+		jack_share_port_buffers (engine);
+	}
 }
 
 jack_port_internal_t *
 jack_get_port_internal_by_name (jack_engine_t *engine, const char *name)
 {
-	jack_port_id_t id;
-
-	pthread_mutex_lock (&engine->port_lock);
-
-	for (id = 0; id < engine->port_max; id++) {
-		if (jack_port_name_equals (&engine->control->ports[id], name)) {
-			break;
-		}
-	}
-
-	pthread_mutex_unlock (&engine->port_lock);
-
-	if (id != engine->port_max) {
-		return &engine->internal_ports[id];
-	} else {
-		return NULL;
-	}
+	return jack_get_port_by_name (engine, name);
 }
 
 int
@@ -4453,6 +6892,7 @@ next:
 	shared->latency = 0;
 	shared->capture_latency.min = shared->capture_latency.max = 0;
 	shared->playback_latency.min = shared->playback_latency.max = 0;
+	shared->silent_cycle = 0;
 	shared->monitor_requests = 0;
 
 	port = &engine->internal_ports[port_id];
@@ -4460,6 +6900,7 @@ next:
 	port->shared = shared;
 	port->connections = 0;
 	port->buffer_info = NULL;
+	port->live_buffer = NULL;
 
 	if (jack_port_assign_buffer (engine, port)) {
 		jack_error ("cannot assign buffer for port");
@@ -4468,7 +6909,14 @@ next:
 		return -1;
 	}
 
+	pthread_mutex_lock (&engine->port_lock);
+	jack_port_index_update (&engine->port_index, shared);
+	__atomic_fetch_add (&engine->control->port_generation, 1,
+			    __ATOMIC_RELEASE);
+	pthread_mutex_unlock (&engine->port_lock);
+
 	client->ports = jack_slist_prepend (client->ports, port);
+	client->latency_dirty = 1;
 	if ( client->control->active ) {
 		jack_port_registration_notify (engine, port_id, TRUE);
 	}
@@ -4524,6 +6972,7 @@ jack_port_do_unregister (jack_engine_t *engine, jack_request_t *req)
 	jack_port_release (engine, &engine->internal_ports[req->x.port_info.port_id]);
 
 	client->ports = jack_slist_remove (client->ports, port);
+	client->latency_dirty = 1;
 	jack_port_registration_notify (engine, req->x.port_info.port_id,
 				       FALSE);
 	jack_unlock_graph (engine);
@@ -4647,7 +7096,7 @@ jack_port_registration_notify (jack_engine_t *engine,
 		}
 
 		if (client->control->port_register_cbset) {
-			if (jack_deliver_event (engine, client, &event)) {
+			if (jack_post_event (engine, client, &event)) {
 				jack_error ("cannot send port registration"
 					    " notification to %s (%s)",
 					    client->control->name,
@@ -4688,7 +7137,7 @@ jack_port_rename_notify (jack_engine_t *engine,
 		}
 
 		if (client->control->port_rename_cbset) {
-			if (jack_deliver_event (engine, client, &event)) {
+			if (jack_post_event (engine, client, &event)) {
 				jack_error ("cannot send port registration"
 					    " notification to %s (%s)",
 					    client->control->name,
@@ -4723,7 +7172,7 @@ jack_client_registration_notify (jack_engine_t *engine,
 		}
 
 		if (client->control->client_register_cbset) {
-			if (jack_deliver_event (engine, client, &event)) {
+			if (jack_post_event (engine, client, &event)) {
 				jack_error ("cannot send client registration"
 					    " notification to %s (%s)",
 					    client->control->name,
@@ -4807,20 +7256,43 @@ jack_port_assign_buffer (jack_engine_t *engine, jack_port_internal_t *port)
 static jack_port_internal_t *
 jack_get_port_by_name (jack_engine_t *engine, const char *name)
 {
+	jack_port_shared_t *shared;
 	jack_port_id_t id;
 
 	/* Note the potential race on "in_use". Other design
 	   elements prevent this from being a problem.
 	 */
 
-	for (id = 0; id < engine->port_max; id++) {
-		if (engine->control->ports[id].in_use &&
-		    jack_port_name_equals (&engine->control->ports[id], name)) {
-			return &engine->internal_ports[id];
+	pthread_mutex_lock (&engine->port_lock);
+
+	shared = jack_port_index_find (&engine->port_index,
+				       engine->control->ports, name);
+
+	if (shared == NULL) {
+
+		/* clients set aliases (and, with the deprecated
+		   jack_port_set_name(), names) directly in shared
+		   memory, so a miss does not prove the port is not
+		   there. look the slow way and refile what we find.
+		 */
+
+		for (id = 0; id < engine->port_max; id++) {
+			if (engine->control->ports[id].in_use &&
+			    jack_port_name_equals (&engine->control->ports[id], name)) {
+				shared = &engine->control->ports[id];
+				jack_port_index_update (&engine->port_index, shared);
+				break;
+			}
 		}
 	}
 
-	return NULL;
+	pthread_mutex_unlock (&engine->port_lock);
+
+	if (shared == NULL) {
+		return NULL;
+	}
+
+	return &engine->internal_ports[shared->id];
 }
 
 static int
@@ -4870,8 +7342,6 @@ jack_wake_server_thread (jack_engine_t* engine)
 void
 jack_engine_signal_problems (jack_engine_t* engine)
 {
-	jack_lock_problems (engine);
-	engine->problems++;
-	jack_unlock_problems (engine);
+	__atomic_fetch_add (&engine->problems, 1, __ATOMIC_RELEASE);
 	jack_wake_server_thread (engine);
 }
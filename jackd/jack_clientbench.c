@@ -0,0 +1,227 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    jack_clientbench -- time port lookups, connections and requests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+/* Two clients are opened, one with N outputs and one with N inputs.
+   Three things are timed against the running server: looking every
+   port up by name, connecting and disconnecting the N pairs one call
+   at a time and then with jack_connect_many() and
+   jack_disconnect_many(), and a round trip of a request that needs no
+   work in the server. Run once with JACK_SHM_REQUESTS set in the
+   environment and once without to compare the request socket with
+   the shared memory ring. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <jack/jack.h>
+#include <jack/session.h>
+
+#include "internal.h"
+
+static void
+usage (FILE *file)
+{
+	fprintf (file,
+		 "usage: jack_clientbench [ options ]\n"
+		 "  -s, --server NAME   connect to server NAME\n"
+		 "  -p, --ports N       ports per client (default 256)\n"
+		 "  -n, --requests N    request round trips (default 10000)\n"
+		 "  -h, --help          this message\n");
+}
+
+static jack_client_t *
+bench_open (const char *name, jack_options_t options, const char *server_name)
+{
+	jack_client_t *client;
+	jack_status_t status;
+
+	if ((client = jack_client_open (name, options, &status,
+					server_name)) == NULL) {
+		fprintf (stderr, "jack_clientbench: cannot connect to the "
+			 "JACK server\n");
+		return NULL;
+	}
+
+	if (jack_activate (client)) {
+		fprintf (stderr, "jack_clientbench: cannot activate %s\n",
+			 name);
+		jack_client_close (client);
+		return NULL;
+	}
+
+	return client;
+}
+
+static int
+bench_ports (jack_client_t *client, const char *prefix, unsigned long flags,
+	     int nports, const char **names)
+{
+	jack_port_t *port;
+	char name[32];
+	int i;
+
+	for (i = 0; i < nports; i++) {
+		snprintf (name, sizeof(name), "%s%d", prefix, i);
+		if ((port = jack_port_register (client, name,
+						JACK_DEFAULT_AUDIO_TYPE,
+						flags, 0)) == NULL) {
+			fprintf (stderr, "jack_clientbench: cannot register "
+				 "port %s\n", name);
+			return -1;
+		}
+		names[i] = jack_port_name (port);
+	}
+
+	return 0;
+}
+
+static double
+usecs_since (jack_time_t start)
+{
+	return (double)(jack_get_time () - start);
+}
+
+int
+main (int argc, char *argv[])
+{
+	jack_client_t *a, *b;
+	jack_options_t options = JackNoStartServer;
+	const char **outs, **ins;
+	char *server_name = NULL, *uuid;
+	int nports = 256, nrequests = 10000;
+	jack_time_t start;
+	double connect_one, connect_many;
+	int opt, i, failed = 0;
+
+	const char *short_options = "s:p:n:h";
+	struct option long_options[] = {
+		{ "server", 1, 0, 's' },
+		{ "ports", 1, 0, 'p' },
+		{ "requests", 1, 0, 'n' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((opt = getopt_long (argc, argv, short_options, long_options,
+				   NULL)) != -1) {
+		switch (opt) {
+		case 's':
+			server_name = optarg;
+			options |= JackServerName;
+			break;
+		case 'p':
+			nports = atoi (optarg);
+			break;
+		case 'n':
+			nrequests = atoi (optarg);
+			break;
+		case 'h':
+			usage (stdout);
+			return 0;
+		default:
+			usage (stderr);
+			return 1;
+		}
+	}
+
+	if (nports < 1 || nrequests < 1) {
+		usage (stderr);
+		return 1;
+	}
+
+	outs = (const char**)calloc (nports, sizeof(char*));
+	ins = (const char**)calloc (nports, sizeof(char*));
+
+	if (outs == NULL || ins == NULL
+	    || (a = bench_open ("clientbench_a", options, server_name)) == NULL
+	    || (b = bench_open ("clientbench_b", options, server_name)) == NULL
+	    || bench_ports (a, "out", JackPortIsOutput, nports, outs)
+	    || bench_ports (b, "in", JackPortIsInput, nports, ins)) {
+		return 1;
+	}
+
+	/* every port of the other client, by its full name */
+
+	start = jack_get_time ();
+	for (i = 0; i < nports; i++) {
+		if (jack_port_by_name (a, ins[i]) == NULL) {
+			fprintf (stderr, "jack_clientbench: cannot find %s\n",
+				 ins[i]);
+			failed = 1;
+			break;
+		}
+	}
+	printf ("port lookup by name: %.2f usecs per port (%d ports)\n",
+		usecs_since (start) / nports, nports);
+
+	/* one pair per call, then all pairs in one call */
+
+	start = jack_get_time ();
+	for (i = 0; i < nports && !failed; i++) {
+		failed = jack_connect (a, outs[i], ins[i]) != 0;
+	}
+	for (i = 0; i < nports && !failed; i++) {
+		failed = jack_disconnect (a, outs[i], ins[i]) != 0;
+	}
+	connect_one = usecs_since (start);
+
+	start = jack_get_time ();
+	if (!failed) {
+		failed = jack_connect_many (a, outs, ins, nports) != 0
+			 || jack_disconnect_many (a, outs, ins, nports) != 0;
+	}
+	connect_many = usecs_since (start);
+
+	if (failed) {
+		fprintf (stderr, "jack_clientbench: cannot connect the "
+			 "ports\n");
+	} else {
+		printf ("connect and disconnect %d pairs: %.0f usecs one "
+			"by one, %.0f usecs batched\n", nports, connect_one,
+			connect_many);
+	}
+
+	/* a request the server answers from its client table */
+
+	start = jack_get_time ();
+	for (i = 0; i < nrequests; i++) {
+		if ((uuid = jack_get_uuid_for_client_name
+			    (a, jack_get_client_name (b))) == NULL) {
+			fprintf (stderr, "jack_clientbench: request failed\n");
+			break;
+		}
+		jack_free (uuid);
+	}
+	printf ("request round trip (%s): %.2f usecs\n",
+		getenv ("JACK_SHM_REQUESTS") ? "shared memory ring" : "socket",
+		usecs_since (start) / (i ? i : 1));
+
+	jack_client_close (b);
+	jack_client_close (a);
+	free (outs);
+	free (ins);
+
+	return failed;
+}
@@ -0,0 +1,244 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    jack_eventjitter -- how late process() starts while events arrive
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+/* A measured client records, every cycle, how long after the start of
+   the cycle its process() callback was entered. Meanwhile a second
+   client registers, connects and removes ports as fast as it can, so
+   that the measured client keeps receiving port registration,
+   connection and graph order events. With -e the measured client is
+   opened with JACK_EVENT_THREAD set and handles those events on a
+   thread of its own; running with and without -e against the same
+   server compares the two. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <jack/jack.h>
+
+#define JITTER_BUCKETS 10000    /* one per usec; the last takes the rest */
+
+static uint32_t histogram[JITTER_BUCKETS];
+static uint64_t total_usecs;
+static uint32_t max_usecs;
+static uint32_t cycles;
+static volatile uint32_t events;
+static volatile int measuring;
+
+static void
+usage (FILE *file)
+{
+	fprintf (file,
+		 "usage: jack_eventjitter [ options ]\n"
+		 "  -s, --server NAME   connect to server NAME\n"
+		 "  -d, --duration S    seconds to measure (default 10)\n"
+		 "  -e, --event-thread  handle events off the process thread\n"
+		 "  -h, --help          this message\n");
+}
+
+static int
+process (jack_nframes_t nframes, void *arg)
+{
+	jack_client_t *client = (jack_client_t*)arg;
+	jack_nframes_t current_frames;
+	jack_time_t current_usecs, next_usecs, now;
+	float period_usecs;
+	uint32_t late;
+
+	now = jack_get_time ();
+
+	if (!measuring ||
+	    jack_get_cycle_times (client, &current_frames, &current_usecs,
+				  &next_usecs, &period_usecs)) {
+		return 0;
+	}
+
+	late = now > current_usecs ? (uint32_t)(now - current_usecs) : 0;
+	histogram[late < JITTER_BUCKETS ? late : JITTER_BUCKETS - 1]++;
+	total_usecs += late;
+	if (late > max_usecs) {
+		max_usecs = late;
+	}
+	cycles++;
+
+	return 0;
+}
+
+static void
+port_registered (jack_port_id_t port, int yn, void *arg)
+{
+	events++;
+}
+
+static void
+port_connected (jack_port_id_t a, jack_port_id_t b, int yn, void *arg)
+{
+	events++;
+}
+
+static int
+graph_order (void *arg)
+{
+	events++;
+	return 0;
+}
+
+static uint32_t
+percentile (double p)
+{
+	uint64_t want = (uint64_t)(cycles * p), seen = 0;
+	uint32_t b;
+
+	for (b = 0; b < JITTER_BUCKETS; b++) {
+		seen += histogram[b];
+		if (seen > want) {
+			break;
+		}
+	}
+
+	return b;
+}
+
+int
+main (int argc, char *argv[])
+{
+	jack_client_t *client, *load;
+	jack_port_t *in, *out;
+	jack_options_t options = JackNoStartServer;
+	jack_status_t status;
+	char *server_name = NULL;
+	int duration = 10, event_thread = 0, changes = 0;
+	jack_time_t until;
+	int opt;
+
+	const char *short_options = "s:d:eh";
+	struct option long_options[] = {
+		{ "server", 1, 0, 's' },
+		{ "duration", 1, 0, 'd' },
+		{ "event-thread", 0, 0, 'e' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((opt = getopt_long (argc, argv, short_options, long_options,
+				   NULL)) != -1) {
+		switch (opt) {
+		case 's':
+			server_name = optarg;
+			options |= JackServerName;
+			break;
+		case 'd':
+			duration = atoi (optarg);
+			break;
+		case 'e':
+			event_thread = 1;
+			break;
+		case 'h':
+			usage (stdout);
+			return 0;
+		default:
+			usage (stderr);
+			return 1;
+		}
+	}
+
+	/* only the measured client gets the event thread */
+	if (event_thread) {
+		setenv ("JACK_EVENT_THREAD", "1", 1);
+	} else {
+		unsetenv ("JACK_EVENT_THREAD");
+	}
+
+	if ((client = jack_client_open ("eventjitter", options, &status,
+					server_name)) == NULL) {
+		fprintf (stderr, "jack_eventjitter: cannot connect to the "
+			 "JACK server\n");
+		return 1;
+	}
+
+	unsetenv ("JACK_EVENT_THREAD");
+
+	if ((load = jack_client_open ("eventjitter_load", options, &status,
+				      server_name)) == NULL) {
+		fprintf (stderr, "jack_eventjitter: cannot open the load "
+			 "client\n");
+		return 1;
+	}
+
+	in = jack_port_register (client, "in", JACK_DEFAULT_AUDIO_TYPE,
+				 JackPortIsInput, 0);
+
+	if (in == NULL ||
+	    jack_set_process_callback (client, process, client) ||
+	    jack_set_port_registration_callback (client, port_registered,
+						 NULL) ||
+	    jack_set_port_connect_callback (client, port_connected, NULL) ||
+	    jack_set_graph_order_callback (client, graph_order, NULL) ||
+	    jack_activate (client) || jack_activate (load)) {
+		fprintf (stderr, "jack_eventjitter: cannot set up clients\n");
+		return 1;
+	}
+
+	/* let the activations settle before counting */
+	sleep (1);
+	events = 0;
+	measuring = 1;
+
+	until = jack_get_time () + (jack_time_t)duration * 1000000;
+
+	while (jack_get_time () < until) {
+		if ((out = jack_port_register (load, "out",
+					       JACK_DEFAULT_AUDIO_TYPE,
+					       JackPortIsOutput, 0)) == NULL) {
+			fprintf (stderr, "jack_eventjitter: cannot register "
+				 "a load port\n");
+			break;
+		}
+		if (jack_connect (load, jack_port_name (out),
+				  jack_port_name (in))) {
+			fprintf (stderr, "jack_eventjitter: cannot connect "
+				 "a load port\n");
+			break;
+		}
+		jack_port_unregister (load, out);
+		changes++;
+	}
+
+	jack_deactivate (client);
+
+	printf ("%s: %d port changes, %u events, %u cycles\n",
+		event_thread ? "event thread" : "process thread",
+		changes, events, cycles);
+	if (cycles) {
+		printf ("process() entered after cycle start: mean %.1f, "
+			"p99 %u, p99.9 %u, max %u usecs\n",
+			(double)total_usecs / cycles, percentile (0.99),
+			percentile (0.999), max_usecs);
+	}
+
+	jack_client_close (load);
+	jack_client_close (client);
+
+	return 0;
+}
@@ -0,0 +1,963 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    jack_graphbench -- time the engine's graph work on synthetic graphs
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+/* engine.c is built into this program directly, so what is timed is
+   the server's own code, run on graphs made up here instead of ones
+   built by real clients. After the driver, every client feeds a few
+   clients further down a random order, so the graph is acyclic and
+   has many paths through it, like a large session.
+
+   jack_sort_clients(), which jack_sort_graph() starts with, is timed
+   against the comparison sort it replaced, on the same graphs and
+   the same shuffled client lists.
+
+   Then jack_engine_process() runs the cycle from the plan that
+   jack_publish_plan() makes for a sorted graph, against the walk of
+   the client list it replaced. Every client is an internal one whose
+   process() returns at once, so all that is timed is the engine's own
+   work per client. The clients are allocated far apart, as they are
+   in a server that has been running for a while, and each cycle is
+   timed with the caches warm from the one before and with them
+   flushed, as they are after the clients' real work.
+
+   Last, every client is given two audio inputs and two audio outputs,
+   connected along the edges of the graph, and the buffers are shared
+   out the way jackd --share-buffers does it. The cycle's memory
+   traffic is then timed over one segment, once with every output in
+   a buffer of its own and once with the shared ones, with the caches
+   warm and flushed. Where the kernel lets it, the cache misses of
+   each are counted as well. No server is needed. */
+
+#include "engine.c"
+
+#include <getopt.h>
+#include <time.h>
+#ifdef __linux
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define BENCH_RUNS 5                    /* best of */
+#define BENCH_CYCLES 2000               /* per run, a tenth of it flushed */
+#define BENCH_FLUSH (32 * 1024 * 1024)  /* more than the caches hold */
+#define BENCH_PORTS 2                   /* per client and direction */
+
+typedef struct {
+	int nclients;
+	int nedges;
+	jack_client_internal_t **clients;
+	JSList *filler;                 /* keeps the clients apart */
+	int nconnections;
+	jack_port_shared_t *shared;     /* the ports, once they are built */
+	jack_port_buffer_info_t *info;
+	char *segment;
+	jack_engine_t engine;
+} bench_graph_t;
+
+static const int client_counts[] = { 32, 128, 256, 512, 2048 };
+
+#define NCASES(a) (sizeof(a) / sizeof(a[0]))
+
+static void
+usage (FILE *file)
+{
+	fprintf (file,
+		 "usage: jack_graphbench [ options ]\n"
+		 "  -f, --fanout N      clients each client feeds (default 4)\n"
+		 "  -r, --reach N       ... all within N places downstream (default any)\n"
+		 "  -m, --max-old N     largest graph for the old sort (default 256)\n"
+		 "  -c, --clients N     clients in the timed cycle (default 256)\n"
+		 "  -p, --period N      frames per cycle for the buffers (default 256)\n"
+		 "  -h, --help          this message\n");
+}
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* what jack_sort_graph() did before */
+
+static int
+old_feeds_transitive (jack_client_internal_t *source,
+		      jack_client_internal_t *dest)
+{
+	jack_client_internal_t *med;
+	JSList *node;
+
+	if (jack_slist_find (source->sortfeeds, dest)) {
+		return 1;
+	}
+
+	for (node = source->sortfeeds; node; node = jack_slist_next (node)) {
+
+		med = (jack_client_internal_t*)node->data;
+
+		if (old_feeds_transitive (med, dest)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+old_client_sort (jack_client_internal_t *a, jack_client_internal_t *b)
+{
+	if (old_feeds_transitive (a, b) ||
+	    (a->control->type == ClientDriver &&
+	     b->control->type != ClientDriver)) {
+		return -1;
+	} else if (old_feeds_transitive (b, a) ||
+		   (b->control->type == ClientDriver &&
+		    a->control->type != ClientDriver)) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static int
+old_sort_clients (jack_engine_t *engine)
+{
+	engine->clients = jack_slist_sort (engine->clients,
+					   (JCompareFunc)old_client_sort);
+	return 0;
+}
+
+/* what jack_engine_process() did before, for internal clients, with
+   the timestamps the trace has added since, so that only the walk
+   differs */
+
+static JSList *
+old_process_internal (jack_engine_t *engine, JSList *node,
+		      jack_nframes_t nframes)
+{
+	jack_client_internal_t *client;
+	jack_client_control_t *ctl;
+
+	client = (jack_client_internal_t*)node->data;
+	ctl = client->control;
+
+	ctl->state = Running;
+	ctl->signalled_at = ctl->awake_at = jack_get_microseconds ();
+	engine->current_client = client;
+
+	if (ctl->sync_cb_cbset) {
+		jack_call_sync_client (client->private_client);
+	}
+
+	if (ctl->process_cbset) {
+		if (client->private_client->process (nframes, client->private_client->process_arg)) {
+			jack_error ("internal client %s failed", ctl->name);
+			engine->process_errors++;
+		}
+	}
+
+	if (ctl->timebase_cb_cbset) {
+		jack_call_timebase_master (client->private_client);
+	}
+
+	ctl->finished_at = jack_get_microseconds ();
+	ctl->state = Finished;
+
+	if (engine->process_errors) {
+		return NULL;            /* will stop the loop */
+	} else {
+		return jack_slist_next (node);
+	}
+}
+
+static int
+old_engine_process (jack_engine_t *engine, jack_nframes_t nframes)
+{
+	jack_client_internal_t *client;
+	JSList *node;
+
+	engine->process_errors = 0;
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		jack_client_control_t *ctl =
+			((jack_client_internal_t*)node->data)->control;
+		ctl->state = NotTriggered;
+		ctl->timed_out = 0;
+		ctl->awake_at = 0;
+		ctl->finished_at = 0;
+	}
+
+	for (node = engine->clients; engine->process_errors == 0 && node; ) {
+
+		client = (jack_client_internal_t*)node->data;
+
+		if (!client->control->active ||
+		    (!client->control->process_cbset && !client->control->thread_cb_cbset) ||
+		    client->control->dead) {
+			node = jack_slist_next (node);
+		} else {
+			node = old_process_internal (engine, node, nframes);
+		}
+	}
+
+	return engine->process_errors > 0;
+}
+
+static int
+bench_process (jack_nframes_t nframes, void *arg)
+{
+	return 0;
+}
+
+static void *
+bench_alloc (bench_graph_t *g, size_t size)
+{
+	void *ptr;
+
+	/* something else allocated in between, as in a server that
+	   has been up for a while */
+	g->filler = jack_slist_prepend (g->filler,
+					malloc (256 + rand () % 16384));
+
+	if ((ptr = calloc (1, size)) == NULL) {
+		fprintf (stderr, "jack_graphbench: out of memory\n");
+		exit (1);
+	}
+
+	return ptr;
+}
+
+static void
+bench_build (bench_graph_t *g, int nclients, int fanout, int reach)
+{
+	jack_client_internal_t *client;
+	int i, j, k, range;
+
+	memset (&g->engine, 0, sizeof(g->engine));
+	g->nclients = nclients;
+	g->nedges = 0;
+	g->nconnections = 0;
+	g->filler = NULL;
+	g->clients = (jack_client_internal_t**)
+		     bench_alloc (g, nclients * sizeof(jack_client_internal_t*));
+	g->engine.control = (jack_control_t*)
+			    bench_alloc (g, sizeof(jack_control_t));
+
+	for (i = 0; i < nclients; i++) {
+		client = (jack_client_internal_t*)
+			 bench_alloc (g, sizeof(jack_client_internal_t));
+		client->control = (jack_client_control_t*)
+				  bench_alloc (g, sizeof(jack_client_control_t));
+		client->private_client = (jack_client_t*)
+					 bench_alloc (g, sizeof(jack_client_t));
+		client->control->type = (i == 0 ? ClientDriver : ClientInternal);
+		client->control->active = 1;
+		client->control->process_cbset = 1;
+		client->private_client->process = bench_process;
+		g->clients[i] = client;
+	}
+
+	/* only ever downstream, so there is no feedback */
+	for (i = 0; i < nclients - 1; i++) {
+		range = nclients - i - 1;
+		if (reach > 0 && range > reach) {
+			range = reach;
+		}
+		for (k = 0; k < fanout; k++) {
+			j = i + 1 + rand () % range;
+			if (!jack_slist_find (g->clients[i]->sortfeeds,
+					      g->clients[j])) {
+				g->clients[i]->sortfeeds =
+					jack_slist_prepend (g->clients[i]->sortfeeds,
+							    g->clients[j]);
+				g->nedges++;
+			}
+		}
+	}
+}
+
+static void
+bench_free (bench_graph_t *g)
+{
+	JSList *node;
+	jack_plan_t *plan;
+	int i;
+
+	for (i = 0; i < g->nclients; i++) {
+		jack_slist_free (g->clients[i]->sortfeeds);
+		free (g->clients[i]->private_client);
+		free (g->clients[i]->control);
+		free (g->clients[i]);
+	}
+	for (node = g->filler; node; node = jack_slist_next (node)) {
+		free (node->data);
+	}
+	while ((plan = g->engine.plans_retired) != NULL) {
+		g->engine.plans_retired = plan->retired_next;
+		free (plan);
+	}
+	free (g->engine.plan);
+	jack_slist_free (g->filler);
+	jack_slist_free (g->engine.clients);
+	free (g->engine.control);
+	free (g->clients);
+}
+
+/* put the client list in a random order, the same one for every
+   sort timed with the same seed */
+static void
+bench_shuffle (bench_graph_t *g, unsigned int seed)
+{
+	jack_client_internal_t *tmp;
+	int i, j;
+
+	srand (seed);
+
+	for (i = g->nclients - 1; i > 0; i--) {
+		j = rand () % (i + 1);
+		tmp = g->clients[i];
+		g->clients[i] = g->clients[j];
+		g->clients[j] = tmp;
+	}
+
+	jack_slist_free (g->engine.clients);
+	g->engine.clients = NULL;
+
+	for (i = g->nclients; i > 0; i--) {
+		g->engine.clients = jack_slist_prepend (g->engine.clients,
+							g->clients[i - 1]);
+	}
+}
+
+/* every client has to come after the ones that feed it, and the
+   driver first */
+static int
+bench_check_order (bench_graph_t *g)
+{
+	jack_client_internal_t *client;
+	JSList *node, *fnode;
+	int pos = 0;
+
+	for (node = g->engine.clients; node; node = jack_slist_next (node)) {
+		((jack_client_internal_t*)node->data)->plan_index = pos++;
+	}
+
+	for (node = g->engine.clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+		if (client->control->type == ClientDriver
+		    && client->plan_index != 0) {
+			return -1;
+		}
+		for (fnode = client->sortfeeds; fnode;
+		     fnode = jack_slist_next (fnode)) {
+			if (((jack_client_internal_t*)fnode->data)->plan_index
+			    <= client->plan_index) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* usecs per sort, best of a few runs */
+static double
+bench_sort (bench_graph_t *g, int (*sort)(jack_engine_t *), int *bad)
+{
+	double start, elapsed, best = 0.0;
+	int r, i, sorts;
+
+	/* about a second's worth of the new sort at most */
+	sorts = 200000 / g->nclients;
+	if (sort == old_sort_clients) {
+		sorts = 1;
+	}
+
+	for (r = 0; r < BENCH_RUNS; r++) {
+		elapsed = 0.0;
+		for (i = 0; i < sorts; i++) {
+			bench_shuffle (g, r * sorts + i + 1);
+			start = now ();
+			sort (&g->engine);
+			elapsed += now () - start;
+			if (bench_check_order (g)) {
+				*bad = 1;
+			}
+		}
+		if (best == 0.0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	return best / sorts;
+}
+
+static void
+bench_flush (char *flush)
+{
+	size_t i;
+
+	for (i = 0; i < BENCH_FLUSH; i += 64) {
+		flush[i]++;
+	}
+}
+
+static int
+new_engine_process (jack_engine_t *engine, jack_nframes_t nframes)
+{
+	return jack_engine_process (engine, engine->plan, nframes);
+}
+
+/* usecs per cycle, best of a few runs */
+static double
+bench_cycle (bench_graph_t *g, int (*process)(jack_engine_t *, jack_nframes_t),
+	     char *flush)
+{
+	double start, elapsed, best = 0.0;
+	int r, i, cycles = (flush ? BENCH_CYCLES / 10 : BENCH_CYCLES);
+
+	for (r = 0; r < BENCH_RUNS; r++) {
+		elapsed = 0.0;
+		for (i = 0; i < cycles; i++) {
+			if (flush) {
+				bench_flush (flush);
+			}
+			start = now ();
+			process (&g->engine, 64);
+			elapsed += now () - start;
+		}
+		if (best == 0.0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	return best / cycles;
+}
+
+/* two audio ports each way for every client, the outputs of each
+   connected to the inputs of every client it feeds; the driver's
+   outputs are its capture ports and its inputs its playback ports,
+   which the clients that feed nobody are connected to */
+static void
+bench_build_ports (bench_graph_t *g, jack_nframes_t nframes)
+{
+	jack_engine_t *engine = &g->engine;
+	jack_client_internal_t *client, *dest, *driver = NULL;
+	jack_port_internal_t *port, *src, *dst;
+	jack_connection_internal_t *connection;
+	jack_port_id_t id = 0;
+	JSList *sinks, *node, *pnode;
+	size_t one_buffer;
+	int i, k;
+
+	engine->port_max = g->nclients * BENCH_PORTS * 2;
+	engine->share_buffers = 1;
+	engine->control->buffer_size = nframes;
+	engine->control->port_types[JACK_AUDIO_PORT_TYPE].buffer_scale_factor = 1;
+	one_buffer = jack_port_type_buffer_size (
+		&engine->control->port_types[JACK_AUDIO_PORT_TYPE], nframes);
+
+	engine->internal_ports = (jack_port_internal_t*)
+				 bench_alloc (g, sizeof(jack_port_internal_t) * engine->port_max);
+	g->shared = (jack_port_shared_t*)
+		    bench_alloc (g, sizeof(jack_port_shared_t) * engine->port_max);
+	g->info = (jack_port_buffer_info_t*)
+		  bench_alloc (g, sizeof(jack_port_buffer_info_t) * engine->port_max);
+	engine->live_pos = (int*)
+			   bench_alloc (g, sizeof(int) * engine->port_max);
+	engine->live_next = (jack_port_buffer_info_t**)
+			    bench_alloc (g, sizeof(jack_port_buffer_info_t*) * engine->port_max);
+
+	/* inputs are prepended last, so they come first in the list */
+	for (i = 0; i < g->nclients; i++) {
+		if (g->clients[i]->control->type == ClientDriver) {
+			driver = g->clients[i];
+		}
+		for (k = 0; k < BENCH_PORTS * 2; k++, id++) {
+			port = &engine->internal_ports[id];
+			port->shared = &g->shared[id];
+			port->shared->id = id;
+			port->shared->in_use = 1;
+			port->shared->ptype_id = JACK_AUDIO_PORT_TYPE;
+			if (k < BENCH_PORTS) {
+				port->shared->flags = JackPortIsOutput;
+				g->info[id].offset = id * one_buffer;
+				port->buffer_info = &g->info[id];
+				port->shared->offset = g->info[id].offset;
+			} else {
+				port->shared->flags = JackPortIsInput;
+			}
+			g->clients[i]->ports =
+				jack_slist_prepend (g->clients[i]->ports, port);
+		}
+	}
+
+	sinks = jack_slist_prepend (NULL, driver);
+
+	for (i = 0; i < g->nclients; i++) {
+		client = g->clients[i];
+		node = client->sortfeeds;
+		if (node == NULL && client != driver) {
+			node = sinks;
+		}
+		for (; node; node = jack_slist_next (node)) {
+			dest = (jack_client_internal_t*)node->data;
+			pnode = dest->ports;
+			for (k = 0; k < BENCH_PORTS; k++) {
+				src = &engine->internal_ports[
+					i * BENCH_PORTS * 2 + k];
+				dst = (jack_port_internal_t*)pnode->data;
+				pnode = jack_slist_next (pnode);
+				connection = (jack_connection_internal_t*)
+					     bench_alloc (g, sizeof(jack_connection_internal_t));
+				connection->source = src;
+				connection->destination = dst;
+				connection->srcclient = client;
+				connection->dstclient = dest;
+				connection->dir = 1;
+				src->connections =
+					jack_slist_prepend (src->connections, connection);
+				dst->connections =
+					jack_slist_prepend (dst->connections, connection);
+				g->nconnections++;
+			}
+		}
+	}
+
+	jack_slist_free (sinks);
+
+	g->segment = (char*)bench_alloc (g, engine->port_max * one_buffer);
+}
+
+static void
+bench_free_ports (bench_graph_t *g)
+{
+	jack_engine_t *engine = &g->engine;
+	jack_port_internal_t *port;
+	JSList *node;
+	int i;
+
+	for (i = 0; i < g->nclients; i++) {
+		jack_slist_free (g->clients[i]->ports);
+		g->clients[i]->ports = NULL;
+	}
+
+	/* every connection is on both its ports' lists */
+	for (i = 0; i < (int)engine->port_max; i++) {
+		port = &engine->internal_ports[i];
+		if (port->shared->flags & JackPortIsOutput) {
+			for (node = port->connections; node;
+			     node = jack_slist_next (node)) {
+				free (node->data);
+			}
+		}
+		jack_slist_free (port->connections);
+	}
+
+	free (engine->internal_ports);
+	free (engine->live_pos);
+	free (engine->live_next);
+	free (g->shared);
+	free (g->info);
+	free (g->segment);
+}
+
+static float *
+bench_buffer (bench_graph_t *g, jack_port_internal_t *port, int shared)
+{
+	jack_port_buffer_info_t *bi = port->buffer_info;
+
+	if (shared && port->live_buffer) {
+		bi = port->live_buffer;
+	}
+
+	return (float*)(g->segment + bi->offset);
+}
+
+/* the memory a cycle touches: every client in chain order mixes its
+   inputs, as jack_port_get_buffer() does, and writes its outputs; the
+   driver writes its capture ports first and mixes its playback ports
+   last */
+static float
+bench_traffic (bench_graph_t *g, int shared, float *mix,
+	       jack_nframes_t nframes)
+{
+	jack_client_internal_t *client, *driver = NULL;
+	jack_port_internal_t *port;
+	jack_connection_internal_t *connection;
+	JSList *node, *pnode, *cnode;
+	float *buf, sum = 0.0f;
+	jack_nframes_t f;
+
+	for (node = g->engine.clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t*)node->data;
+
+		if (client->control->type == ClientDriver) {
+			driver = client;
+		}
+
+		for (f = 0; f < nframes; f++) {
+			mix[f] = 0.0f;
+		}
+
+		for (pnode = client->ports; pnode; pnode = jack_slist_next (pnode)) {
+			port = (jack_port_internal_t*)pnode->data;
+			if (!(port->shared->flags & JackPortIsInput) ||
+			    client == driver) {
+				continue;
+			}
+			for (cnode = port->connections; cnode;
+			     cnode = jack_slist_next (cnode)) {
+				connection = (jack_connection_internal_t*)cnode->data;
+				buf = bench_buffer (g, connection->source, shared);
+				for (f = 0; f < nframes; f++) {
+					mix[f] += buf[f];
+				}
+			}
+		}
+
+		for (pnode = client->ports; pnode; pnode = jack_slist_next (pnode)) {
+			port = (jack_port_internal_t*)pnode->data;
+			if (!(port->shared->flags & JackPortIsOutput)) {
+				continue;
+			}
+			buf = bench_buffer (g, port, shared);
+			for (f = 0; f < nframes; f++) {
+				buf[f] = mix[f] * 0.5f + 1.0f;
+			}
+		}
+	}
+
+	for (pnode = driver->ports; pnode; pnode = jack_slist_next (pnode)) {
+		port = (jack_port_internal_t*)pnode->data;
+		if (!(port->shared->flags & JackPortIsInput)) {
+			continue;
+		}
+		for (cnode = port->connections; cnode;
+		     cnode = jack_slist_next (cnode)) {
+			connection = (jack_connection_internal_t*)cnode->data;
+			buf = bench_buffer (g, connection->source, shared);
+			for (f = 0; f < nframes; f++) {
+				sum += buf[f];
+			}
+		}
+	}
+
+	return sum;
+}
+
+/* a counter of the cache misses of this thread, or -1 */
+static int
+bench_open_misses (void)
+{
+#ifdef __linux
+	struct perf_event_attr attr;
+
+	memset (&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static void
+bench_count_misses (int fd, int on)
+{
+#ifdef __linux
+	if (fd >= 0) {
+		ioctl (fd, on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+	}
+#endif
+}
+
+static long long
+bench_read_misses (int fd)
+{
+	long long count = -1;
+
+#ifdef __linux
+	if (fd >= 0) {
+		if (read (fd, &count, sizeof(count)) != sizeof(count)) {
+			count = -1;
+		}
+		ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+	}
+#endif
+	return count;
+}
+
+/* usecs and cache misses per cycle, best of a few runs */
+static double
+bench_buffers (bench_graph_t *g, int shared, char *flush, float *mix,
+	       jack_nframes_t nframes, int misses_fd, double *misses)
+{
+	double start, elapsed, best = 0.0;
+	long long count, least = -1;
+	volatile float sink;
+	int r, i, cycles = (flush ? BENCH_CYCLES / 10 : BENCH_CYCLES);
+
+	bench_read_misses (misses_fd);
+
+	for (r = 0; r < BENCH_RUNS; r++) {
+		elapsed = 0.0;
+		for (i = 0; i < cycles; i++) {
+			if (flush) {
+				bench_flush (flush);
+			}
+			bench_count_misses (misses_fd, 1);
+			start = now ();
+			sink = bench_traffic (g, shared, mix, nframes);
+			elapsed += now () - start;
+			bench_count_misses (misses_fd, 0);
+		}
+		count = bench_read_misses (misses_fd);
+		if (count >= 0 && (least < 0 || count < least)) {
+			least = count;
+		}
+		if (best == 0.0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	(void)sink;
+	*misses = (least < 0 ? -1.0 : (double)least / cycles);
+
+	return best / cycles;
+}
+
+static void
+bench_report_buffers (const char *caches, double private_usecs,
+		      double shared_usecs, double private_misses,
+		      double shared_misses)
+{
+	if (private_misses < 0 || shared_misses < 0) {
+		printf ("%7s %14.2f %14.2f %14s %14s\n", caches,
+			private_usecs, shared_usecs, "-", "-");
+	} else {
+		printf ("%7s %14.2f %14.2f %14.0f %14.0f\n", caches,
+			private_usecs, shared_usecs, private_misses,
+			shared_misses);
+	}
+}
+
+/* how many different buffers the audio outputs use */
+static int
+bench_count_buffers (bench_graph_t *g, int shared)
+{
+	jack_port_internal_t *port;
+	char *seen;
+	int i, n = 0;
+
+	seen = (char*)calloc (g->engine.port_max, 1);
+
+	for (i = 0; i < (int)g->engine.port_max; i++) {
+		port = &g->engine.internal_ports[i];
+		if (port->buffer_info == NULL) {
+			continue;
+		}
+		if (shared && port->live_buffer) {
+			port = &g->engine.internal_ports[
+				port->live_buffer - g->info];
+		}
+		if (!seen[port->shared->id]) {
+			seen[port->shared->id] = 1;
+			n++;
+		}
+	}
+
+	free (seen);
+
+	return n;
+}
+
+int
+main (int argc, char *argv[])
+{
+	bench_graph_t g;
+	double kahn, old;
+	int fanout = 4, reach = 0, max_old = 256, nclients = 256;
+	jack_nframes_t nframes = 256;
+	double usecs[2], misses[2];
+	int misses_fd, nbuffers[2];
+	char *flush;
+	float *mix;
+	int kahn_bad = 0, old_bad = 0;
+	size_t c;
+	int opt;
+
+	const char *short_options = "f:r:m:c:p:h";
+	struct option long_options[] = {
+		{ "fanout", 1, 0, 'f' },
+		{ "reach", 1, 0, 'r' },
+		{ "max-old", 1, 0, 'm' },
+		{ "clients", 1, 0, 'c' },
+		{ "period", 1, 0, 'p' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((opt = getopt_long (argc, argv, short_options, long_options,
+				   NULL)) != -1) {
+		switch (opt) {
+		case 'f':
+			fanout = atoi (optarg);
+			break;
+		case 'r':
+			reach = atoi (optarg);
+			break;
+		case 'm':
+			max_old = atoi (optarg);
+			break;
+		case 'c':
+			nclients = atoi (optarg);
+			break;
+		case 'p':
+			nframes = atoi (optarg);
+			break;
+		case 'h':
+			usage (stdout);
+			return 0;
+		default:
+			usage (stderr);
+			return 1;
+		}
+	}
+
+	if (fanout < 1 || nclients < 2 || nframes < 1) {
+		usage (stderr);
+		return 1;
+	}
+
+	printf ("sorting the client graph, each client feeding up to %d "
+		"others\n", fanout);
+	printf ("%7s %7s %14s %14s\n", "clients", "edges",
+		"Kahn usecs", "old usecs");
+
+	for (c = 0; c < NCASES (client_counts); c++) {
+		srand (client_counts[c]);
+		bench_build (&g, client_counts[c], fanout, reach);
+
+		kahn = bench_sort (&g, jack_sort_clients, &kahn_bad);
+
+		if (client_counts[c] <= max_old) {
+			old = bench_sort (&g, old_sort_clients, &old_bad);
+			printf ("%7d %7d %14.1f %14.1f\n", client_counts[c],
+				g.nedges, kahn, old);
+		} else {
+			printf ("%7d %7d %14.1f %14s\n", client_counts[c],
+				g.nedges, kahn, "-");
+		}
+
+		bench_free (&g);
+	}
+
+	/* one cycle over a sorted graph, with the plan the server would
+	   make for it */
+
+	jack_init_time ();
+	jack_set_clock_source (JACK_TIMER_SYSTEM_CLOCK);
+
+	if ((flush = (char*)calloc (1, BENCH_FLUSH)) == NULL) {
+		fprintf (stderr, "jack_graphbench: out of memory\n");
+		return 1;
+	}
+
+	srand (nclients);
+	bench_build (&g, nclients, fanout, reach);
+	bench_shuffle (&g, 1);
+	jack_sort_clients (&g.engine);
+
+	if (jack_publish_plan (&g.engine)) {
+		fprintf (stderr, "jack_graphbench: cannot make a plan\n");
+		return 1;
+	}
+
+	printf ("\none cycle over %d internal clients\n", nclients);
+	printf ("%7s %14s %14s\n", "caches", "list usecs", "plan usecs");
+	printf ("%7s %14.2f %14.2f\n", "warm",
+		bench_cycle (&g, old_engine_process, NULL),
+		bench_cycle (&g, new_engine_process, NULL));
+	printf ("%7s %14.2f %14.2f\n", "flushed",
+		bench_cycle (&g, old_engine_process, flush),
+		bench_cycle (&g, new_engine_process, flush));
+
+	/* the same graph with ports, its buffers shared out */
+
+	bench_build_ports (&g, nframes);
+	jack_plan_shared_buffers (&g.engine);
+	jack_apply_shared_buffers (&g.engine);
+	nbuffers[0] = bench_count_buffers (&g, 0);
+	nbuffers[1] = bench_count_buffers (&g, 1);
+
+	if ((mix = (float*)calloc (nframes, sizeof(float))) == NULL) {
+		fprintf (stderr, "jack_graphbench: out of memory\n");
+		return 1;
+	}
+
+	printf ("\n%d audio outputs, %d connections, %u frames: "
+		"%lu kB of buffers alone, %d buffers (%lu kB) shared\n",
+		nbuffers[0], g.nconnections, nframes,
+		(unsigned long)(nbuffers[0] * nframes * sizeof(float) / 1024),
+		nbuffers[1],
+		(unsigned long)(nbuffers[1] * nframes * sizeof(float) / 1024));
+
+	misses_fd = bench_open_misses ();
+	printf ("%7s %14s %14s %14s %14s\n", "caches", "alone usecs",
+		"shared usecs", "alone misses", "shared misses");
+
+	usecs[0] = bench_buffers (&g, 0, NULL, mix, nframes, misses_fd, &misses[0]);
+	usecs[1] = bench_buffers (&g, 1, NULL, mix, nframes, misses_fd, &misses[1]);
+	bench_report_buffers ("warm", usecs[0], usecs[1], misses[0], misses[1]);
+
+	usecs[0] = bench_buffers (&g, 0, flush, mix, nframes, misses_fd, &misses[0]);
+	usecs[1] = bench_buffers (&g, 1, flush, mix, nframes, misses_fd, &misses[1]);
+	bench_report_buffers ("flushed", usecs[0], usecs[1], misses[0], misses[1]);
+
+	if (misses_fd < 0) {
+		printf ("(no cache miss counter: %s)\n", strerror (errno));
+	} else {
+		close (misses_fd);
+	}
+
+	bench_free_ports (&g);
+	bench_free (&g);
+	free (flush);
+	free (mix);
+
+	if (kahn_bad) {
+		printf ("jack_graphbench: Kahn sort put a client before one "
+			"that feeds it\n");
+	}
+	if (old_bad) {
+		printf ("(the old sort put a client before one that feeds it)\n");
+	}
+
+	return kahn_bad;
+}
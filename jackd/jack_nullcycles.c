@@ -0,0 +1,193 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    jack_nullcycles -- count the null cycles that graph changes cost
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+/* Two clients are opened, each with one input and one output. Every
+   iteration connects a to b and disconnects it again, which leaves
+   the chain order alone, and then, with -r, connects b to a and back,
+   which swaps the two clients in the chain. The engine's null cycle
+   counters are read before and after, so the same run against two
+   servers compares how often a graph change stalls the cycle. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <jack/jack.h>
+
+#include "internal.h"
+
+typedef struct {
+	jack_client_t *client;
+	jack_port_t *in;
+	jack_port_t *out;
+} bench_client_t;
+
+static void
+usage (FILE *file)
+{
+	fprintf (file,
+		 "usage: jack_nullcycles [ options ]\n"
+		 "  -s, --server NAME   connect to server NAME\n"
+		 "  -n, --count N       graph changes to make (default 1000)\n"
+		 "  -r, --reorder       also make changes that reorder the chain\n"
+		 "  -h, --help          this message\n");
+}
+
+static int
+process (jack_nframes_t nframes, void *arg)
+{
+	bench_client_t *c = (bench_client_t*)arg;
+
+	memcpy (jack_port_get_buffer (c->out, nframes),
+		jack_port_get_buffer (c->in, nframes),
+		nframes * sizeof(jack_default_audio_sample_t));
+	return 0;
+}
+
+static int
+bench_open (bench_client_t *c, const char *name, jack_options_t options,
+	    const char *server_name)
+{
+	jack_status_t status;
+
+	if ((c->client = jack_client_open (name, options, &status,
+					   server_name)) == NULL) {
+		fprintf (stderr, "jack_nullcycles: cannot connect to the "
+			 "JACK server\n");
+		return -1;
+	}
+
+	c->in = jack_port_register (c->client, "in", JACK_DEFAULT_AUDIO_TYPE,
+				    JackPortIsInput, 0);
+	c->out = jack_port_register (c->client, "out", JACK_DEFAULT_AUDIO_TYPE,
+				     JackPortIsOutput, 0);
+
+	if (c->in == NULL || c->out == NULL ||
+	    jack_set_process_callback (c->client, process, c) ||
+	    jack_activate (c->client)) {
+		fprintf (stderr, "jack_nullcycles: cannot set up %s\n", name);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+toggle (bench_client_t *from, bench_client_t *to)
+{
+	const char *src = jack_port_name (from->out);
+	const char *dst = jack_port_name (to->in);
+
+	if (jack_connect (from->client, src, dst) ||
+	    jack_disconnect (from->client, src, dst)) {
+		fprintf (stderr, "jack_nullcycles: cannot connect %s to %s\n",
+			 src, dst);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	bench_client_t a, b;
+	jack_options_t options = JackNoStartServer;
+	char *server_name = NULL;
+	uint32_t lock0, problem0, lock1, problem1;
+	jack_nframes_t frames0, frames1;
+	unsigned long cycles;
+	int count = 1000, reorder = 0, changes = 0;
+	int opt, i;
+
+	const char *short_options = "s:n:rh";
+	struct option long_options[] = {
+		{ "server", 1, 0, 's' },
+		{ "count", 1, 0, 'n' },
+		{ "reorder", 0, 0, 'r' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((opt = getopt_long (argc, argv, short_options, long_options,
+				   NULL)) != -1) {
+		switch (opt) {
+		case 's':
+			server_name = optarg;
+			options |= JackServerName;
+			break;
+		case 'n':
+			count = atoi (optarg);
+			break;
+		case 'r':
+			reorder = 1;
+			break;
+		case 'h':
+			usage (stdout);
+			return 0;
+		default:
+			usage (stderr);
+			return 1;
+		}
+	}
+
+	if (bench_open (&a, "nullcycles_a", options, server_name) ||
+	    bench_open (&b, "nullcycles_b", options, server_name)) {
+		return 1;
+	}
+
+	/* let the activations settle before counting */
+	sleep (1);
+
+	jack_get_null_cycles (a.client, &lock0, &problem0);
+	frames0 = jack_frame_time (a.client);
+
+	for (i = 0; i < count; i++) {
+		if (toggle (&a, &b)) {
+			break;
+		}
+		changes += 2;
+		if (reorder) {
+			if (toggle (&b, &a)) {
+				break;
+			}
+			changes += 2;
+		}
+	}
+
+	jack_get_null_cycles (a.client, &lock1, &problem1);
+	frames1 = jack_frame_time (a.client);
+	cycles = (frames1 - frames0) / jack_get_buffer_size (a.client);
+
+	printf ("%d graph changes over about %lu cycles\n", changes, cycles);
+	printf ("null cycles: %u lock-driven (%.3f per change), "
+		"%u problem-driven\n", lock1 - lock0,
+		changes ? (double)(lock1 - lock0) / changes : 0.0,
+		problem1 - problem0);
+
+	jack_client_close (b.client);
+	jack_client_close (a.client);
+
+	return 0;
+}
@@ -0,0 +1,257 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    jack_trace -- dump the server's per-cycle client timing trace
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <jack/jack.h>
+#include <jack/uuid.h>
+
+#include "internal.h"
+
+#define TRACE_BATCH 256
+#define NAME_CACHE_SIZE 256
+
+typedef struct {
+	jack_uuid_t uuid;
+	char name[JACK_CLIENT_NAME_SIZE];
+} name_entry_t;
+
+static name_entry_t name_cache[NAME_CACHE_SIZE];
+static int name_cache_cnt = 0;
+
+static void
+usage (FILE *file)
+{
+	fprintf (file,
+		 "usage: jack_trace [ options ]\n"
+		 "  -s, --server NAME   connect to server NAME\n"
+		 "  -f, --follow        keep reading as the server runs\n"
+		 "  -t, --timeline      draw one period wide timeline per cycle\n"
+		 "  -w, --width COLS    timeline width (default 64)\n"
+		 "  -h, --help          this message\n");
+}
+
+static const char *
+client_name (jack_client_t *client, jack_uuid_t uuid)
+{
+	char uuid_str[JACK_UUID_STRING_SIZE];
+	char *name;
+	name_entry_t *entry;
+	int i;
+
+	for (i = 0; i < name_cache_cnt; i++) {
+		if (jack_uuid_compare (name_cache[i].uuid, uuid) == 0) {
+			return name_cache[i].name;
+		}
+	}
+
+	/* recycle the cache once it fills up; clients come and go */
+	if (name_cache_cnt == NAME_CACHE_SIZE) {
+		name_cache_cnt = 0;
+	}
+
+	entry = &name_cache[name_cache_cnt++];
+	jack_uuid_copy (&entry->uuid, uuid);
+
+	jack_uuid_unparse (uuid, uuid_str);
+
+	if ((name = jack_get_client_name_by_uuid (client, uuid_str)) != NULL) {
+		snprintf (entry->name, sizeof(entry->name), "%s", name);
+		jack_free (name);
+	} else {
+		snprintf (entry->name, sizeof(entry->name), "%s", uuid_str);
+	}
+
+	return entry->name;
+}
+
+static void
+print_record (jack_client_t *client, const jack_trace_record_t *rec)
+{
+	printf ("%10" PRIu32 " %-24s %8" PRIu64 " %8" PRId64 " %8" PRId64 "%s%s\n",
+		rec->cycle,
+		client_name (client, rec->client_id),
+		rec->signalled_at,
+		rec->awake_at ? (int64_t)(rec->awake_at - rec->signalled_at) : -1,
+		rec->finished_at ? (int64_t)(rec->finished_at - rec->awake_at) : -1,
+		(rec->flags & JACK_TRACE_XRUN) ? " xrun" : "",
+		(rec->flags & JACK_TRACE_TIMEOUT) ? " timeout" : "");
+}
+
+static void
+print_timeline (jack_client_t *client, const jack_trace_record_t *recs,
+		int n, jack_time_t period_usecs, int width)
+{
+	jack_time_t start = recs[0].signalled_at;
+	char bar[width + 1];
+	int i, col, from, wake, to;
+
+	for (i = 1; i < n; i++) {
+		if (recs[i].signalled_at < start) {
+			start = recs[i].signalled_at;
+		}
+	}
+
+	printf ("cycle %" PRIu32 "%s\n", recs[0].cycle,
+		(recs[0].flags & JACK_TRACE_XRUN) ? " (after xrun)" : "");
+
+	for (i = 0; i < n; i++) {
+
+		from = (recs[i].signalled_at - start) * width / period_usecs;
+		wake = recs[i].awake_at ?
+		       (int)((recs[i].awake_at - start) * width / period_usecs) : width;
+		to = recs[i].finished_at ?
+		     (int)((recs[i].finished_at - start) * width / period_usecs) : width;
+
+		for (col = 0; col < width; col++) {
+			if (col < from || col > to) {
+				bar[col] = ' ';
+			} else if (col < wake) {
+				bar[col] = '.';
+			} else {
+				bar[col] = '#';
+			}
+		}
+		bar[width] = '\0';
+
+		printf ("  %-24s |%s|%s\n",
+			client_name (client, recs[i].client_id), bar,
+			(recs[i].flags & JACK_TRACE_TIMEOUT) ? " timeout" : "");
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	jack_client_t *client;
+	jack_status_t status;
+	jack_options_t options = JackNoStartServer;
+	jack_trace_record_t recs[TRACE_BATCH];
+	jack_trace_record_t cycle[TRACE_BATCH];
+	jack_time_t period_usecs;
+	uint64_t position = 0;
+	char *server_name = NULL;
+	int follow = 0;
+	int timeline = 0;
+	int width = 64;
+	int ncycle = 0;
+	int opt, n, i;
+
+	const char *short_options = "s:ftw:h";
+	struct option long_options[] =
+	{
+		{ "server",   1, 0, 's' },
+		{ "follow",   0, 0, 'f' },
+		{ "timeline", 0, 0, 't' },
+		{ "width",    1, 0, 'w' },
+		{ "help",     0, 0, 'h' },
+		{ 0,	      0, 0, 0	}
+	};
+
+	while ((opt = getopt_long (argc, argv, short_options,
+				   long_options, NULL)) != EOF) {
+		switch (opt) {
+		case 's':
+			server_name = optarg;
+			options |= JackServerName;
+			break;
+		case 'f':
+			follow = 1;
+			break;
+		case 't':
+			timeline = 1;
+			break;
+		case 'w':
+			width = atoi (optarg);
+			if (width < 8) {
+				width = 8;
+			}
+			break;
+		case 'h':
+			usage (stdout);
+			return 0;
+		default:
+			usage (stderr);
+			return 1;
+		}
+	}
+
+	if ((client = jack_client_open ("jack_trace", options, &status,
+					server_name)) == NULL) {
+		fprintf (stderr, "jack_trace: cannot connect to the JACK server\n");
+		return 1;
+	}
+
+	period_usecs = (jack_time_t)jack_get_buffer_size (client) * 1000000
+		       / jack_get_sample_rate (client);
+
+	if (!timeline) {
+		printf ("%10s %-24s %8s %8s %8s\n", "cycle", "client",
+			"signal", "wake", "run");
+	}
+
+	do {
+		if ((n = jack_get_cycle_trace (client, recs, TRACE_BATCH,
+					       &position)) < 0) {
+			jack_client_close (client);
+			return 1;
+		}
+
+		for (i = 0; i < n; i++) {
+
+			if (!timeline) {
+				print_record (client, &recs[i]);
+				continue;
+			}
+
+			if (ncycle && (cycle[0].cycle != recs[i].cycle ||
+				       ncycle == TRACE_BATCH)) {
+				print_timeline (client, cycle, ncycle,
+						period_usecs, width);
+				ncycle = 0;
+			}
+			cycle[ncycle++] = recs[i];
+		}
+
+		if (n == 0) {
+			if (ncycle) {
+				print_timeline (client, cycle, ncycle,
+						period_usecs, width);
+				ncycle = 0;
+			}
+			if (follow) {
+				fflush (stdout);
+				usleep (100000);
+			}
+		}
+
+	} while (n > 0 || follow);
+
+	jack_client_close (client);
+
+	return 0;
+}
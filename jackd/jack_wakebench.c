@@ -0,0 +1,335 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    jack_wakebench -- time a chain of graph wakeups, FIFOs against futexes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+ */
+
+/* A chain of processes stands in for the clients of a graph. Every
+   cycle the parent wakes the first one, each wakes the next as soon
+   as it is woken, and the last wakes the parent again, so a cycle is
+   one hop per process plus one back. This is done first the way the
+   engine does it by default, a byte written to a pipe and poll() and
+   read() on the other end, and then with the futex slots of wakeup.h
+   that the server uses with --futex-wakeup. Nothing is done between
+   wakeups, so the time per hop is the cost of the wakeup alone. No
+   server is needed. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "internal.h"
+#include "wakeup.h"
+
+#define BENCH_MAX_HOPS   (JACK_WAKEUP_SLOTS - 1)
+
+typedef struct {
+	int futex;
+	int hops;
+	int (*fds)[2];                  /* pipe n wakes process n */
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	jack_wakeup_slot_t *slots;      /* slot n wakes process n */
+#endif
+	volatile int *stop;
+} bench_chain_t;
+
+static void
+usage (FILE *file)
+{
+	fprintf (file,
+		 "usage: jack_wakebench [ options ]\n"
+		 "  -n, --hops N        processes in the chain (default 8)\n"
+		 "  -c, --cycles N      cycles to time (default 10000)\n"
+		 "  -R, --realtime      run the chain with SCHED_FIFO\n"
+		 "  -h, --help          this message\n");
+}
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+compare_double (const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+bench_signal (bench_chain_t *chain, int n)
+{
+	char c = 0;
+
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (chain->futex) {
+		jack_wakeup_signal (&chain->slots[n], JACK_WAKEUP_GRAPH);
+		return;
+	}
+#endif
+	if (write (chain->fds[n][1], &c, 1) != 1) {
+		fprintf (stderr, "jack_wakebench: cannot write to pipe %d "
+			 "(%s)\n", n, strerror (errno));
+		exit (1);
+	}
+}
+
+static void
+bench_wait (bench_chain_t *chain, int n)
+{
+	struct pollfd pfd;
+	char c;
+
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (chain->futex) {
+		while (jack_wakeup_wait (&chain->slots[n], JACK_WAKEUP_GRAPH,
+					 1000000) == 0) {
+		}
+		return;
+	}
+#endif
+	pfd.fd = chain->fds[n][0];
+	pfd.events = POLLIN;
+
+	while (poll (&pfd, 1, 1000) < 1 || !(pfd.revents & POLLIN)) {
+		if (pfd.revents & ~POLLIN) {
+			exit (1);
+		}
+	}
+
+	if (read (chain->fds[n][0], &c, 1) != 1) {
+		fprintf (stderr, "jack_wakebench: cannot read from pipe %d "
+			 "(%s)\n", n, strerror (errno));
+		exit (1);
+	}
+}
+
+static void
+bench_realtime (int priority)
+{
+	struct sched_param param;
+
+	memset (&param, 0, sizeof(param));
+	param.sched_priority = priority;
+
+	if (sched_setscheduler (0, SCHED_FIFO, &param)) {
+		fprintf (stderr, "jack_wakebench: cannot use SCHED_FIFO (%s); "
+			 "timing without it\n", strerror (errno));
+	}
+}
+
+/* Time `cycles' trips around the chain. Each cycle's time per hop is
+ * stored in per_hop[], sorted.
+ */
+static int
+bench_run (bench_chain_t *chain, int cycles, int realtime, double *per_hop)
+{
+	pid_t *pids;
+	double start;
+	int i, n, status, stop, failed = 0;
+
+	*chain->stop = 0;
+
+	if ((pids = (pid_t*)calloc (chain->hops, sizeof(pid_t))) == NULL) {
+		return -1;
+	}
+
+	for (n = 0; n < chain->hops; n++) {
+		if ((pids[n] = fork ()) == 0) {
+			if (realtime) {
+				bench_realtime (realtime);
+			}
+			/* look at the flag before passing the wakeup
+			   on, after which the parent may set it */
+			for (;;) {
+				bench_wait (chain, n);
+				stop = *chain->stop;
+				bench_signal (chain, n + 1);
+				if (stop) {
+					_exit (0);
+				}
+			}
+		}
+		if (pids[n] < 0) {
+			fprintf (stderr, "jack_wakebench: cannot fork (%s)\n",
+				 strerror (errno));
+			chain->hops = n;
+			failed = 1;
+			break;
+		}
+	}
+
+	if (realtime) {
+		bench_realtime (realtime + 1);
+	}
+
+	/* one trip round to get everything running and paged in */
+	for (i = -1; i < cycles && !failed; i++) {
+		start = now ();
+		bench_signal (chain, 0);
+		bench_wait (chain, chain->hops);
+		if (i >= 0) {
+			per_hop[i] = (now () - start) / (chain->hops + 1);
+		}
+	}
+
+	*chain->stop = 1;
+	if (chain->hops) {
+		bench_signal (chain, 0);
+		bench_wait (chain, chain->hops);
+	}
+
+	for (n = 0; n < chain->hops; n++) {
+		waitpid (pids[n], &status, 0);
+	}
+	free (pids);
+
+	if (failed) {
+		return -1;
+	}
+
+	qsort (per_hop, cycles, sizeof(double), compare_double);
+
+	return 0;
+}
+
+static void
+bench_report (const char *name, double *per_hop, int cycles)
+{
+	double total = 0.0;
+	int i;
+
+	for (i = 0; i < cycles; i++) {
+		total += per_hop[i];
+	}
+
+	printf ("%-6s mean %.2f, median %.2f, p99 %.2f, max %.2f usecs "
+		"per hop\n", name, total / cycles, per_hop[cycles / 2],
+		per_hop[(int)(cycles * 0.99)], per_hop[cycles - 1]);
+}
+
+int
+main (int argc, char *argv[])
+{
+	bench_chain_t chain;
+	double *per_hop;
+	int cycles = 10000, realtime = 0;
+	int opt, n;
+
+	const char *short_options = "n:c:Rh";
+	struct option long_options[] = {
+		{ "hops", 1, 0, 'n' },
+		{ "cycles", 1, 0, 'c' },
+		{ "realtime", 0, 0, 'R' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	memset (&chain, 0, sizeof(chain));
+	chain.hops = 8;
+
+	while ((opt = getopt_long (argc, argv, short_options, long_options,
+				   NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			chain.hops = atoi (optarg);
+			break;
+		case 'c':
+			cycles = atoi (optarg);
+			break;
+		case 'R':
+			realtime = 10;
+			break;
+		case 'h':
+			usage (stdout);
+			return 0;
+		default:
+			usage (stderr);
+			return 1;
+		}
+	}
+
+	if (chain.hops < 1 || chain.hops > BENCH_MAX_HOPS || cycles < 1) {
+		usage (stderr);
+		return 1;
+	}
+
+	/* the children see these through fork(); the futex slots and
+	   the stop flag have to be shared to be seen at all */
+	chain.fds = calloc (chain.hops + 1, sizeof(*chain.fds));
+	per_hop = (double*)calloc (cycles, sizeof(double));
+	chain.stop = (volatile int*)mmap (NULL, sizeof(int),
+					  PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (chain.fds == NULL || per_hop == NULL || chain.stop == MAP_FAILED) {
+		fprintf (stderr, "jack_wakebench: out of memory\n");
+		return 1;
+	}
+
+	for (n = 0; n <= chain.hops; n++) {
+		if (pipe (chain.fds[n])) {
+			fprintf (stderr, "jack_wakebench: cannot create pipe "
+				 "(%s)\n", strerror (errno));
+			return 1;
+		}
+	}
+
+	printf ("%d hops per cycle, %d cycles\n", chain.hops + 1, cycles);
+
+	chain.futex = 0;
+	if (bench_run (&chain, cycles, realtime, per_hop)) {
+		return 1;
+	}
+	bench_report ("fifo", per_hop, cycles);
+
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	chain.slots = (jack_wakeup_slot_t*)
+		      mmap (NULL, (chain.hops + 1) * sizeof(jack_wakeup_slot_t),
+			    PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (chain.slots == MAP_FAILED) {
+		fprintf (stderr, "jack_wakebench: out of memory\n");
+		return 1;
+	}
+
+	chain.futex = 1;
+	if (bench_run (&chain, cycles, realtime, per_hop)) {
+		return 1;
+	}
+	bench_report ("futex", per_hop, cycles);
+#else
+	printf ("futex  not available on this system\n");
+#endif
+
+	return 0;
+}
@@ -72,6 +72,10 @@ static int do_unlock = 0;
 static jack_nframes_t frame_time_offset = 0;
 static int nozombies = 0;
 static int timeout_count_threshold = 0;
+static int parallel = 0;
+static int futex_wakeup = 0;
+static int share_buffers = 0;
+static int share_mixdowns = 0;
 
 extern int sanitycheck(int, int);
 
@@ -306,7 +310,9 @@ jack_main (jack_driver_desc_t * driver_desc, JSList * driver_params, JSList * sl
 				       do_mlock, do_unlock, server_name,
 				       temporary, verbose, client_timeout,
 				       port_max, getpid (), frame_time_offset,
-				       nozombies, timeout_count_threshold, drivers)) == 0) {
+				       nozombies, timeout_count_threshold, parallel,
+				       futex_wakeup, share_buffers, share_mixdowns,
+				       drivers)) == 0) {
 		jack_error ("cannot create engine");
 		return -1;
 	}
@@ -676,9 +682,9 @@ main (int argc, char *argv[])
 	int show_version = 0;
 
 #ifdef HAVE_ZITA_BRIDGE_DEPS
-	const char *options = "A:d:P:uvshVrRZTFlI:t:mM:n:Np:c:X:C:";
+	const char *options = "A:Bd:GP:uvshVrRWZTFlI:t:mM:n:Np:c:xX:C:";
 #else
-	const char *options = "d:P:uvshVrRZTFlI:t:mM:n:Np:c:X:C:";
+	const char *options = "Bd:GP:uvshVrRWZTFlI:t:mM:n:Np:c:xX:C:";
 #endif
 	struct option long_options[] =
 	{
@@ -687,8 +693,10 @@ main (int argc, char *argv[])
 #ifdef HAVE_ZITA_BRIDGE_DEPS
 		{ "alsa-add",	       1, 0,		     'A' },
 #endif
+		{ "share-buffers",     0, 0,		     'B' },
 		{ "clock-source",      1, 0,		     'c' },
 		{ "driver",	       1, 0,		     'd' },
+		{ "parallel",	       0, 0,		     'G' },
 		{ "help",	       0, 0,		     'h' },
 		{ "tmpdir-location",   0, 0,		     'l' },
 		{ "internal-client",   0, 0,		     'I' },
@@ -708,6 +716,8 @@ main (int argc, char *argv[])
 		{ "unlock",	       0, 0,		     'u' },
 		{ "version",	       0, 0,		     'V' },
 		{ "verbose",	       0, 0,		     'v' },
+		{ "futex-wakeup",      0, 0,		     'W' },
+		{ "share-mixdowns",    0, 0,		     'x' },
 		{ "slave-driver",      1, 0,		     'X' },
 		{ "nozombies",	       0, 0,		     'Z' },
 		{ "timeout-thres",     2, 0,		     'C' },
@@ -801,6 +811,10 @@ main (int argc, char *argv[])
 			}
 			break;
 
+		case 'B':
+			share_buffers = 1;
+			break;
+
 		case 'd':
 			seen_driver = optind + 1;
 			driver_name = optarg;
@@ -810,6 +824,10 @@ main (int argc, char *argv[])
 			frame_time_offset = JACK_MAX_FRAMES - atoi (optarg);
 			break;
 
+		case 'G':
+			parallel = 1;
+			break;
+
 		case 'l':
 			/* special flag to allow libjack to determine jackd's idea of where tmpdir is */
 			printf("%s\n", DEFAULT_TMP_DIR);
@@ -881,6 +899,14 @@ main (int argc, char *argv[])
 			show_version = 1;
 			break;
 
+		case 'W':
+			futex_wakeup = 1;
+			break;
+
+		case 'x':
+			share_mixdowns = 1;
+			break;
+
 		case 'X':
 			slave_drivers = jack_slist_append (slave_drivers, optarg);
 			break;
@@ -75,16 +75,16 @@ jack_sync_poll_deactivate (jack_engine_t *engine,
 
 /* stop polling all the slow-sync clients
  *
- *   precondition: caller holds the graph lock. */
+ *   precondition: called from the cycle. */
 static void
 jack_sync_poll_stop (jack_engine_t *engine)
 {
-	JSList *node;
+	jack_plan_t *plan = engine->plan_in_use;
+	unsigned int n;
 	long poll_count = 0;            /* count sync_poll clients */
 
-	for (node = engine->clients; node; node = jack_slist_next (node)) {
-		jack_client_internal_t *client =
-			(jack_client_internal_t*)node->data;
+	for (n = 0; n < plan->nclients; n++) {
+		jack_client_internal_t *client = plan->clients[n].client;
 		if (client->control->active_slowsync &&
 		    client->control->sync_poll) {
 			client->control->sync_poll = 0;
@@ -105,16 +105,16 @@ jack_sync_poll_stop (jack_engine_t *engine)
 
 /* start polling all the slow-sync clients
  *
- *   precondition: caller holds the graph lock. */
+ *   precondition: called from the cycle. */
 static void
 jack_sync_poll_start (jack_engine_t *engine)
 {
-	JSList *node;
+	jack_plan_t *plan = engine->plan_in_use;
+	unsigned int n;
 	long sync_count = 0;            /* count slow-sync clients */
 
-	for (node = engine->clients; node; node = jack_slist_next (node)) {
-		jack_client_internal_t *client =
-			(jack_client_internal_t*)node->data;
+	for (n = 0; n < plan->nclients; n++) {
+		jack_client_internal_t *client = plan->clients[n].client;
 		if (client->control->active_slowsync) {
 			client->control->sync_poll = 1;
 			sync_count++;
@@ -174,6 +174,7 @@ jack_timebase_reset (jack_engine_t *engine, jack_uuid_t client_id)
 	jack_control_t *ectl = engine->control;
 
 	jack_lock_graph (engine);
+	jack_lock_rt (engine);
 
 	client = jack_client_internal_by_id (engine, client_id);
 	if (client && (client == engine->timebase_client)) {
@@ -188,6 +189,7 @@ jack_timebase_reset (jack_engine_t *engine, jack_uuid_t client_id)
 		ret = EINVAL;
 	}
 
+	jack_unlock_rt (engine);
 	jack_unlock_graph (engine);
 
 	return ret;
@@ -202,11 +204,13 @@ jack_timebase_set (jack_engine_t *engine,
 	struct _jack_client_internal *client;
 
 	jack_lock_graph (engine);
+	jack_lock_rt (engine);
 
 	client = jack_client_internal_by_id (engine, client_id);
 
 	if (client == NULL) {
 		VERBOSE (engine, " %" PRIu32 " no longer exists", client_id);
+		jack_unlock_rt (engine);
 		jack_unlock_graph (engine);
 		return EINVAL;
 	}
@@ -240,6 +244,7 @@ jack_timebase_set (jack_engine_t *engine,
 			 client->control->name);
 	}
 
+	jack_unlock_rt (engine);
 	jack_unlock_graph (engine);
 
 	return ret;
@@ -251,6 +256,8 @@ jack_timebase_set (jack_engine_t *engine,
 void
 jack_transport_activate (jack_engine_t *engine, jack_client_internal_t *client)
 {
+	jack_lock_rt (engine);
+
 	if (client->control->is_slowsync) {
 		assert (!client->control->active_slowsync);
 		client->control->active_slowsync = 1;
@@ -261,6 +268,8 @@ jack_transport_activate (jack_engine_t *engine, jack_client_internal_t *client)
 	if (client->control->is_timebase) {
 		client->control->timebase_new = 1;
 	}
+
+	jack_unlock_rt (engine);
 }
 
 /* for engine initialization */
@@ -294,6 +303,8 @@ void
 jack_transport_client_exit (jack_engine_t *engine,
 			    jack_client_internal_t *client)
 {
+	jack_lock_rt (engine);
+
 	if (client == engine->timebase_client) {
 		if (client->control->dead) {
 			engine->timebase_client->control->is_timebase = 0;
@@ -313,6 +324,8 @@ jack_transport_client_exit (jack_engine_t *engine,
 			client->control->is_slowsync = 0;
 		}
 	}
+
+	jack_unlock_rt (engine);
 }
 
 /* when a new client is being created */
@@ -348,6 +361,7 @@ jack_transport_client_reset_sync (jack_engine_t *engine,
 	jack_client_internal_t *client;
 
 	jack_lock_graph (engine);
+	jack_lock_rt (engine);
 
 	client = jack_client_internal_by_id (engine, client_id);
 
@@ -361,6 +375,7 @@ jack_transport_client_reset_sync (jack_engine_t *engine,
 		ret = EINVAL;
 	}
 
+	jack_unlock_rt (engine);
 	jack_unlock_graph (engine);
 
 	return ret;
@@ -376,8 +391,9 @@ jack_transport_client_set_sync (jack_engine_t *engine,
 
 	DEBUG ("set sync client");
 
-	/* The process cycle runs with this lock. */
+	/* The process cycle runs with the rt lock. */
 	jack_lock_graph (engine);
+	jack_lock_rt (engine);
 
 	DEBUG ("got write lock");
 
@@ -405,6 +421,7 @@ jack_transport_client_set_sync (jack_engine_t *engine,
 	}
 
 	DEBUG ("unlocking write lock for set_sync");
+	jack_unlock_rt (engine);
 	jack_unlock_graph (engine);
 
 
@@ -413,7 +430,7 @@ jack_transport_client_set_sync (jack_engine_t *engine,
 
 /* at process cycle end, set transport parameters for the next cycle
  *
- * precondition: caller holds the graph lock.
+ * precondition: called from the cycle.
  */
 void
 jack_transport_cycle_end (jack_engine_t *engine)
@@ -53,6 +53,7 @@
 #include "varargs.h"
 #include "intsimd.h"
 #include "messagebuffer.h"
+#include "wakeup.h"
 
 #include <sysdeps/time.h>
 
@@ -91,7 +92,7 @@ int cpu_type = 0;
 static void
 init_cpu ()
 {
-	cpu_type = ((have_3dnow () << 8) | have_sse ());
+	cpu_type = ((have_avx () << 16) | (have_3dnow () << 8) | have_sse ());
 #if 0
 	if (ARCH_X86_HAVE_3DNOW (cpu_type)) {
 		jack_debug ("Enhanced3DNow! detected");
@@ -99,6 +100,10 @@ init_cpu ()
 	if (ARCH_X86_HAVE_SSE2 (cpu_type)) {
 		jack_debug ("SSE2 detected");
 	}
+	if (ARCH_X86_HAVE_AVX2 (cpu_type)) {
+		jack_debug ("AVX2%s detected",
+			    ARCH_X86_HAVE_AVX512 (cpu_type) ? " and AVX-512" : "");
+	}
 	if ((!ARCH_X86_HAVE_3DNOW (cpu_type)) && (!ARCH_X86_HAVE_SSE2 (cpu_type))) {
 		jack_debug ("No supported SIMD instruction sets detected");
 	}
@@ -269,12 +274,92 @@ jack_info (const char *fmt, ...)
 	va_end (ap);
 }
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+
+/* Queue req in the control block and wait for the server to fill in
+ * the reply. Several threads may have requests outstanding at once,
+ * up to the depth of the ring; the server serves them in order off a
+ * single doorbell.
+ */
+static int
+shm_client_deliver_request (jack_client_t *client, jack_request_t *req)
+{
+	jack_client_control_t *control = client->control;
+	jack_request_t doorbell;
+	jack_request_t *slot;
+	uint32_t head, tail, n;
+
+	pthread_mutex_lock (&client->request_lock);
+
+	/* a slot stays busy until its reply has been copied out,
+	   which also keeps us from overrunning the server. Another
+	   thread may have queued while we waited, so look at the head
+	   again every time we wake. */
+	for (;;) {
+		head = control->request_head;
+		n = head & (JACK_REQUEST_RING_SIZE - 1);
+		if (!client->request_busy[n]) {
+			break;
+		}
+		pthread_cond_wait (&client->request_free, &client->request_lock);
+	}
+
+	client->request_busy[n] = 1;
+	slot = (jack_request_t*)&control->request_ring[n];
+	memcpy (slot, req, sizeof(*req));
+	__atomic_store_n (&control->request_head, head + 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_exchange_n (&control->request_armed, 0, __ATOMIC_SEQ_CST)) {
+		memset (&doorbell, 0, sizeof(doorbell));
+		doorbell.type = RequestsQueued;
+		if (write_retry (client->request_fd, &doorbell, sizeof(doorbell))
+		    != sizeof(doorbell)) {
+			jack_error ("cannot send request doorbell to server");
+		}
+	}
+
+	pthread_mutex_unlock (&client->request_lock);
+
+	for (;;) {
+		tail = __atomic_load_n (&control->request_tail, __ATOMIC_ACQUIRE);
+
+		if ((int32_t)(tail - head) > 0) {
+			memcpy (req, slot, sizeof(*req));
+			break;
+		}
+
+		if (client->engine->engine_ok == 0 || control->dead) {
+			req->status = -1;
+			break;
+		}
+
+		__atomic_fetch_add (&control->request_waiters, 1, __ATOMIC_SEQ_CST);
+		jack_futex_wait (&control->request_tail, tail, 1000000);
+		__atomic_fetch_sub (&control->request_waiters, 1, __ATOMIC_SEQ_CST);
+	}
+
+	pthread_mutex_lock (&client->request_lock);
+	client->request_busy[n] = 0;
+	pthread_cond_broadcast (&client->request_free);
+	pthread_mutex_unlock (&client->request_lock);
+
+	return req->status;
+}
+
+#endif /* JACK_HAVE_FUTEX_WAKEUP */
+
 static int
 oop_client_deliver_request (void *ptr, jack_request_t *req)
 {
 	int wok, rok;
 	jack_client_t *client = (jack_client_t*)ptr;
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (client->shm_requests && jack_request_via_shm (req->type)) {
+		return shm_client_deliver_request (client, req);
+	}
+#endif
+
 	wok = (write_retry (client->request_fd, req, sizeof(*req))
 	       == sizeof(*req));
 
@@ -292,6 +377,20 @@ oop_client_deliver_request (void *ptr, jack_request_t *req)
 		}
 	}
 
+	/* ... and the steps after a ConnectPortsMany request
+	 */
+
+	if (req->type == ConnectPortsMany && req->x.connections.nops) {
+		size_t len = req->x.connections.nops * sizeof(jack_connection_op_t);
+
+		if (write_retry (client->request_fd, req->x.connections.ops, len) != len) {
+			jack_error ("cannot send %u connections to server",
+				    req->x.connections.nops);
+			req->status = -1;
+			return req->status;
+		}
+	}
+
 	rok = (read_retry (client->request_fd, req, sizeof(*req))
 	       == sizeof(*req));
 
@@ -318,6 +417,30 @@ oop_client_deliver_request (void *ptr, jack_request_t *req)
 	return req->status;
 }
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+
+/* Ask the server to take our requests through the control block from
+ * now on. Failure is harmless: we simply keep using the socket.
+ */
+static void
+jack_client_enable_shm_requests (jack_client_t *client)
+{
+	jack_request_t req;
+
+	memset (&req, 0, sizeof(req));
+	req.type = EnableRequestRing;
+	req.status = -1;
+
+	if (oop_client_deliver_request (client, &req) == 0) {
+		client->shm_requests = 1;
+	} else {
+		jack_info ("server does not take requests through shared memory,"
+			   " using the request socket");
+	}
+}
+
+#endif /* JACK_HAVE_FUTEX_WAKEUP */
+
 int
 jack_client_deliver_request (const jack_client_t *client, jack_request_t *req)
 {
@@ -361,6 +484,8 @@ jack_client_alloc ()
 	client->on_info_shutdown = NULL;
 	client->n_port_types = 0;
 	client->port_segment = NULL;
+	pthread_mutex_init (&client->port_index_lock, NULL);
+	pthread_mutex_init (&client->attach_lock, NULL);
 
 #ifdef USE_DYNSIMD
 	init_cpu ();
@@ -388,6 +513,8 @@ jack_client_alloc ()
 	client->request_fd = -1;
 	client->event_fd = -1;
 	client->upstream_is_jackd = 0;
+	client->wakeup_slot = -1;
+	client->graph_slot = -1;
 	client->graph_wait_fd = -1;
 	client->graph_next_fd = -1;
 	client->ports = NULL;
@@ -400,6 +527,18 @@ jack_client_alloc ()
 	client->on_info_shutdown = NULL;
 	client->n_port_types = 0;
 	client->port_segment = NULL;
+	pthread_mutex_init (&client->port_index_lock, NULL);
+	pthread_mutex_init (&client->attach_lock, NULL);
+	client->shm_requests = 0;
+	pthread_mutex_init (&client->request_lock, NULL);
+	pthread_cond_init (&client->request_free, NULL);
+	client->separate_events = 0;
+	client->event_thread_ok = FALSE;
+	client->wake_fds[0] = -1;
+	client->wake_fds[1] = -1;
+	client->done_fds[0] = -1;
+	client->done_fds[1] = -1;
+	client->reorder_pending = 0;
 
 #ifdef USE_DYNSIMD
 	init_cpu ();
@@ -439,6 +578,47 @@ jack_client_free (jack_client_t *client)
 	free (client);
 }
 
+/* Set aside a mix buffer per input port, in the size class that port
+ * will ask for, so that connections made while we are running do not
+ * have to go to the system allocator, which may happen in the process
+ * thread.
+ */
+static void
+jack_client_reserve_mix_buffers (jack_client_t *client)
+{
+	JSList *node;
+	jack_port_t *port;
+	unsigned int ninputs[JACK_POOL_CLASSES];
+	int cls;
+
+	memset (ninputs, 0, sizeof(ninputs));
+
+	for (node = client->ports; node; node = jack_slist_next (node)) {
+		port = (jack_port_t*)node->data;
+		if (port->shared->flags & JackPortIsInput) {
+			cls = jack_pool_size_class (jack_port_type_buffer_size (
+				port->type_info, client->engine->buffer_size));
+			if (cls >= 0) {
+				ninputs[cls]++;
+			}
+		}
+	}
+
+	for (cls = 0; cls < JACK_POOL_CLASSES; cls++) {
+		if (ninputs[cls] <= client->mix_reserved[cls]) {
+			continue;
+		}
+		if (jack_pool_reserve ((size_t)JACK_POOL_MIN_BLOCK << cls,
+				       ninputs[cls] - client->mix_reserved[cls])) {
+			jack_error ("cannot reserve %u mix buffers of %u bytes",
+				    ninputs[cls] - client->mix_reserved[cls],
+				    JACK_POOL_MIN_BLOCK << cls);
+			continue;
+		}
+		client->mix_reserved[cls] = ninputs[cls];
+	}
+}
+
 void
 jack_client_fix_port_buffers (jack_client_t *client)
 {
@@ -462,6 +642,7 @@ jack_client_fix_port_buffers (jack_client_t *client)
 				jack_pool_release (port->mix_buffer);
 				port->mix_buffer = NULL;
 				pthread_mutex_lock (&port->connection_lock);
+				port->mix_cycle = 0;
 				if (jack_slist_length (port->connections) > 1) {
 					port->mix_buffer = jack_pool_alloc (buffer_size);
 					port->fptr.buffer_init (port->mix_buffer,
@@ -513,6 +694,7 @@ jack_client_handle_port_connection (jack_client_t *client, jack_event_t *event)
 			control_port->connections =
 				jack_slist_prepend (control_port->connections,
 						    (void*)other);
+			jack_port_mixdown_changed (client, control_port);
 			pthread_mutex_unlock (&control_port->connection_lock);
 			break;
 
@@ -540,6 +722,7 @@ jack_client_handle_port_connection (jack_client_t *client, jack_event_t *event)
 				}
 			}
 
+			jack_port_mixdown_changed (client, control_port);
 			pthread_mutex_unlock (&control_port->connection_lock);
 			break;
 
@@ -753,6 +936,27 @@ jack_handle_reorder (jack_client_t *client, jack_event_t *event)
 
 	DEBUG ("graph reorder\n");
 
+	if (!client->engine->futex_wakeup &&
+	    client->graph_slot == (int)event->x.n &&
+	    client->upstream_is_jackd == (int)event->y.n &&
+	    client->graph_wait_fd >= 0 && client->graph_next_fd >= 0) {
+
+		/* still in the same place: the server only sends this
+		   when our position did not change if we asked for
+		   graph order callbacks, so keep the FIFOs open.
+		 */
+
+		DEBUG ("position unchanged, keeping FIFOs");
+
+		if (client->control->graph_order_cbset && !client->separate_events) {
+			client->graph_order (client->graph_order_arg);
+		}
+
+		return 0;
+	}
+
+	client->graph_slot = -1;
+
 	if (client->graph_wait_fd >= 0) {
 		DEBUG ("closing graph_wait_fd==%d", client->graph_wait_fd);
 		close (client->graph_wait_fd);
@@ -765,6 +969,31 @@ jack_handle_reorder (jack_client_t *client, jack_event_t *event)
 		client->graph_next_fd = -1;
 	}
 
+	client->wakeup_slot = -1;
+
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (client->engine->futex_wakeup) {
+
+		/* the chain runs through the wakeup slots in the
+		   engine control segment. events are announced on
+		   our slot as well, so there is nothing to poll.
+		 */
+
+		client->wakeup_slot = event->x.n;
+		client->upstream_is_jackd = event->y.n;
+		client->pollmax = 1;
+
+		DEBUG ("waiting on wakeup slot %d (upstream is jackd? %d)",
+		       client->wakeup_slot, client->upstream_is_jackd);
+
+		if (client->control->graph_order_cbset && !client->separate_events) {
+			client->graph_order (client->graph_order_arg);
+		}
+
+		return 0;
+	}
+#endif
+
 	sprintf (path, "%s-%" PRIu32, client->fifo_prefix, event->x.n);
 
 	if ((client->graph_wait_fd = open (path, O_RDONLY | O_NONBLOCK)) < 0) {
@@ -783,6 +1012,7 @@ jack_handle_reorder (jack_client_t *client, jack_event_t *event)
 	}
 
 	client->upstream_is_jackd = event->y.n;
+	client->graph_slot = event->x.n;
 	client->pollmax = 2;
 
 	DEBUG ("opened new graph_next_fd %d (%s) (upstream is jackd? %d)",
@@ -793,13 +1023,105 @@ jack_handle_reorder (jack_client_t *client, jack_event_t *event)
 	   execute it now.
 	 */
 
-	if (client->control->graph_order_cbset) {
+	if (client->control->graph_order_cbset && !client->separate_events) {
 		client->graph_order (client->graph_order_arg);
 	}
 
 	return 0;
 }
 
+/* JACK_EVENT_THREAD: called on the event thread. The process thread
+ * may be waiting on the FIFO or wakeup slot we are about to leave, so
+ * wake it and let it move itself, then run the callback here. It only
+ * looks between cycles, so give it a few periods: the engine is
+ * waiting for our reply before it runs the new order.
+ */
+#define JACK_REORDER_HANDOVER_PERIODS 4
+#define JACK_REORDER_HANDOVER_MIN_MSECS 10
+
+static int
+jack_client_hand_over_reorder (jack_client_t *client, jack_event_t *event)
+{
+	int slot = __atomic_load_n (&client->wakeup_slot, __ATOMIC_ACQUIRE);
+	int msecs = client->engine->frame_timer.period_usecs
+		    * JACK_REORDER_HANDOVER_PERIODS / 1000;
+	jack_time_t deadline;
+	struct pollfd pfd;
+	char buf[16];
+	char c = 0;
+	int ret;
+
+	if (msecs < JACK_REORDER_HANDOVER_MIN_MSECS) {
+		msecs = JACK_REORDER_HANDOVER_MIN_MSECS;
+	}
+	deadline = jack_get_microseconds () + (jack_time_t)msecs * 1000;
+
+	memcpy (&client->reorder_event, event, sizeof(*event));
+	__atomic_store_n (&client->reorder_pending, 1, __ATOMIC_RELEASE);
+
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (slot >= 0) {
+		jack_wakeup_signal (&client->engine->wakeup[slot],
+				    JACK_WAKEUP_EVENT);
+	}
+#endif
+	if (write (client->wake_fds[1], &c, sizeof(c)) < 0 && errno != EAGAIN) {
+		jack_error ("cannot wake process thread (%s)", strerror (errno));
+	}
+
+	pfd.fd = client->done_fds[0];
+	pfd.events = POLLIN;
+
+	while (__atomic_load_n (&client->reorder_pending, __ATOMIC_ACQUIRE)) {
+		jack_time_t now = jack_get_microseconds ();
+		if (now >= deadline) {
+			jack_error ("process thread did not take the new "
+				    "graph order within %d msecs", msecs);
+			return -1;
+		}
+		ret = poll (&pfd, 1, (int)((deadline - now + 999) / 1000));
+		if (ret < 0 && errno != EINTR) {
+			jack_error ("poll failed in client (%s)",
+				    strerror (errno));
+			return -1;
+		}
+		while (read (client->done_fds[0], buf, sizeof(buf)) > 0) {
+			/* drain */
+		}
+	}
+
+	if (client->control->graph_order_cbset) {
+		client->graph_order (client->graph_order_arg);
+	}
+
+	return client->reorder_status;
+}
+
+/* JACK_EVENT_THREAD: called on the process thread whenever it wakes up
+ * for anything but the graph.
+ */
+static void
+jack_client_take_reorder (jack_client_t *client)
+{
+	char buf[16];
+	char c = 0;
+
+	while (read (client->wake_fds[0], buf, sizeof(buf)) > 0) {
+		/* drain */
+	}
+
+	if (__atomic_load_n (&client->reorder_pending, __ATOMIC_ACQUIRE)) {
+		client->reorder_status =
+			jack_handle_reorder (client, &client->reorder_event);
+		__atomic_store_n (&client->reorder_pending, 0, __ATOMIC_RELEASE);
+		if (write (client->done_fds[1], &c, sizeof(c)) < 0
+		    && errno != EAGAIN) {
+			jack_error ("cannot wake event thread (%s)",
+				    strerror (errno));
+		}
+	}
+}
+
 #endif
 
 static int
@@ -1065,6 +1387,7 @@ jack_request_client (ClientType type,
 		     jack_client_connect_result_t *res, int *req_fd)
 {
 	jack_client_connect_request_t req;
+	jack_uuid_t uuid;
 
 	*req_fd = -1;
 	memset (&req, 0, sizeof(req));
@@ -1115,14 +1438,16 @@ jack_request_client (ClientType type,
 
 	/* format connection request */
 
+	/* req is packed, so the uuid is filled in through a copy */
 	if (va->sess_uuid && strlen (va->sess_uuid)) {
-		if (jack_uuid_parse (va->sess_uuid, &req.uuid) != 0) {
+		if (jack_uuid_parse (va->sess_uuid, &uuid) != 0) {
 			jack_error ("Given UUID [%s] is not parseable", va->sess_uuid);
 			goto fail;
 		}
 	} else {
-		jack_uuid_clear (&req.uuid);
+		jack_uuid_clear (&uuid);
 	}
+	req.uuid = uuid;
 	req.protocol_v = jack_protocol_version;
 	req.load = TRUE;
 	req.type = type;
@@ -1375,6 +1700,32 @@ jack_client_open_aux (const char *client_name,
 
 	client->event_fd = ev_fd;
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (getenv ("JACK_SHM_REQUESTS")) {
+		jack_client_enable_shm_requests (client);
+	}
+#endif
+
+#ifndef JACK_USE_MACH_THREADS
+	if (getenv ("JACK_EVENT_THREAD")) {
+		if (pipe (client->wake_fds) == 0
+		    && fcntl (client->wake_fds[0], F_SETFL, O_NONBLOCK) == 0
+		    && fcntl (client->wake_fds[1], F_SETFL, O_NONBLOCK) == 0
+		    && pipe (client->done_fds) == 0
+		    && fcntl (client->done_fds[0], F_SETFL, O_NONBLOCK) == 0
+		    && fcntl (client->done_fds[1], F_SETFL, O_NONBLOCK) == 0) {
+			client->separate_events = 1;
+			/* the server need not wake the process thread
+			   for events any more */
+			client->control->events_elsewhere = 1;
+		} else {
+			jack_error ("cannot create process thread wakeup pipe "
+				    "(%s), handling events on the process thread",
+				    strerror (errno));
+		}
+	}
+#endif
+
 #ifdef JACK_USE_MACH_THREADS
 	/* specific resources for server/client real-time thread
 	 * communication */
@@ -1815,18 +2166,179 @@ jack_client_thread_suicide (jack_client_t* client, const char* reason)
 	/*NOTREACHED*/
 }
 
+/* Run whatever the client asked to be run for one event from the
+ * server, and return the status to answer with.
+ */
 static int
-jack_client_process_events (jack_client_t* client)
+jack_client_handle_event (jack_client_t* client, jack_event_t *event,
+			  char *key)
 {
-	jack_event_t event;
-	char status = 0;
 	jack_client_control_t *control = client->control;
 	JSList *node;
 	jack_port_t* port;
+	char status = 0;
+
+	switch (event->type) {
+	case PortRegistered:
+		for (node = client->ports_ext; node; node = jack_slist_next (node)) {
+			port = node->data;
+			if (port->shared->id == event->x.port_id) { // Found port, update port type
+				port->type_info = &client->engine->port_types[port->shared->ptype_id];
+			}
+		}
+		if (control->port_register_cbset) {
+			client->port_register
+				(event->x.port_id, TRUE,
+				client->port_register_arg);
+		}
+		break;
+
+	case PortUnregistered:
+		if (control->port_register_cbset) {
+			client->port_register
+				(event->x.port_id, FALSE,
+				client->port_register_arg);
+		}
+		break;
+
+	case ClientRegistered:
+		if (control->client_register_cbset) {
+			client->client_register
+				(event->x.name, TRUE,
+				client->client_register_arg);
+		}
+		break;
+
+	case ClientUnregistered:
+		if (control->client_register_cbset) {
+			client->client_register
+				(event->x.name, FALSE,
+				client->client_register_arg);
+		}
+		break;
+
+	case GraphReordered:
+#ifndef JACK_USE_MACH_THREADS
+		if (client->separate_events) {
+			status = jack_client_hand_over_reorder (client, event);
+			break;
+		}
+#endif
+		status = jack_handle_reorder (client, event);
+		break;
+
+	case PortConnected:
+	case PortDisconnected:
+		status = jack_client_handle_port_connection
+				 (client, event);
+		break;
+
+	case BufferSizeChange:
+		jack_client_reserve_mix_buffers (client);
+		jack_client_fix_port_buffers (client);
+		if (control->bufsize_cbset) {
+			status = client->bufsize
+					 (client->engine->buffer_size,
+					 client->bufsize_arg);
+		}
+		break;
+
+	case SampleRateChange:
+		if (control->srate_cbset) {
+			status = client->srate
+					 (client->engine->current_time.frame_rate,
+					 client->srate_arg);
+		}
+		break;
+
+	case XRun:
+		if (control->xrun_cbset) {
+			status = client->xrun
+					 (client->xrun_arg);
+		}
+		break;
+
+	case AttachPortSegment:
+		jack_attach_port_segment (client, event->y.ptid);
+		break;
+
+	case StartFreewheel:
+		jack_start_freewheel (client);
+		break;
+
+	case StopFreewheel:
+		jack_stop_freewheel (client);
+		break;
+	case SaveSession:
+		status = jack_client_handle_session_callback (client, event );
+		break;
+	case LatencyCallback:
+		status = jack_client_handle_latency_callback (client, event, 0 );
+		break;
+	case PropertyChange:
+		if (control->property_cbset) {
+			client->property_cb (event->x.uuid, key, event->z.property_change, client->property_cb_arg);
+		}
+		if (key) {
+			free (key);
+		}
+		break;
+	case PortRename:
+		if (control->port_rename_cbset) {
+			client->port_rename_cb (event->y.other_id, event->x.name, event->z.other_name, client->port_rename_arg);
+		}
+		break;
+	case EventsQueued:
+		/* jack_client_process_events() looks after these */
+		break;
+	}
+
+	return status;
+}
+
+/* Handle everything the server has put in our event ring. The tail
+ * is moved as soon as an event is copied out, which also tells the
+ * server that the slot is free; the head is checked once more after
+ * that so that an event added meanwhile is never left behind (see
+ * jack_post_event() in the server).
+ */
+static void
+jack_client_drain_event_ring (jack_client_t* client)
+{
+	jack_client_control_t *control = client->control;
+	jack_event_t event;
+	uint32_t head, tail;
+
+	tail = control->event_tail;
+
+	while ((head = __atomic_load_n (&control->event_head,
+					__ATOMIC_SEQ_CST)) != tail) {
+		while (tail != head) {
+			memcpy (&event,
+				(void*)&control->event_ring[tail & (JACK_EVENT_RING_SIZE - 1)],
+				sizeof(event));
+			__atomic_store_n (&control->event_tail, ++tail,
+					  __ATOMIC_SEQ_CST);
+			DEBUG ("client handles queued event (%s)",
+			       jack_event_type_name (event.type));
+			jack_client_handle_event (client, &event, NULL);
+		}
+	}
+}
+
+static int
+jack_client_process_events (jack_client_t* client)
+{
+	jack_event_t event;
+	char status = 0;
 	char* key = 0;
 
 	DEBUG ("process events");
 
+	/* anything queued was sent before what is on the socket */
+
+	jack_client_drain_event_ring (client);
+
 	if (client->pollfd[EVENT_POLL_INDEX].revents & POLLIN) {
 
 		DEBUG ("client receives an event, "
@@ -1842,6 +2354,12 @@ jack_client_process_events (jack_client_t* client)
 			return -1;
 		}
 
+		if (event.type == EventsQueued) {
+			/* no answer expected */
+			jack_client_drain_event_ring (client);
+			return 0;
+		}
+
 		if (event.type == PropertyChange) {
 			if (event.y.key_size) {
 				key = (char*)malloc (event.y.key_size);
@@ -1854,112 +2372,9 @@ jack_client_process_events (jack_client_t* client)
 			}
 		}
 
-		status = 0;
-
-		switch (event.type) {
-		case PortRegistered:
-			for (node = client->ports_ext; node; node = jack_slist_next (node)) {
-				port = node->data;
-				if (port->shared->id == event.x.port_id) { // Found port, update port type
-					port->type_info = &client->engine->port_types[port->shared->ptype_id];
-				}
-			}
-			if (control->port_register_cbset) {
-				client->port_register
-					(event.x.port_id, TRUE,
-					client->port_register_arg);
-			}
-			break;
-
-		case PortUnregistered:
-			if (control->port_register_cbset) {
-				client->port_register
-					(event.x.port_id, FALSE,
-					client->port_register_arg);
-			}
-			break;
-
-		case ClientRegistered:
-			if (control->client_register_cbset) {
-				client->client_register
-					(event.x.name, TRUE,
-					client->client_register_arg);
-			}
-			break;
-
-		case ClientUnregistered:
-			if (control->client_register_cbset) {
-				client->client_register
-					(event.x.name, FALSE,
-					client->client_register_arg);
-			}
-			break;
-
-		case GraphReordered:
-			status = jack_handle_reorder (client, &event);
-			break;
-
-		case PortConnected:
-		case PortDisconnected:
-			status = jack_client_handle_port_connection
-					 (client, &event);
-			break;
+		jack_client_drain_event_ring (client);
 
-		case BufferSizeChange:
-			jack_client_fix_port_buffers (client);
-			if (control->bufsize_cbset) {
-				status = client->bufsize
-						 (client->engine->buffer_size,
-						 client->bufsize_arg);
-			}
-			break;
-
-		case SampleRateChange:
-			if (control->srate_cbset) {
-				status = client->srate
-						 (client->engine->current_time.frame_rate,
-						 client->srate_arg);
-			}
-			break;
-
-		case XRun:
-			if (control->xrun_cbset) {
-				status = client->xrun
-						 (client->xrun_arg);
-			}
-			break;
-
-		case AttachPortSegment:
-			jack_attach_port_segment (client, event.y.ptid);
-			break;
-
-		case StartFreewheel:
-			jack_start_freewheel (client);
-			break;
-
-		case StopFreewheel:
-			jack_stop_freewheel (client);
-			break;
-		case SaveSession:
-			status = jack_client_handle_session_callback (client, &event );
-			break;
-		case LatencyCallback:
-			status = jack_client_handle_latency_callback (client, &event, 0 );
-			break;
-		case PropertyChange:
-			if (control->property_cbset) {
-				client->property_cb (event.x.uuid, key, event.z.property_change, client->property_cb_arg);
-			}
-			if (key) {
-				free (key);
-			}
-			break;
-		case PortRename:
-			if (control->port_rename_cbset) {
-				client->port_rename_cb (event.y.other_id, event.x.name, event.z.other_name, client->port_rename_arg);
-			}
-			break;
-		}
+		status = jack_client_handle_event (client, &event, key);
 
 		DEBUG ("client has dealt with the event, writing "
 		       "response on event fd");
@@ -1975,7 +2390,6 @@ jack_client_process_events (jack_client_t* client)
 	return 0;
 }
 
-
 static int
 jack_wake_next_client (jack_client_t* client)
 {
@@ -1984,6 +2398,17 @@ jack_wake_next_client (jack_client_t* client)
 	int pret = 0;
 	char c = 0;
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	if (client->wakeup_slot >= 0) {
+		/* our own token was consumed when we woke up */
+		jack_wakeup_signal (&client->engine->wakeup[client->wakeup_slot + 1],
+				    JACK_WAKEUP_GRAPH);
+		DEBUG ("client signalled slot %d by %" PRIu64 "",
+		       client->wakeup_slot + 1, jack_get_microseconds ());
+		return 0;
+	}
+#endif
+
 	if (write_retry (client->graph_next_fd, &c, sizeof(c))
 	    != sizeof(c)) {
 		DEBUG ("cannot write byte to fd %d", client->graph_next_fd);
@@ -2088,11 +2513,168 @@ jack_osx_event_thread_work (void* arg)
 
 #else /* !JACK_USE_MACH_THREADS */
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+
+static int
+jack_client_futex_wait (jack_client_t* client)
+{
+	jack_client_control_t *control = client->control;
+	uint32_t bits;
+
+	DEBUG ("client waiting on wakeup slot %d", client->wakeup_slot);
+
+	/* the slot can change under us if a GraphReordered event
+	   arrives, or go away entirely if the server falls back to
+	   FIFOs, so look it up every time around.
+	 */
+
+	while (client->wakeup_slot >= 0) {
+
+		bits = jack_wakeup_wait (&client->engine->wakeup[client->wakeup_slot],
+					 JACK_WAKEUP_GRAPH | JACK_WAKEUP_EVENT,
+					 1000000);
+
+		pthread_testcancel ();
+
+		if (bits & JACK_WAKEUP_GRAPH) {
+			control->awake_at = jack_get_microseconds ();
+		}
+
+		/* an event bit may be stale if the slot used to
+		   belong to another client, and a timeout is a good
+		   moment to make sure we did not miss anything, so
+		   check the event fd without blocking.
+		 */
+
+		if (bits != JACK_WAKEUP_GRAPH && client->separate_events) {
+			jack_client_take_reorder (client);
+		} else if (bits != JACK_WAKEUP_GRAPH) {
+			client->pollfd[EVENT_POLL_INDEX].revents = 0;
+			if (poll (client->pollfd, 1, 0) < 0 && errno != EINTR) {
+				jack_error ("poll failed in client (%s)",
+					    strerror (errno));
+				return -1;
+			}
+			if (jack_client_process_events (client)) {
+				DEBUG ("event processing failed\n");
+				return 0;
+			}
+			if (control->dead || client->pollfd[EVENT_POLL_INDEX].revents & ~POLLIN) {
+				DEBUG ("client appears dead or event pollfd has error status\n");
+				return -1;
+			}
+		}
+
+		if (!(bits & JACK_WAKEUP_GRAPH)) {
+			continue;
+		}
+
+		DEBUG ("time to run process()\n");
+		return control->dead ? -1 : 0;
+	}
+
+	return 1;
+}
+
+#endif /* JACK_HAVE_FUTEX_WAKEUP */
+
+/* JACK_EVENT_THREAD: wait for the graph only, and for the event thread
+ * handing over a new place in it.
+ */
+static int
+jack_client_graph_wait (jack_client_t* client)
+{
+	jack_client_control_t *control = client->control;
+	struct pollfd pfds[2];
+	int nfds;
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	int ret;
+#endif
+
+	while (1) {
+
+		jack_client_take_reorder (client);
+
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+		if (client->wakeup_slot >= 0) {
+			if ((ret = jack_client_futex_wait (client)) <= 0) {
+				return ret;
+			}
+			continue;
+		}
+#endif
+
+		pfds[0].fd = client->wake_fds[0];
+		pfds[0].events = POLLIN;
+		pfds[0].revents = 0;
+		nfds = 1;
+
+		if (client->graph_wait_fd >= 0) {
+			pfds[1].fd = client->graph_wait_fd;
+			pfds[1].events = POLLIN | POLLERR | POLLHUP | POLLNVAL;
+			pfds[1].revents = 0;
+			nfds = 2;
+		}
+
+		if (poll (pfds, nfds, 1000) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			jack_error ("poll failed in client (%s)",
+				    strerror (errno));
+			return -1;
+		}
+
+		pthread_testcancel ();
+
+		if (control->dead || !client->engine->engine_ok) {
+			return -1;
+		}
+
+		if (nfds < 2) {
+			continue;
+		}
+
+		if (pfds[1].revents & POLLIN) {
+			control->awake_at = jack_get_microseconds ();
+			DEBUG ("time to run process()\n");
+			return 0;
+		}
+
+		if (pfds[1].revents & ~POLLIN) {
+
+			/* upstream went away, see jack_client_core_wait() */
+
+			if (client->upstream_is_jackd) {
+				DEBUG ("WE (%s) DIE\n", client->name);
+				return 0;
+			}
+
+			DEBUG ("WE PUNT\n");
+			client->graph_wait_fd = -1;
+		}
+	}
+}
+
 static int
 jack_client_core_wait (jack_client_t* client)
 {
 	jack_client_control_t *control = client->control;
 
+#ifdef JACK_HAVE_FUTEX_WAKEUP
+	int ret;
+
+	if ((ret = jack_client_futex_wait (client)) <= 0) {
+		return ret;
+	}
+
+	/* no longer chained through a wakeup slot: back to poll(2) */
+#endif
+
+	if (client->separate_events) {
+		return jack_client_graph_wait (client);
+	}
+
 	/* this is not OS X - we're waiting on events & process wakeups */
 
 	DEBUG ("client polling on %s", client->pollmax == 2 ?
@@ -2179,6 +2761,54 @@ jack_client_core_wait (jack_client_t* client)
 
 #endif
 
+#ifndef JACK_USE_MACH_THREADS
+
+static void*
+jack_client_event_thread_work (void* arg)
+{
+	/* JACK_EVENT_THREAD: as on OS X, this is NOT the process()
+	   thread. It only waits for events from the server and runs
+	   their callbacks, so that the process thread never does.
+	 */
+
+	jack_client_t* client = (jack_client_t*)arg;
+	jack_client_control_t *control = client->control;
+
+	if (control->thread_init_cbset) {
+		DEBUG ("calling event thread init callback");
+		client->thread_init (client->thread_init_arg);
+	}
+
+	while (1) {
+		if (poll (&client->pollfd[EVENT_POLL_INDEX], 1, 1000) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			jack_error ("poll failed in client (%s)",
+				    strerror (errno));
+			break;
+		}
+
+		pthread_testcancel ();
+
+		if (jack_client_process_events (client)) {
+			DEBUG ("event processing failed\n");
+			break;
+		}
+
+		if (control->dead || client->pollfd[EVENT_POLL_INDEX].revents & ~POLLIN) {
+			DEBUG ("client appears dead or event pollfd has error status\n");
+			break;
+		}
+	}
+
+	jack_client_thread_suicide (client, "event thread exiting");
+	/*NOTREACHED*/
+	return 0;
+}
+
+#endif /* !JACK_USE_MACH_THREADS */
+
 static void*
 jack_process_thread_work (void* arg)
 {
@@ -2190,6 +2820,11 @@ jack_process_thread_work (void* arg)
 	jack_client_t* client = (jack_client_t*)arg;
 	jack_client_control_t *control = client->control;
 
+	/* mix buffers are released on this thread when connections
+	   change; do the pool's per-thread setup before the first cycle */
+
+	jack_pool_thread_init ();
+
 	/* notify the waiting client that this thread
 	   is up and running.
 	 */
@@ -2387,6 +3022,18 @@ jack_start_thread (jack_client_t *client)
 		return -1;
 	}
 
+	if (client->separate_events) {
+		if (jack_client_create_thread (client,
+					       &client->event_thread,
+					       client->engine->client_priority,
+					       FALSE,
+					       jack_client_event_thread_work,
+					       client)) {
+			return -1;
+		}
+		client->event_thread_ok = TRUE;
+	}
+
 #endif
 
 #ifdef JACK_USE_MACH_THREADS
@@ -2486,6 +3133,8 @@ jack_activate (jack_client_t *client)
 
 startit:
 
+	jack_client_reserve_mix_buffers (client);
+
 	req.type = ActivateClient;
 	jack_uuid_copy (&req.x.client_id, client->control->uuid);
 
@@ -2544,6 +3193,13 @@ jack_client_close_aux (jack_client_t *client)
 		 * server, only if it was actually running
 		 */
 
+#ifndef JACK_USE_MACH_THREADS
+		if (client->event_thread_ok) {
+			pthread_cancel (client->event_thread);
+			pthread_join (client->event_thread, &status);
+		}
+#endif
+
 		if (client->thread_ok) {
 			pthread_cancel (client->thread);
 			pthread_join (client->thread, &status);
@@ -2574,6 +3230,13 @@ jack_client_close_aux (jack_client_t *client)
 		if (client->graph_next_fd >= 0) {
 			close (client->graph_next_fd);
 		}
+
+		if (client->separate_events) {
+			close (client->wake_fds[0]);
+			close (client->wake_fds[1]);
+			close (client->done_fds[0]);
+			close (client->done_fds[1]);
+		}
 #endif
 
 		close (client->event_fd);
@@ -2586,12 +3249,17 @@ jack_client_close_aux (jack_client_t *client)
 
 	}
 
+	jack_trace_detach (client);
+	jack_graph_detach (client);
+	jack_stats_detach (client);
+
 	for (node = client->ports; node; node = jack_slist_next (node))
 		free (node->data);
 	jack_slist_free (client->ports);
 	for (node = client->ports_ext; node; node = jack_slist_next (node))
 		free (node->data);
 	jack_slist_free (client->ports_ext);
+	jack_port_index_free (&client->port_index);
 	jack_client_free (client);
 	jack_messagebuffer_exit ();
 
@@ -2702,6 +3370,83 @@ jack_disconnect (jack_client_t *client, const char *source_port,
 	return jack_client_deliver_request (client, &req);
 }
 
+static int
+jack_connect_batch (jack_client_t *client, const char **sources,
+		    const char **destinations, size_t count, int connect)
+{
+	jack_request_t req;
+	jack_connection_op_t *ops;
+	size_t done, i, n;
+	int failed = 0;
+	int ret;
+
+	if (count == 0) {
+		return 0;
+	}
+
+	n = (count < JACK_CONNECTION_OPS_MAX ? count : JACK_CONNECTION_OPS_MAX);
+
+	if ((ops = (jack_connection_op_t*)
+		   calloc (n, sizeof(jack_connection_op_t))) == NULL) {
+		return -1;
+	}
+
+	/* the server sorts the graph once per request, and applies
+	   each one whole or not at all, so only very large batches
+	   cost more than one sort or can be left half done */
+
+	for (done = 0; done < count; done += n) {
+
+		if (count - done < n) {
+			n = count - done;
+		}
+
+		for (i = 0; i < n; i++) {
+			snprintf (ops[i].source_port,
+				  sizeof(ops[i].source_port), "%s",
+				  sources[done + i]);
+			snprintf (ops[i].destination_port,
+				  sizeof(ops[i].destination_port), "%s",
+				  destinations[done + i]);
+			ops[i].connect = connect;
+		}
+
+		VALGRIND_MEMSET (&req, 0, sizeof(req));
+
+		req.type = ConnectPortsMany;
+		req.x.connections.nops = n;
+		req.x.connections.ops = ops;
+
+		if ((ret = jack_client_deliver_request (client, &req)) < 0) {
+			free (ops);
+			return -1;
+		}
+
+		if (ret) {
+			failed = count - done;
+			break;
+		}
+	}
+
+	free (ops);
+
+	return failed;
+}
+
+int
+jack_connect_many (jack_client_t *client, const char **sources,
+		   const char **destinations, size_t count)
+{
+	return jack_connect_batch (client, sources, destinations, count, 1);
+}
+
+int
+jack_disconnect_many (jack_client_t *client, const char **sources,
+		      const char **destinations, size_t count)
+{
+	return jack_connect_batch (client, sources, destinations, count, 0);
+}
+
 void
 jack_set_error_function (void (*func)(const char *))
 {
@@ -3181,6 +3926,8 @@ jack_event_type_name (JackEventType type)
 		return "property change callback";
 	case PortRename:
 		return "port rename";
+	case EventsQueued:
+		return "events queued";
 	default:
 		break;
 	}
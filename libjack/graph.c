@@ -0,0 +1,184 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "shm.h"
+
+#include "local.h"
+
+/* Reader side of the engine's connection snapshot. The engine never
+ * waits for readers, so a reader that keeps getting overtaken by graph
+ * changes gives up after a few tries and asks the server instead.
+ */
+
+#define JACK_GRAPH_READ_TRIES 8
+
+/* Any thread may be the first to read the snapshot, so attaching is
+ * done under client->attach_lock; otherwise two first readers could
+ * both map the segment and leak one of the mappings.
+ */
+static jack_graph_snapshot_t *
+jack_graph_attach (jack_client_t *client)
+{
+	jack_graph_snapshot_t *graph = NULL;
+
+	pthread_mutex_lock (&client->attach_lock);
+
+	if (client->graph_shm.attached_at) {
+		graph = (jack_graph_snapshot_t*)jack_shm_addr (&client->graph_shm);
+	} else if (client->engine->graph_shm_index != JACK_SHM_NULL_INDEX) {
+		client->graph_shm.index = client->engine->graph_shm_index;
+		if (jack_attach_shm (&client->graph_shm)) {
+			jack_error ("cannot attach connection snapshot shared "
+				    "memory (%s)", strerror (errno));
+			client->graph_shm.attached_at = NULL;
+		} else {
+			graph = (jack_graph_snapshot_t*)
+				jack_shm_addr (&client->graph_shm);
+		}
+	}
+
+	pthread_mutex_unlock (&client->attach_lock);
+
+	return graph;
+}
+
+int
+jack_graph_get_connections (jack_client_t *client, jack_port_id_t port_id,
+			    const char ***ports)
+{
+	jack_graph_snapshot_t *graph;
+	jack_port_id_t *ids = NULL;
+	jack_port_id_t *tmp;
+	const uint32_t *edges;
+	const char **ret;
+	uint32_t generation, first, last, n, i;
+	uint32_t room = 0;
+	int tries;
+
+	if ((graph = jack_graph_attach (client)) == NULL
+	    || port_id >= graph->nports) {
+		return -1;
+	}
+
+	edges = graph->data + graph->nports + 1;
+
+	for (tries = 0; tries < JACK_GRAPH_READ_TRIES; tries++) {
+
+		generation = __atomic_load_n (&graph->generation, __ATOMIC_ACQUIRE);
+
+		if (generation & 1) {
+			continue;
+		}
+
+		if (!graph->complete) {
+			break;
+		}
+
+		first = graph->data[port_id];
+		last = graph->data[port_id + 1];
+
+		if (last < first || last > graph->max_edges) {
+			/* torn read, check the generation */
+			n = 0;
+		} else {
+			n = last - first;
+		}
+
+		if (n > room) {
+			if ((tmp = (jack_port_id_t*)realloc (ids, sizeof(jack_port_id_t) * n)) == NULL) {
+				break;
+			}
+			ids = tmp;
+			room = n;
+		}
+
+		for (i = 0; i < n; i++) {
+			ids[i] = edges[first + i];
+		}
+
+		__atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+		if (__atomic_load_n (&graph->generation, __ATOMIC_RELAXED)
+		    != generation) {
+			continue;
+		}
+
+		if (n == 0) {
+			free (ids);
+			*ports = NULL;
+			return 0;
+		}
+
+		if ((ret = (const char**)malloc (sizeof(char *) * (n + 1))) == NULL) {
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (ids[i] >= client->engine->port_max) {
+				free (ret);
+				goto out;
+			}
+			ret[i] = client->engine->ports[ids[i]].name;
+		}
+		ret[n] = NULL;
+
+		free (ids);
+		*ports = ret;
+		return 0;
+	}
+
+out:
+	free (ids);
+	return -1;
+}
+
+int
+jack_get_connection_generation (jack_client_t *client, uint32_t *generation)
+{
+	jack_graph_snapshot_t *graph;
+	uint32_t g;
+
+	if ((graph = jack_graph_attach (client)) == NULL) {
+		return -1;
+	}
+
+	/* an odd generation is a snapshot being written: report the
+	   one it will become */
+	g = __atomic_load_n (&graph->generation, __ATOMIC_ACQUIRE);
+	*generation = (g + 1) & ~1U;
+
+	return 0;
+}
+
+void
+jack_graph_detach (jack_client_t *client)
+{
+	pthread_mutex_lock (&client->attach_lock);
+	if (client->graph_shm.attached_at) {
+		jack_release_shm (&client->graph_shm);
+		client->graph_shm.attached_at = NULL;
+	}
+	pthread_mutex_unlock (&client->attach_lock);
+}
@@ -1,6 +1,9 @@
 #ifndef __jack_libjack_local_h__
 #define __jack_libjack_local_h__
 
+#include "portindex.h"
+#include "pool.h"
+
 /* Client data structure, in the client address space. */
 struct _jack_client {
 
@@ -8,12 +11,39 @@ struct _jack_client {
 	jack_client_control_t *control;
 	jack_shm_info_t engine_shm;
 	jack_shm_info_t control_shm;
+	jack_shm_info_t trace_shm;      /* attached on first use */
+	jack_shm_info_t graph_shm;      /* attached on first use */
+	jack_shm_info_t stats_shm;      /* attached on first use */
+	pthread_mutex_t attach_lock;    /* ... under this lock */
 
 	struct pollfd*  pollfd;
 	int pollmax;
 	int graph_next_fd;
 	int request_fd;
 	int upstream_is_jackd;
+	int wakeup_slot;        /* futex graph wakeups: slot we wait on, or -1 */
+	int graph_slot;         /* FIFO we wait on, or -1 */
+
+	/* requests through control->request_ring, see internal.h */
+	int shm_requests;
+	pthread_mutex_t request_lock;   /* serializes writers of request_head */
+	pthread_cond_t request_free;    /* a slot's reply has been collected */
+	char request_busy[JACK_REQUEST_RING_SIZE];
+
+	/* JACK_EVENT_THREAD: events are handled by event_thread, and the
+	   process thread only waits for the graph. It owns the graph
+	   FIFOs and wakeup slot, so the event thread hands GraphReordered
+	   over to it, waking it through wake_fds or the wakeup slot, and
+	   waits on done_fds for it to finish.
+	 */
+	int separate_events;
+	pthread_t event_thread;
+	int event_thread_ok;
+	int wake_fds[2];
+	int done_fds[2];
+	jack_event_t reorder_event;
+	int reorder_status;
+	volatile int reorder_pending;
 
 	/* these two are copied from the engine when the
 	 * client is created.
@@ -24,6 +54,10 @@ struct _jack_client {
 
 	JSList *ports;
 	JSList *ports_ext;
+	jack_port_index_t port_index;   /* built on first lookup by name */
+	uint32_t port_index_generation; /* engine->port_generation it matches */
+	pthread_mutex_t port_index_lock;
+	unsigned int mix_reserved[JACK_POOL_CLASSES]; /* mix buffers set aside */
 
 	pthread_t thread;
 	char fifo_prefix[PATH_MAX + 1];
@@ -94,6 +128,8 @@ extern int jack_client_deliver_request(const jack_client_t *client,
 extern jack_port_t *jack_port_new(const jack_client_t *client,
 				  jack_port_id_t port_id,
 				  jack_control_t *control);
+extern void jack_port_mixdown_changed(jack_client_t *client,
+				      jack_port_t *port);
 
 extern void *jack_zero_filled_buffer;
 
@@ -0,0 +1,267 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    midi_bench -- time the MIDI input merge
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+ */
+
+/* midiport.c is built into this program directly. An input port with
+   a number of MIDI connections is mixed down two ways: with the heap
+   merge that jack_midi_port_mixdown() uses, and with the scan over
+   every connection per event that it replaced and still falls back
+   to. Every source carries the same number of three byte events at
+   random times in the period, so many of them share a timestamp, and
+   one in eight is a sysex message long enough to be stored out of
+   line. The two results are compared event by event, and the time per
+   mixdown, best of a few runs, is printed for each. The port buffers
+   are made large enough to hold every merged event, which with the
+   denser cases is more than jackd's default of 2048 bytes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "midiport.c"
+
+#define BENCH_FRAMES     1024
+#define BENCH_EVENTS     (1024 * 1024)      /* merged events per run */
+#define BENCH_RUNS       5                  /* best of */
+#define BENCH_SYSEX      16                 /* bytes, stored out of line */
+
+typedef struct {
+	int nsrcs;
+	int nevents;                    /* per source */
+	size_t buffer_size;
+	char *segment;
+	void *segment_base;             /* what the ports point at */
+	jack_port_shared_t *shared;
+	jack_port_t *srcs;
+	jack_port_t port;
+} bench_merge_t;
+
+static const int source_counts[] = { 2, 8, 32, 64 };
+static const int event_counts[] = { 4, 16, 64 };
+
+#define NCASES(a) (sizeof(a) / sizeof(a[0]))
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+compare_time (const void *a, const void *b)
+{
+	jack_nframes_t x = *(const jack_nframes_t*)a;
+	jack_nframes_t y = *(const jack_nframes_t*)b;
+
+	return (x > y) - (x < y);
+}
+
+static void *
+bench_alloc (size_t size)
+{
+	void *ptr;
+
+	if ((ptr = calloc (1, size)) == NULL) {
+		fprintf (stderr, "midi_bench: out of memory\n");
+		exit (1);
+	}
+
+	return ptr;
+}
+
+static void
+bench_build (bench_merge_t *m, int nsrcs, int nevents)
+{
+	jack_midi_data_t data[BENCH_SYSEX];
+	jack_nframes_t *times;
+	void *buffer;
+	int s, e;
+
+	m->nsrcs = nsrcs;
+	m->nevents = nevents;
+
+	/* room for every merged event, and at least what jackd gives */
+	m->buffer_size = sizeof(jack_midi_port_info_private_t)
+			 + (size_t)nsrcs * nevents
+			 * (sizeof(jack_midi_port_internal_event_t) + BENCH_SYSEX);
+	if (m->buffer_size < 2048) {
+		m->buffer_size = 2048;
+	}
+
+	m->segment = (char*)bench_alloc (nsrcs * m->buffer_size);
+	m->segment_base = m->segment;
+	m->shared = (jack_port_shared_t*)
+		    bench_alloc (nsrcs * sizeof(jack_port_shared_t));
+	m->srcs = (jack_port_t*)bench_alloc (nsrcs * sizeof(jack_port_t));
+	times = (jack_nframes_t*)bench_alloc (nevents * sizeof(jack_nframes_t));
+
+	memset (&m->port, 0, sizeof(m->port));
+	m->port.mix_buffer = bench_alloc (m->buffer_size);
+	jack_midi_buffer_init (m->port.mix_buffer, m->buffer_size,
+			       BENCH_FRAMES);
+
+	for (s = 0; s < nsrcs; s++) {
+		m->shared[s].offset = s * m->buffer_size;
+		m->srcs[s].shared = &m->shared[s];
+		m->srcs[s].client_segment_base = &m->segment_base;
+
+		buffer = jack_output_port_buffer (&m->srcs[s]);
+		jack_midi_buffer_init (buffer, m->buffer_size, BENCH_FRAMES);
+
+		for (e = 0; e < nevents; e++) {
+			times[e] = rand () % BENCH_FRAMES;
+		}
+		qsort (times, nevents, sizeof(jack_nframes_t), compare_time);
+
+		for (e = 0; e < nevents; e++) {
+			data[0] = 0x90 | (s & 0xf);
+			data[1] = e & 0x7f;
+			data[2] = 0x40;
+			if (e % 8 == 7) {
+				memset (data, e & 0x7f, sizeof(data));
+				data[0] = 0xf0;
+				data[BENCH_SYSEX - 1] = 0xf7;
+			}
+			if (jack_midi_event_write (buffer, times[e], data,
+						   (e % 8 == 7) ? BENCH_SYSEX : 3)) {
+				fprintf (stderr, "midi_bench: source buffer "
+					 "too small\n");
+				exit (1);
+			}
+		}
+
+		m->port.connections = jack_slist_append (m->port.connections,
+							 &m->srcs[s]);
+	}
+
+	free (times);
+}
+
+static void
+bench_free (bench_merge_t *m)
+{
+	jack_slist_free (m->port.connections);
+	free (m->port.mix_buffer);
+	free (m->srcs);
+	free (m->shared);
+	free (m->segment);
+}
+
+/* a copy of what the merge wrote, to hold the other one against */
+static jack_midi_data_t *
+bench_result (bench_merge_t *m)
+{
+	jack_midi_data_t *copy;
+	jack_midi_event_t event;
+	size_t pos = 0;
+	uint32_t n, count = jack_midi_get_event_count (m->port.mix_buffer);
+
+	copy = (jack_midi_data_t*)bench_alloc (m->buffer_size);
+
+	for (n = 0; n < count; n++) {
+		if (jack_midi_event_get (&event, m->port.mix_buffer, n)) {
+			break;
+		}
+		memcpy (copy + pos, &event.time, sizeof(event.time));
+		pos += sizeof(event.time);
+		memcpy (copy + pos, event.buffer, event.size);
+		pos += event.size;
+	}
+
+	return copy;
+}
+
+/* usecs per mixdown, best of a few runs */
+static double
+bench_run (bench_merge_t *m,
+	   void (*mixdown)(jack_port_t *, jack_nframes_t))
+{
+	double start, elapsed, best = 0.0;
+	int r, i, mixdowns = BENCH_EVENTS / (m->nsrcs * m->nevents);
+
+	/* warm the caches first */
+	mixdown (&m->port, BENCH_FRAMES);
+
+	for (r = 0; r < BENCH_RUNS; r++) {
+		start = now ();
+		for (i = 0; i < mixdowns; i++) {
+			mixdown (&m->port, BENCH_FRAMES);
+		}
+		elapsed = now () - start;
+		if (best == 0.0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	return best / mixdowns;
+}
+
+int
+main (int argc, char *argv[])
+{
+	bench_merge_t m;
+	jack_midi_data_t *merged, *scanned;
+	double heap, scan;
+	size_t s, e;
+	int bad = 0;
+
+	printf ("%d frames per cycle, one event in 8 a %d byte sysex\n",
+		BENCH_FRAMES, BENCH_SYSEX);
+	printf ("%5s %7s %12s %12s %7s\n", "srcs", "events",
+		"scan usecs", "heap usecs", "ratio");
+
+	for (s = 0; s < NCASES (source_counts); s++) {
+		for (e = 0; e < NCASES (event_counts); e++) {
+			srand (source_counts[s] * 1000 + event_counts[e]);
+			bench_build (&m, source_counts[s], event_counts[e]);
+
+			jack_midi_port_mixdown (&m.port, BENCH_FRAMES);
+			merged = bench_result (&m);
+			jack_midi_port_mixdown_scan (&m.port, BENCH_FRAMES);
+			scanned = bench_result (&m);
+			if (memcmp (merged, scanned, m.buffer_size)
+			    || jack_midi_get_event_count (m.port.mix_buffer)
+			    != (uint32_t)(m.nsrcs * m.nevents)) {
+				bad = 1;
+			}
+			free (merged);
+			free (scanned);
+
+			scan = bench_run (&m, jack_midi_port_mixdown_scan);
+			heap = bench_run (&m, jack_midi_port_mixdown);
+			printf ("%5d %7d %12.2f %12.2f %7.2f\n",
+				source_counts[s],
+				source_counts[s] * event_counts[e],
+				scan, heap, scan / heap);
+
+			bench_free (&m);
+		}
+	}
+
+	if (bad) {
+		printf ("midi_bench: the heap merge and the scan "
+			"disagree\n");
+	}
+
+	return bad;
+}
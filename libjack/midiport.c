@@ -227,9 +227,10 @@ jack_midi_clear_buffer (void           *port_buffer)
 }
 
 
-/* jack_midi_port_functions.mixdown */
+/* Fallback for ports with more busy inputs than the merge heap holds:
+ * pick the earliest event by scanning every connection each time. */
 static void
-jack_midi_port_mixdown (jack_port_t    *port, jack_nframes_t nframes)
+jack_midi_port_mixdown_scan (jack_port_t    *port, jack_nframes_t nframes)
 {
 	JSList         *node;
 	jack_port_t    *input;
@@ -321,6 +322,165 @@ jack_midi_port_mixdown (jack_port_t    *port, jack_nframes_t nframes)
 }
 
 
+/* One input of the k-way merge below. */
+typedef struct _jack_midi_merge_source {
+	jack_midi_port_internal_event_t *event; /* next unread event */
+	jack_midi_port_internal_event_t *end;
+	jack_midi_data_t *buffer;               /* port buffer it lives in */
+	uint32_t order;                         /* connection index, breaks ties */
+} jack_midi_merge_source_t;
+
+enum { MIDI_MERGE_MAX = 64 };
+
+static inline int
+jack_midi_merge_before (const jack_midi_merge_source_t *a,
+			const jack_midi_merge_source_t *b)
+{
+	/* events at the same time keep connection order, as the scan
+	 * did */
+	return a->event->time < b->event->time
+	       || (a->event->time == b->event->time && a->order < b->order);
+}
+
+static void
+jack_midi_merge_sift_down (jack_midi_merge_source_t *heap, int n, int i)
+{
+	jack_midi_merge_source_t tmp = heap[i];
+	int child;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n
+		    && jack_midi_merge_before (&heap[child + 1], &heap[child])) {
+			child++;
+		}
+		if (!jack_midi_merge_before (&heap[child], &tmp)) {
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+
+	heap[i] = tmp;
+}
+
+/* jack_midi_port_functions.mixdown */
+static void
+jack_midi_port_mixdown (jack_port_t    *port, jack_nframes_t nframes)
+{
+	jack_midi_merge_source_t heap[MIDI_MERGE_MAX];
+	jack_midi_port_info_private_t *in_info;
+	jack_midi_port_info_private_t *out_info;
+	jack_midi_port_internal_event_t *out_events;
+	jack_midi_port_internal_event_t *event;
+	jack_midi_data_t *out_buffer;
+	JSList *node;
+	size_t data_bytes = 0;
+	size_t needed;
+	uint32_t num_events = 0;
+	uint32_t lost_events = 0;
+	uint32_t order = 0;
+	uint32_t i;
+	int nheap = 0;
+	int fits;
+
+	for (node = port->connections; node; node = jack_slist_next (node)) {
+
+		in_info = (jack_midi_port_info_private_t*)
+			  jack_output_port_buffer ((jack_port_t*)node->data);
+		lost_events += in_info->events_lost;
+
+		if (in_info->event_count == 0) {
+			order++;
+			continue;
+		}
+
+		if (nheap == MIDI_MERGE_MAX) {
+			jack_midi_port_mixdown_scan (port, nframes);
+			return;
+		}
+
+		heap[nheap].event = (jack_midi_port_internal_event_t*)(in_info + 1);
+		heap[nheap].end = heap[nheap].event + in_info->event_count;
+		heap[nheap].buffer = (jack_midi_data_t*)in_info;
+		heap[nheap].order = order++;
+		nheap++;
+
+		num_events += in_info->event_count;
+
+		/* out-of-line data. last_write_loc would tell us, but
+		 * the scan fallback smashes it, so count for ourselves */
+		for (event = heap[nheap - 1].event; event < heap[nheap - 1].end;
+		     event++) {
+			if (event->size > MIDI_INLINE_MAX) {
+				data_bytes += event->size;
+			}
+		}
+	}
+
+	jack_midi_clear_buffer (port->mix_buffer);
+
+	out_info = (jack_midi_port_info_private_t*)port->mix_buffer;
+	out_events = (jack_midi_port_internal_event_t*)(out_info + 1);
+	out_buffer = (jack_midi_data_t*)port->mix_buffer;
+
+	/* reserve everything at once: if it all fits, every per-event
+	 * check jack_midi_event_reserve() would make is known to pass
+	 * (sources were checked against the same nframes when they
+	 * were written, and the merge keeps times in order) */
+	needed = sizeof(jack_midi_port_info_private_t) + data_bytes
+		 + (size_t)num_events * sizeof(jack_midi_port_internal_event_t);
+	fits = (needed <= out_info->buffer_size);
+
+	for (i = nheap / 2; i-- > 0; ) {
+		jack_midi_merge_sift_down (heap, nheap, i);
+	}
+
+	for (i = 0; i < num_events; ++i) {
+
+		event = heap[0].event;
+
+		if (fits) {
+			jack_midi_port_internal_event_t *out =
+				&out_events[out_info->event_count++];
+
+			out->time = event->time;
+			out->size = event->size;
+
+			if (event->size <= MIDI_INLINE_MAX) {
+				memcpy (out->inline_data, event->inline_data,
+					MIDI_INLINE_MAX);
+			} else {
+				out_info->last_write_loc += event->size;
+				out->byte_offset = out_info->buffer_size - 1
+						   - out_info->last_write_loc;
+				memcpy (out_buffer + out->byte_offset,
+					heap[0].buffer + event->byte_offset,
+					event->size);
+			}
+
+		} else if (jack_midi_event_write (
+				   port->mix_buffer, event->time,
+				   jack_midi_event_data (heap[0].buffer, event),
+				   event->size)) {
+			out_info->events_lost = num_events - i;
+			break;
+		}
+
+		if (++heap[0].event == heap[0].end) {
+			heap[0] = heap[--nheap];
+		}
+		if (nheap > 1) {
+			jack_midi_merge_sift_down (heap, nheap, 0);
+		}
+	}
+
+	assert (out_info->event_count == num_events - out_info->events_lost);
+
+	// inherit total lost events count from all connected ports.
+	out_info->events_lost += lost_events;
+}
+
+
 uint32_t
 jack_midi_get_lost_event_count (void           *port_buffer)
 {
@@ -0,0 +1,232 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    mix_bench -- time the SIMD mixdown kernels
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+ */
+
+/* simd.c is built into this program directly. For every instruction
+   set this CPU has, an input port's mixdown is made two ways: the
+   pairwise way, copying the first source and adding the others one
+   at a time, which reads and writes the mix buffer once per source,
+   and with the set's mixnf() kernel, which writes it once. Every port
+   has buffers of its own, so with many ports the working set no
+   longer fits in the cache. The rate at which source samples are
+   consumed, best of a few runs, is printed for each. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "simd.c"
+
+#define BENCH_MAX_PORTS  64
+#define BENCH_MAX_SRCS   8
+#define BENCH_FRAMES     1024
+#define BENCH_SAMPLES    (32 * 1024 * 1024)  /* source samples per run */
+#define BENCH_RUNS       5                   /* best of */
+
+#ifdef USE_DYNSIMD
+
+typedef void (*copyf_t)(float *, const float *, int);
+typedef void (*add2f_t)(float *, const float *, int);
+typedef void (*mixnf_t)(float *, const float * const *, int, int);
+
+typedef struct {
+	const char *name;
+	copyf_t copyf;
+	add2f_t add2f;
+	mixnf_t mixnf;
+} bench_isa_t;
+
+typedef struct {
+	const float *srcs[BENCH_MAX_SRCS];
+	float *mix;
+} bench_port_t;
+
+static const int port_counts[] = { 1, 64 };
+static const int source_counts[] = { 2, 4, 8 };
+
+#define NCASES(a) (sizeof(a) / sizeof(a[0]))
+
+static bench_port_t ports[BENCH_MAX_PORTS];
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+pairwise (const bench_isa_t *isa, int nports, int nsrcs)
+{
+	int p, k;
+
+	for (p = 0; p < nports; p++) {
+		isa->copyf (ports[p].mix, ports[p].srcs[0], BENCH_FRAMES);
+		for (k = 1; k < nsrcs; k++) {
+			isa->add2f (ports[p].mix, ports[p].srcs[k],
+				    BENCH_FRAMES);
+		}
+	}
+}
+
+static void
+mixn (const bench_isa_t *isa, int nports, int nsrcs)
+{
+	int p;
+
+	for (p = 0; p < nports; p++) {
+		isa->mixnf (ports[p].mix, ports[p].srcs, nsrcs, BENCH_FRAMES);
+	}
+}
+
+static double
+run (void (*fn)(const bench_isa_t *, int, int), const bench_isa_t *isa,
+     int nports, int nsrcs)
+{
+	unsigned long i, cycles = BENCH_SAMPLES / (nports * nsrcs * BENCH_FRAMES);
+	double start, best = 0.0;
+	int r;
+
+	/* warm the caches first */
+	fn (isa, nports, nsrcs);
+
+	/* the fastest run is the one least disturbed by anything else */
+	for (r = 0; r < BENCH_RUNS; r++) {
+		start = now ();
+		for (i = 0; i < cycles; i++) {
+			fn (isa, nports, nsrcs);
+		}
+		start = now () - start;
+		if (best == 0.0 || start < best) {
+			best = start;
+		}
+	}
+
+	/* million source samples consumed per second */
+	return (double)cycles * nports * nsrcs * BENCH_FRAMES / best / 1e6;
+}
+
+static float *
+bench_buffer (int random)
+{
+	void *buf;
+	int j;
+
+	/* the SSE copy and add use aligned loads */
+	if (posix_memalign (&buf, 64, BENCH_FRAMES * sizeof(float))) {
+		fprintf (stderr, "mix_bench: out of memory\n");
+		exit (1);
+	}
+
+	for (j = 0; j < BENCH_FRAMES; j++) {
+		((float*)buf)[j] = random ?
+				   ((float) rand () / RAND_MAX - 0.5f) * 0.5f : 0.0f;
+	}
+
+	return (float*)buf;
+}
+
+int
+main (int argc, char *argv[])
+{
+	bench_isa_t isas[3];
+	int nisas = 0;
+	double two, one;
+	size_t i, p, s;
+	int k;
+
+#ifdef ARCH_X86
+	if (ARCH_X86_HAVE_SSE2 (have_sse ())) {
+		isas[nisas].name = "sse";
+		isas[nisas].copyf = x86_sse_copyf;
+		isas[nisas].add2f = x86_sse_add2f;
+		isas[nisas].mixnf = x86_sse_mixnf;
+		nisas++;
+	}
+	if (have_avx () >= 1) {
+		isas[nisas].name = "avx2";
+		isas[nisas].copyf = x86_avx2_copyf;
+		isas[nisas].add2f = x86_avx2_add2f;
+		isas[nisas].mixnf = x86_avx2_mixnf;
+		nisas++;
+	}
+	if (have_avx () >= 2) {
+		isas[nisas].name = "avx512";
+		isas[nisas].copyf = x86_avx512_copyf;
+		isas[nisas].add2f = x86_avx512_add2f;
+		isas[nisas].mixnf = x86_avx512_mixnf;
+		nisas++;
+	}
+#endif /* ARCH_X86 */
+#ifdef ARCH_ARM64
+	if (have_neon ()) {
+		isas[nisas].name = "neon";
+		isas[nisas].copyf = arm64_neon_copyf;
+		isas[nisas].add2f = arm64_neon_add2f;
+		isas[nisas].mixnf = arm64_neon_mixnf;
+		nisas++;
+	}
+#endif /* ARCH_ARM64 */
+
+	if (nisas == 0) {
+		printf ("mix_bench: no SIMD kernels for this CPU\n");
+		return 0;
+	}
+
+	for (p = 0; p < BENCH_MAX_PORTS; p++) {
+		for (k = 0; k < BENCH_MAX_SRCS; k++) {
+			ports[p].srcs[k] = bench_buffer (1);
+		}
+		ports[p].mix = bench_buffer (0);
+	}
+
+	printf ("%d frames per cycle\n", BENCH_FRAMES);
+	printf ("%-7s %5s %5s %14s %12s %7s\n", "isa", "ports", "srcs",
+		"pairwise Ms/s", "mixnf Ms/s", "ratio");
+
+	for (i = 0; i < (size_t)nisas; i++) {
+		for (p = 0; p < NCASES (port_counts); p++) {
+			for (s = 0; s < NCASES (source_counts); s++) {
+				two = run (pairwise, &isas[i], port_counts[p],
+					   source_counts[s]);
+				one = run (mixn, &isas[i], port_counts[p],
+					   source_counts[s]);
+				printf ("%-7s %5d %5d %14.1f %12.1f %7.2f\n",
+					isas[i].name, port_counts[p],
+					source_counts[s], two, one, one / two);
+			}
+		}
+	}
+
+	return 0;
+}
+
+#else /* !USE_DYNSIMD */
+
+int
+main (int argc, char *argv[])
+{
+	printf ("mix_bench: built without --enable-dynsimd, nothing to time\n");
+	return 0;
+}
+
+#endif /* USE_DYNSIMD */
@@ -22,26 +22,328 @@
 #ifdef HAVE_POSIX_MEMALIGN
 #define _XOPEN_SOURCE 600
 #endif
+#define _DEFAULT_SOURCE         /* MAP_ANONYMOUS, MAP_NORESERVE */
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <config.h>
 
 #include "pool.h"
 
-/* XXX need RT-pool based allocator here */
+/* The pool is one address space reservation, committed and locked a
+ * piece at a time by jack_pool_reserve(). Every block carries a
+ * JACK_POOL_MIN_BLOCK sized header in front of it, which keeps user
+ * pointers 64-byte aligned and records the size class and free list
+ * link. Blocks are named by their offset into the arena in units of
+ * JACK_POOL_MIN_BLOCK, so a free list head fits in 64 bits together
+ * with a tag that is bumped on every change to defeat ABA.
+ *
+ * Each thread keeps a few blocks per class to itself so that the
+ * common alloc/release pattern of a process() callback does not touch
+ * the shared lists at all. Nothing on the alloc/release path makes a
+ * system call unless the pool misses.
+ */
+
+#define JACK_POOL_ARENA_SIZE    (256UL * 1024 * 1024)
+#define JACK_POOL_CACHE         8
+#define JACK_POOL_MAGIC         0x6a61636b
+#define JACK_POOL_NOT_POOLED    (-1)
+
+typedef struct {
+	uint32_t next;          /* unit index + 1 of next free block, 0 = none */
+	int32_t  cls;           /* size class, or JACK_POOL_NOT_POOLED */
+	uint32_t magic;
+} jack_pool_header_t;
+
+typedef struct {
+	unsigned int count[JACK_POOL_CLASSES];
+	void *blocks[JACK_POOL_CLASSES][JACK_POOL_CACHE];
+	int registered;
+} jack_pool_cache_t;
+
+static char *arena = NULL;
+static size_t arena_used = 0;           /* protected by reserve_lock */
+static pthread_mutex_t reserve_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static volatile uint64_t free_list[JACK_POOL_CLASSES];
+static jack_pool_stats_t stats;
+
+static __thread jack_pool_cache_t cache;
+
+static inline jack_pool_header_t *
+jack_pool_header (void *ptr)
+{
+	return (jack_pool_header_t*)((char*)ptr - JACK_POOL_MIN_BLOCK);
+}
+
+int
+jack_pool_size_class (size_t bytes)
+{
+	int cls = 0;
+	size_t size = JACK_POOL_MIN_BLOCK;
+
+	if (bytes > JACK_POOL_MAX_BLOCK) {
+		return -1;
+	}
+
+	while (size < bytes) {
+		size <<= 1;
+		cls++;
+	}
+
+	return cls;
+}
+
+static inline uint32_t
+jack_pool_unit (void *ptr)
+{
+	return (uint32_t)(((char*)ptr - arena) / JACK_POOL_MIN_BLOCK) + 1;
+}
+
+static inline void *
+jack_pool_block (uint32_t unit)
+{
+	return arena + (size_t)(unit - 1) * JACK_POOL_MIN_BLOCK;
+}
+
+static void
+jack_pool_push (int cls, void *ptr)
+{
+	jack_pool_header_t *hdr = jack_pool_header (ptr);
+	uint32_t unit = jack_pool_unit (ptr);
+	uint64_t head, next;
+
+	head = __atomic_load_n (&free_list[cls], __ATOMIC_RELAXED);
+
+	do {
+		hdr->next = (uint32_t)head;
+		next = ((head >> 32) + 1) << 32 | unit;
+	} while (!__atomic_compare_exchange_n (&free_list[cls], &head, next, 1,
+					       __ATOMIC_RELEASE,
+					       __ATOMIC_RELAXED));
+
+	__atomic_fetch_add (&stats.free_blocks[cls], 1, __ATOMIC_RELAXED);
+}
+
+static void *
+jack_pool_pop (int cls)
+{
+	uint64_t head, next;
+	void *ptr;
+
+	head = __atomic_load_n (&free_list[cls], __ATOMIC_ACQUIRE);
+
+	do {
+		if ((uint32_t)head == 0) {
+			return NULL;
+		}
+		ptr = jack_pool_block ((uint32_t)head);
+		/* the arena is never unmapped, so this read is safe even
+		   if somebody else pops the block first; the tag makes
+		   the CAS fail in that case */
+		next = ((head >> 32) + 1) << 32
+		       | jack_pool_header (ptr)->next;
+	} while (!__atomic_compare_exchange_n (&free_list[cls], &head, next, 1,
+					       __ATOMIC_ACQUIRE,
+					       __ATOMIC_ACQUIRE));
+
+	__atomic_fetch_sub (&stats.free_blocks[cls], 1, __ATOMIC_RELAXED);
+
+	return ptr;
+}
+
+static void
+jack_pool_flush_cache (void *arg)
+{
+	jack_pool_cache_t *c = (jack_pool_cache_t*)arg;
+	int cls;
+
+	for (cls = 0; cls < JACK_POOL_CLASSES; cls++) {
+		while (c->count[cls]) {
+			jack_pool_push (cls, c->blocks[cls][--c->count[cls]]);
+		}
+	}
+}
+
+static void
+jack_pool_make_key ()
+{
+	pthread_key_create (&cache_key, jack_pool_flush_cache);
+}
+
+/* Arrange for this thread's cache to be handed back to the shared
+ * lists when the thread exits. pthread_once() and pthread_setspecific()
+ * may lock or allocate, so threads that release blocks from a realtime
+ * context call this before they start, rather than leaving it to their
+ * first jack_pool_release().
+ */
+void
+jack_pool_thread_init ()
+{
+	if (cache.registered) {
+		return;
+	}
+
+	pthread_once (&key_once, jack_pool_make_key);
+	pthread_setspecific (cache_key, &cache);
+	cache.registered = 1;
+}
+
+int
+jack_pool_reserve (size_t bytes, unsigned int count)
+{
+	jack_pool_header_t *hdr;
+	size_t block, need;
+	char *chunk;
+	int cls;
+	unsigned int i;
+
+	if ((cls = jack_pool_size_class (bytes)) < 0) {
+		return -1;
+	}
+
+	block = ((size_t)JACK_POOL_MIN_BLOCK << cls) + JACK_POOL_MIN_BLOCK;
+	need = block * count;
+
+	pthread_mutex_lock (&reserve_lock);
+
+	if (arena == NULL) {
+		arena = mmap (NULL, JACK_POOL_ARENA_SIZE, PROT_NONE,
+			      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+			      -1, 0);
+		if (arena == MAP_FAILED) {
+			arena = NULL;
+			pthread_mutex_unlock (&reserve_lock);
+			return -1;
+		}
+	}
+
+	if (arena_used + need > JACK_POOL_ARENA_SIZE) {
+		pthread_mutex_unlock (&reserve_lock);
+		return -1;
+	}
+
+	chunk = arena + arena_used;
+
+	if (mprotect (chunk, need, PROT_READ | PROT_WRITE)) {
+		pthread_mutex_unlock (&reserve_lock);
+		return -1;
+	}
+
+	/* failing to lock is not fatal: the memory still works, it
+	   just may page fault the first time it is touched */
+	if (mlock (chunk, need) == 0) {
+		stats.locked_bytes += need;
+	} else {
+		memset (chunk, 0, need);
+	}
+
+	arena_used += need;
+	stats.reserved_bytes += need;
+
+	pthread_mutex_unlock (&reserve_lock);
+
+	for (i = 0; i < count; i++) {
+		hdr = (jack_pool_header_t*)(chunk + i * block);
+		hdr->cls = cls;
+		hdr->magic = JACK_POOL_MAGIC;
+		jack_pool_push (cls, (char*)hdr + JACK_POOL_MIN_BLOCK);
+	}
+
+	return 0;
+}
+
 void *
 jack_pool_alloc (size_t bytes)
 {
+	jack_pool_header_t *hdr;
+	void *ptr = NULL;
+	void *m;
+	int cls;
+
+	__atomic_fetch_add (&stats.allocs, 1, __ATOMIC_RELAXED);
+
+	if ((cls = jack_pool_size_class (bytes)) >= 0) {
+		if (cache.count[cls]) {
+			return cache.blocks[cls][--cache.count[cls]];
+		}
+		if ((ptr = jack_pool_pop (cls)) != NULL) {
+			return ptr;
+		}
+	}
+
+	/* not RT safe from here on */
+
+	__atomic_fetch_add (&stats.misses, 1, __ATOMIC_RELAXED);
+
 #ifdef HAVE_POSIX_MEMALIGN
-	void* m;
-	int err = posix_memalign (&m, 64, bytes);
-	return (!err) ? m : 0;
+	if (posix_memalign (&m, 64, bytes + JACK_POOL_MIN_BLOCK)) {
+		return 0;
+	}
 #else
-	return malloc (bytes);
+	if ((m = malloc (bytes + JACK_POOL_MIN_BLOCK)) == NULL) {
+		return 0;
+	}
 #endif  /* HAVE_POSIX_MEMALIGN */
+
+	hdr = (jack_pool_header_t*)m;
+	hdr->cls = JACK_POOL_NOT_POOLED;
+	hdr->magic = JACK_POOL_MAGIC;
+
+	return (char*)m + JACK_POOL_MIN_BLOCK;
 }
 
 void
 jack_pool_release (void *ptr)
 {
-	free (ptr);
+	jack_pool_header_t *hdr;
+	int cls;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	__atomic_fetch_add (&stats.releases, 1, __ATOMIC_RELAXED);
+
+	hdr = jack_pool_header (ptr);
+	cls = hdr->cls;
+
+	if (cls == JACK_POOL_NOT_POOLED) {
+		free (hdr);
+		return;
+	}
+
+	if (!cache.registered) {
+		/* not RT safe; threads that release from a realtime
+		   context call jack_pool_thread_init() first */
+		jack_pool_thread_init ();
+	}
+
+	if (cache.count[cls] < JACK_POOL_CACHE) {
+		cache.blocks[cls][cache.count[cls]++] = ptr;
+	} else {
+		jack_pool_push (cls, ptr);
+	}
+}
+
+void
+jack_pool_get_stats (jack_pool_stats_t *s)
+{
+	int cls;
+
+	s->allocs = __atomic_load_n (&stats.allocs, __ATOMIC_RELAXED);
+	s->releases = __atomic_load_n (&stats.releases, __ATOMIC_RELAXED);
+	s->misses = __atomic_load_n (&stats.misses, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock (&reserve_lock);
+	s->reserved_bytes = stats.reserved_bytes;
+	s->locked_bytes = stats.locked_bytes;
+	pthread_mutex_unlock (&reserve_lock);
+
+	for (cls = 0; cls < JACK_POOL_CLASSES; cls++) {
+		s->free_blocks[cls] = __atomic_load_n (&stats.free_blocks[cls],
+						       __ATOMIC_RELAXED);
+	}
 }
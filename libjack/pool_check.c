@@ -0,0 +1,216 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    pool_check -- stress the size-class pool from several threads
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+ */
+
+/* Each thread allocates blocks of random sizes, keeps a few, and
+   swaps others through a shared set of slots so that blocks are
+   often released on a different thread than the one that allocated
+   them. A block's first word records its current owner; finding it
+   already owned means the pool handed the same block out twice. With
+   enough blocks reserved up front nothing may miss, and once all
+   threads have exited every block must be back on the shared lists. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+#define CHECK_THREADS   8
+#define CHECK_HELD      16
+#define CHECK_SLOTS     64
+#define CHECK_ITERS     200000
+
+/* live blocks of one class at worst: every thread's held blocks and
+   per-thread cache, plus the shared slots */
+#define CHECK_RESERVE   (CHECK_THREADS * (CHECK_HELD + 8) + CHECK_SLOTS)
+
+static void *slots[CHECK_SLOTS];
+static volatile int failed = 0;
+
+static size_t
+random_size (unsigned int *seed)
+{
+	int cls = rand_r (seed) % JACK_POOL_CLASSES;
+	size_t max = (size_t)JACK_POOL_MIN_BLOCK << cls;
+
+	return 1 + rand_r (seed) % max;
+}
+
+static void *
+take (uintptr_t self, unsigned int *seed)
+{
+	uintptr_t *block = jack_pool_alloc (random_size (seed));
+	uintptr_t owner;
+
+	if (block == NULL) {
+		fprintf (stderr, "pool_check: allocation failed\n");
+		failed = 1;
+		return NULL;
+	}
+
+	if ((uintptr_t)block % 64) {
+		fprintf (stderr, "pool_check: block %p is not 64-byte aligned\n",
+			 (void*)block);
+		failed = 1;
+	}
+
+	owner = __atomic_exchange_n (block, self, __ATOMIC_ACQ_REL);
+	if (owner != 0) {
+		fprintf (stderr, "pool_check: block %p handed out twice\n",
+			 (void*)block);
+		failed = 1;
+	}
+
+	return block;
+}
+
+static void
+give (uintptr_t *block)
+{
+	if (block) {
+		__atomic_store_n (block, 0, __ATOMIC_RELEASE);
+		jack_pool_release (block);
+	}
+}
+
+static void *
+worker (void *arg)
+{
+	uintptr_t self = (uintptr_t)arg;
+	unsigned int seed = (unsigned int)self;
+	void *held[CHECK_HELD];
+	void *mine;
+	int i, n;
+
+	jack_pool_thread_init ();
+
+	for (n = 0; n < CHECK_HELD; n++) {
+		held[n] = take (self, &seed);
+	}
+
+	for (i = 0; i < CHECK_ITERS && !failed; i++) {
+		n = rand_r (&seed) % CHECK_HELD;
+		give (held[n]);
+		held[n] = take (self, &seed);
+
+		/* pass one on; whoever picks it up releases it */
+		if (rand_r (&seed) % 4 == 0) {
+			if ((mine = take (self, &seed)) == NULL) {
+				break;
+			}
+			__atomic_store_n ((uintptr_t*)mine, 0, __ATOMIC_RELEASE);
+			n = rand_r (&seed) % CHECK_SLOTS;
+			mine = __atomic_exchange_n (&slots[n], mine, __ATOMIC_ACQ_REL);
+			if (mine) {
+				jack_pool_release (mine);
+			}
+		}
+	}
+
+	for (n = 0; n < CHECK_HELD; n++) {
+		give (held[n]);
+	}
+
+	return NULL;
+}
+
+/* empty the slots on a thread of its own, whose cache then goes back
+   to the shared lists when it exits */
+
+static void *
+drain (void *arg)
+{
+	int n;
+
+	for (n = 0; n < CHECK_SLOTS; n++) {
+		give (slots[n]);
+	}
+
+	return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+	pthread_t threads[CHECK_THREADS];
+	jack_pool_stats_t stats;
+	int cls, n;
+
+	for (cls = 0; cls < JACK_POOL_CLASSES; cls++) {
+		if (jack_pool_reserve ((size_t)JACK_POOL_MIN_BLOCK << cls,
+				       CHECK_RESERVE)) {
+			fprintf (stderr, "pool_check: cannot reserve class %d\n",
+				 cls);
+			return 1;
+		}
+	}
+
+	for (n = 0; n < CHECK_THREADS; n++) {
+		if (pthread_create (&threads[n], NULL, worker,
+				    (void*)(uintptr_t)(n + 1))) {
+			fprintf (stderr, "pool_check: cannot start thread\n");
+			return 1;
+		}
+	}
+
+	for (n = 0; n < CHECK_THREADS; n++) {
+		pthread_join (threads[n], NULL);
+	}
+
+	pthread_create (&threads[0], NULL, drain, NULL);
+	pthread_join (threads[0], NULL);
+
+	jack_pool_get_stats (&stats);
+
+	if (stats.misses) {
+		fprintf (stderr, "pool_check: %llu allocations missed the pool\n",
+			 (unsigned long long)stats.misses);
+		failed = 1;
+	}
+
+	if (stats.allocs != stats.releases) {
+		fprintf (stderr, "pool_check: %llu allocations, %llu releases\n",
+			 (unsigned long long)stats.allocs,
+			 (unsigned long long)stats.releases);
+		failed = 1;
+	}
+
+	for (cls = 0; cls < JACK_POOL_CLASSES; cls++) {
+		if (stats.free_blocks[cls] != CHECK_RESERVE) {
+			fprintf (stderr, "pool_check: class %d has %u of %u "
+				 "blocks free\n", cls, stats.free_blocks[cls],
+				 CHECK_RESERVE);
+			failed = 1;
+		}
+	}
+
+	if (failed) {
+		fprintf (stderr, "pool_check: FAILED\n");
+		return 1;
+	}
+
+	printf ("pool_check: %llu allocations on %d threads, none missed\n",
+		(unsigned long long)stats.allocs, CHECK_THREADS);
+	return 0;
+}
@@ -72,12 +72,46 @@ jack_port_type_info_t jack_builtin_port_types[] = {
 	{ .type_name = "", }
 };
 
+/* Sum nsrcs (>= 1) buffers into dest, one block at a time so that
+ * each source is read once and dest written once, rather than making
+ * a separate pass over dest for every input. dest may be srcs[0].
+ */
+
+#define JACK_MIX_BLOCK 64
+#define JACK_MIX_MAX_INPUTS 32
+
+static void
+gen_mixnf (float *dest, const float * const *srcs, int nsrcs, int length)
+{
+	float acc[JACK_MIX_BLOCK];
+	const float *src;
+	int i, j, k, n;
+
+	for (i = 0; i < length; i += n) {
+		n = length - i;
+		if (n > JACK_MIX_BLOCK) {
+			n = JACK_MIX_BLOCK;
+		}
+		src = srcs[0] + i;
+		for (j = 0; j < n; j++)
+			acc[j] = src[j];
+		for (k = 1; k < nsrcs; k++) {
+			src = srcs[k] + i;
+			for (j = 0; j < n; j++)
+				acc[j] += src[j];
+		}
+		for (j = 0; j < n; j++)
+			dest[i + j] = acc[j];
+	}
+}
+
 /* these functions have been taken from libDSP X86.c  -jl */
 
 #ifdef USE_DYNSIMD
 
 static void (*opt_copy)(float *, const float *, int);
 static void (*opt_mix)(float *, const float *, int);
+static void (*opt_mixn)(float *, const float * const *, int, int);
 
 static void
 gen_copyf (float *dest, const float *src, int length)
@@ -99,17 +133,56 @@ gen_mixf (float *dest, const float *src, int length)
 
 #ifdef ARCH_X86
 
+/* for 3DNow!, which has no N-way kernel */
+static void
+pair_mixnf (float *dest, const float * const *srcs, int nsrcs, int length)
+{
+	int k;
+
+	if (dest != srcs[0]) {
+		opt_copy (dest, srcs[0], length);
+	}
+	for (k = 1; k < nsrcs; k++)
+		opt_mix (dest, srcs[k], length);
+}
+
 void jack_port_set_funcs ()
 {
-	if (ARCH_X86_HAVE_SSE2 (cpu_type)) {
+	if (ARCH_X86_HAVE_AVX512 (cpu_type)) {
+		opt_copy = x86_avx512_copyf;
+		opt_mix = x86_avx512_add2f;
+		opt_mixn = x86_avx512_mixnf;
+	} else if (ARCH_X86_HAVE_AVX2 (cpu_type)) {
+		opt_copy = x86_avx2_copyf;
+		opt_mix = x86_avx2_add2f;
+		opt_mixn = x86_avx2_mixnf;
+	} else if (ARCH_X86_HAVE_SSE2 (cpu_type)) {
 		opt_copy = x86_sse_copyf;
 		opt_mix = x86_sse_add2f;
+		opt_mixn = x86_sse_mixnf;
 	} else if (ARCH_X86_HAVE_3DNOW (cpu_type)) {
 		opt_copy = x86_3dnow_copyf;
 		opt_mix = x86_3dnow_add2f;
+		opt_mixn = pair_mixnf;
+	} else {
+		opt_copy = gen_copyf;
+		opt_mix = gen_mixf;
+		opt_mixn = gen_mixnf;
+	}
+}
+
+#elif defined(ARCH_ARM64)
+
+void jack_port_set_funcs ()
+{
+	if (have_neon ()) {
+		opt_copy = arm64_neon_copyf;
+		opt_mix = arm64_neon_add2f;
+		opt_mixn = arm64_neon_mixnf;
 	} else {
 		opt_copy = gen_copyf;
 		opt_mix = gen_mixf;
+		opt_mixn = gen_mixnf;
 	}
 }
 
@@ -119,28 +192,36 @@ void jack_port_set_funcs ()
 {
 	opt_copy = gen_copyf;
 	opt_mix = gen_mixf;
+	opt_mixn = gen_mixnf;
 }
 
 #endif  /* ARCH_X86 */
 
 #endif  /* USE_DYNSIMD */
 
+/* this nasty, nasty kludge is here because between 0.109.0 and 0.109.1,
+   the ALSA audio backend had the name "ALSA", whereas as before and
+   after it, it was called "alsa_pcm". this stops breakage for
+   any setups that have saved "alsa_pcm" or "ALSA" in their connection
+   state.
+ */
+const char *
+jack_port_name_canonical (const char* target, char *buf, size_t size)
+{
+	if (strncmp (target, "ALSA:capture", 12) == 0 || strncmp (target, "ALSA:playback", 13) == 0) {
+		snprintf (buf, size, "alsa_pcm%s", target + 4);
+		return buf;
+	}
+
+	return target;
+}
+
 int
 jack_port_name_equals (jack_port_shared_t* port, const char* target)
 {
 	char buf[JACK_PORT_NAME_SIZE + 1];
 
-	/* this nasty, nasty kludge is here because between 0.109.0 and 0.109.1,
-	   the ALSA audio backend had the name "ALSA", whereas as before and
-	   after it, it was called "alsa_pcm". this stops breakage for
-	   any setups that have saved "alsa_pcm" or "ALSA" in their connection
-	   state.
-	 */
-
-	if (strncmp (target, "ALSA:capture", 12) == 0 || strncmp (target, "ALSA:playback", 13) == 0) {
-		snprintf (buf, sizeof(buf), "alsa_pcm%s", target + 4);
-		target = buf;
-	}
+	target = jack_port_name_canonical (target, buf, sizeof(buf));
 
 	return strcmp (port->name, target) == 0 ||
 	       strcmp (port->alias1, target) == 0 ||
@@ -190,6 +271,13 @@ jack_port_new (const jack_client_t *client, jack_port_id_t port_id,
 	pthread_mutex_init (&port->connection_lock, NULL);
 	port->connections = 0;
 	port->tied = NULL;
+	port->cycle = &control->cycle;
+	port->port_generation = &control->port_generation;
+	port->mix_cycle = 0;
+	port->mix_nframes = 0;
+	port->mix_result = NULL;
+	port->mix_key = 0;
+	port->mix_cache = 0;
 
 	if (jack_uuid_compare (client->control->uuid, port->shared->client_id) == 0) {
 
@@ -393,6 +481,12 @@ jack_port_get_all_connections (const jack_client_t *client,
 		return NULL;
 	}
 
+	/* the engine's snapshot answers without a round trip */
+	if (jack_graph_get_connections ((jack_client_t*)client,
+					port->shared->id, &ret) == 0) {
+		return ret;
+	}
+
 	VALGRIND_MEMSET (&req, 0, sizeof(req));
 
 	req.type = GetPortConnections;
@@ -487,32 +581,80 @@ jack_port_by_id (jack_client_t *client, jack_port_id_t id)
 	return port;
 }
 
-jack_port_t *
-jack_port_by_name_int (jack_client_t *client, const char *port_name, int* free)
+/* Find the shared port structure called (or aliased) port_name. The
+ * index is built on first use and rebuilt whenever the engine's port
+ * generation has moved on, which happens each time any client
+ * registers, removes, renames or aliases a port. Lookups may come from
+ * any thread, hence the lock.
+ */
+static jack_port_shared_t *
+jack_port_shared_by_name (jack_client_t *client, const char *port_name)
+{
+	jack_port_shared_t *ports = client->engine->ports;
+	jack_port_shared_t *shared = NULL;
+	uint32_t generation;
+	unsigned long i;
+
+	pthread_mutex_lock (&client->port_index_lock);
+
+	generation = __atomic_load_n (&client->engine->port_generation,
+				      __ATOMIC_ACQUIRE);
+
+	if (client->port_index.buckets == NULL) {
+		if (jack_port_index_init (&client->port_index,
+					  client->engine->port_max)) {
+			/* no memory for the index; do it the slow way */
+			for (i = 0; i < client->engine->port_max; i++) {
+				if (ports[i].in_use &&
+				    jack_port_name_equals (&ports[i], port_name)) {
+					shared = &ports[i];
+					break;
+				}
+			}
+			pthread_mutex_unlock (&client->port_index_lock);
+			return shared;
+		}
+		jack_port_index_rebuild (&client->port_index, ports);
+		client->port_index_generation = generation;
+	} else if (client->port_index_generation != generation) {
+		jack_port_index_rebuild (&client->port_index, ports);
+		client->port_index_generation = generation;
+	}
+
+	shared = jack_port_index_find (&client->port_index, ports, port_name);
+
+	pthread_mutex_unlock (&client->port_index_lock);
+
+	return shared;
+}
+
+static jack_port_t *
+jack_port_by_shared_int (jack_client_t *client, jack_port_shared_t *shared,
+			 int* free)
 {
 	JSList *node;
+
 	for (node = client->ports; node; node = jack_slist_next (node)) {
-		if (jack_port_name_equals(((jack_port_t *) node->data)->shared, port_name)) {
+		if (((jack_port_t*)node->data)->shared == shared) {
 			*free = FALSE;
-			return (jack_port_t *) node->data;
+			return (jack_port_t*)node->data;
 		}
 	}
 
-	unsigned long i, limit;
-	jack_port_shared_t *port;
+	*free = TRUE;
+	return jack_port_new (client, shared->id, client->engine);
+}
 
-	limit = client->engine->port_max;
-	port = &client->engine->ports[0];
+jack_port_t *
+jack_port_by_name_int (jack_client_t *client, const char *port_name, int* free)
+{
+	jack_port_shared_t *shared;
 
-	for (i = 0; i < limit; i++) {
-		if (port[i].in_use && jack_port_name_equals (&port[i], port_name)) {
-			*free = TRUE;
-			return jack_port_new (client, port[i].id,
-					      client->engine);
-		}
+	if ((shared = jack_port_shared_by_name (client, port_name)) == NULL) {
+		return NULL;
 	}
 
-	return NULL;
+	return jack_port_by_shared_int (client, shared, free);
 }
 
 jack_port_t *
@@ -520,11 +662,16 @@ jack_port_by_name (jack_client_t *client,  const char *port_name)
 {
 	JSList *node;
 	jack_port_t* port;
+	jack_port_shared_t *shared;
 	int need_free = FALSE;
 
+	if ((shared = jack_port_shared_by_name (client, port_name)) == NULL) {
+		return NULL;
+	}
+
 	for (node = client->ports_ext; node; node = jack_slist_next (node)) {
 		port = node->data;
-		if (jack_port_name_equals (port->shared, port_name)) {
+		if (port->shared == shared) {
 			/* Found port, return the cached structure. */
 			return port;
 		}
@@ -532,7 +679,7 @@ jack_port_by_name (jack_client_t *client,  const char *port_name)
 
 	/* Otherwise allocate a new port structure, keep it in the
 	 * ports_ext list for later use. */
-	port = jack_port_by_name_int (client, port_name, &need_free);
+	port = jack_port_by_shared_int (client, shared, &need_free);
 	if (port != NULL && need_free) {
 		client->ports_ext =
 			jack_slist_prepend (client->ports_ext, port);
@@ -570,10 +717,253 @@ jack_port_set_latency (jack_port_t *port, jack_nframes_t nframes)
 	}
 }
 
+/* Mixdowns made on this thread in the current cycle, which input ports
+ * fed by the same outputs may reuse. Only ports with a non-zero
+ * mix_key, which the server's --share-mixdowns option enables, are
+ * entered. Entries are keyed by port id and cycle and hold copies of
+ * what a match is checked against, never a pointer to the port: the
+ * port may belong to another client on this thread and be freed while
+ * its entry is still in the table.
+ */
+
+#define JACK_SHARED_MIXDOWNS        32
+#define JACK_SHARED_MIXDOWN_SOURCES 8
+
+typedef struct {
+	jack_port_id_t id;              /* port that made the mix */
+	uint32_t key;
+	jack_port_type_id_t ptype_id;
+	jack_nframes_t nframes;
+	void *result;
+	unsigned int nsources;
+	jack_port_id_t sources[JACK_SHARED_MIXDOWN_SOURCES];
+} jack_shared_mixdown_t;
+
+typedef struct {
+	volatile uint32_t *counter;     /* engine cycle counter */
+	uint32_t cycle;
+	unsigned int count;
+	jack_shared_mixdown_t mixes[JACK_SHARED_MIXDOWNS];
+} jack_shared_mixdowns_t;
+
+static __thread jack_shared_mixdowns_t shared_mixdowns;
+
+static inline uint32_t
+jack_port_mix_hash (jack_port_id_t id)
+{
+	return (id + 1) * 2654435761U;
+}
+
+static int
+jack_port_same_sources (jack_port_t *port, jack_shared_mixdown_t *mix)
+{
+	JSList *node;
+	unsigned int i;
+
+	if (jack_slist_length (port->connections) != mix->nsources) {
+		return FALSE;
+	}
+
+	/* neither side has duplicates */
+	for (node = port->connections; node; node = jack_slist_next (node)) {
+		for (i = 0; i < mix->nsources; i++) {
+			if (((jack_port_t*)node->data)->shared->id
+			    == mix->sources[i]) {
+				break;
+			}
+		}
+		if (i == mix->nsources) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static inline int
+jack_shared_mixdowns_current (jack_port_t *port, uint32_t cycle)
+{
+	return shared_mixdowns.counter == port->cycle
+	       && shared_mixdowns.cycle == cycle;
+}
+
+static void *
+jack_port_shared_mixdown (jack_port_t *port, uint32_t cycle,
+			  jack_nframes_t nframes)
+{
+	jack_shared_mixdown_t *mix;
+	unsigned int i;
+
+	if (!jack_shared_mixdowns_current (port, cycle)) {
+		return NULL;
+	}
+
+	for (i = 0; i < shared_mixdowns.count; i++) {
+
+		mix = &shared_mixdowns.mixes[i];
+
+		if (mix->key == port->mix_key
+		    && mix->id != port->shared->id
+		    && mix->nframes >= nframes
+		    && mix->ptype_id == port->shared->ptype_id
+		    && jack_port_same_sources (port, mix)) {
+			port->mix_cycle = cycle;
+			port->mix_nframes = mix->nframes;
+			port->mix_result = mix->result;
+			return port->mix_result;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+jack_port_add_shared_mixdown (jack_port_t *port, uint32_t cycle)
+{
+	jack_shared_mixdown_t *mix;
+	JSList *node;
+	unsigned int i;
+
+	if (!jack_shared_mixdowns_current (port, cycle)) {
+		shared_mixdowns.counter = port->cycle;
+		shared_mixdowns.cycle = cycle;
+		shared_mixdowns.count = 0;
+	}
+
+	/* a port mixed again for more frames replaces its entry */
+	for (i = 0; i < shared_mixdowns.count; i++) {
+		if (shared_mixdowns.mixes[i].id == port->shared->id) {
+			break;
+		}
+	}
+
+	if (i == JACK_SHARED_MIXDOWNS) {
+		return;
+	}
+
+	mix = &shared_mixdowns.mixes[i];
+	mix->id = port->shared->id;
+	mix->key = port->mix_key;
+	mix->ptype_id = port->shared->ptype_id;
+	mix->nframes = port->mix_nframes;
+	mix->result = port->mix_result;
+	mix->nsources = 0;
+
+	/* jack_port_mixdown_changed() only gives ports with at most
+	   JACK_SHARED_MIXDOWN_SOURCES sources a key */
+	for (node = port->connections; node; node = jack_slist_next (node)) {
+		mix->sources[mix->nsources++] =
+			((jack_port_t*)node->data)->shared->id;
+	}
+
+	if (i == shared_mixdowns.count) {
+		shared_mixdowns.count++;
+	}
+}
+
+void
+jack_port_mixdown_changed (jack_client_t *client, jack_port_t *port)
+{
+	JSList *node;
+	jack_port_t *src;
+	uint32_t key;
+	int n = 0;
+
+	/* called with the connection lock held */
+
+	port->mix_cycle = 0;
+	port->mix_result = NULL;
+	port->mix_cache = TRUE;
+	key = 0;
+
+	for (node = port->connections; node; node = jack_slist_next (node)) {
+		src = (jack_port_t*)node->data;
+		/* a port fed by this client may be read before and
+		   after the source is written in the same cycle */
+		if (jack_uuid_compare (src->shared->client_id,
+				       client->control->uuid) == 0) {
+			port->mix_cache = FALSE;
+		}
+		key += jack_port_mix_hash (src->shared->id);
+		n++;
+	}
+
+	if (port->mix_cache && n > 1 && n <= JACK_SHARED_MIXDOWN_SOURCES
+	    && client->engine->share_mixdowns) {
+		key ^= (uint32_t)n;
+		port->mix_key = key ? key : 1;
+	} else {
+		port->mix_key = 0;
+	}
+}
+
+static jack_silence_stats_t silence_stats;
+
+void
+jack_silence_skipped (jack_silence_kind_t kind, size_t bytes)
+{
+	__atomic_fetch_add (&silence_stats.skipped_bytes[kind], bytes,
+			    __ATOMIC_RELAXED);
+}
+
+void
+jack_get_silence_stats (jack_silence_stats_t *stats)
+{
+	int kind;
+
+	for (kind = 0; kind < JackSilenceKinds; kind++) {
+		stats->skipped_bytes[kind] =
+			__atomic_load_n (&silence_stats.skipped_bytes[kind],
+					 __ATOMIC_RELAXED);
+	}
+}
+
+int
+jack_port_set_silent (jack_port_t *port, jack_nframes_t nframes)
+{
+	if (!(port->shared->flags & JackPortIsOutput)
+	    || port->fptr.buffer_init == NULL
+	    || port->client_segment_base == NULL
+	    || *port->client_segment_base == MAP_FAILED) {
+		return -1;
+	}
+
+	port->fptr.buffer_init (jack_output_port_buffer (port),
+				jack_port_type_buffer_size (port->type_info, nframes),
+				nframes);
+	port->shared->silent_cycle = *port->cycle;
+
+	return 0;
+}
+
+int
+jack_port_is_silent (jack_port_t *port)
+{
+	JSList *node;
+
+	if (port->shared->flags & JackPortIsOutput) {
+		if (port->tied) {
+			return jack_port_is_silent (port->tied);
+		}
+		return jack_output_port_silent (port);
+	}
+
+	/* see jack_port_get_buffer() on why no lock is needed */
+	for (node = port->connections; node; node = jack_slist_next (node)) {
+		if (!jack_port_is_silent ((jack_port_t*)node->data)) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 void *
 jack_port_get_buffer (jack_port_t *port, jack_nframes_t nframes)
 {
 	JSList *node, *next;
+	uint32_t cycle;
+	void *buf;
 
 	/* Output port.  The buffer was assigned by the engine
 	   when the port was registered.
@@ -623,10 +1013,84 @@ jack_port_get_buffer (jack_port_t *port, jack_nframes_t nframes)
 		jack_error ( "internal jack error: mix_buffer not allocated" );
 		return NULL;
 	}
+
+	/* The sources cannot change within a cycle, so a mix made
+	   earlier in this cycle, by this port or by one with the same
+	   sources, is still good.
+	 */
+	cycle = *port->cycle;
+
+	if (port->mix_cache && port->mix_cycle == cycle
+	    && port->mix_nframes >= nframes) {
+		return port->mix_result;
+	}
+
+	if (port->mix_key && (buf = jack_port_shared_mixdown (port, cycle, nframes))) {
+		return buf;
+	}
+
 	port->fptr.mixdown (port, nframes);
+
+	if (port->mix_cache) {
+		port->mix_cycle = cycle;
+		port->mix_nframes = nframes;
+		port->mix_result = port->mix_buffer;
+		if (port->mix_key) {
+			jack_port_add_shared_mixdown (port, cycle);
+		}
+	}
+
 	return (void*)port->mix_buffer;
 }
 
+/* For consumers that mix and convert in one pass: store the buffers
+ * that jack_audio_port_mixdown() would sum into srcs[] and return how
+ * many there are. nframes is only used to count skipped silence.
+ * Returns -1 when the port has fewer than two connections, is not an
+ * audio port, has more than max sources, or already has this cycle's
+ * mix in hand; jack_port_get_buffer() is the way to go then.
+ */
+int
+jack_port_mix_sources (jack_port_t *port, jack_nframes_t nframes,
+		       const jack_default_audio_sample_t **srcs, int max)
+{
+	JSList *node;
+	jack_port_t *src;
+	unsigned int skipped = 0;
+	int nsrcs = 0;
+
+	if (port->fptr.mixdown != jack_audio_port_mixdown
+	    || port->connections == NULL
+	    || jack_slist_next (port->connections) == NULL
+	    || (port->mix_cycle != 0 && port->mix_cycle == *port->cycle)) {
+		return -1;
+	}
+
+	for (node = port->connections; node; node = jack_slist_next (node)) {
+
+		src = (jack_port_t*)node->data;
+
+		if (jack_output_port_silent (src)) {
+			skipped++;
+			continue;
+		}
+
+		if (nsrcs == max) {
+			return -1;
+		}
+
+		srcs[nsrcs++] = (const jack_default_audio_sample_t*)
+				jack_output_port_buffer (src);
+	}
+
+	if (skipped) {
+		jack_silence_skipped (JackSilenceMixdown, skipped * nframes
+				      * sizeof(jack_default_audio_sample_t));
+	}
+
+	return nsrcs;
+}
+
 size_t
 jack_port_type_buffer_size (jack_port_type_info_t* port_type_info, jack_nframes_t nframes)
 {
@@ -850,7 +1314,7 @@ jack_port_set_name (jack_port_t *port, const char *new_name)
 	len = sizeof(port->shared->name) -
 	      ((int)(colon - port->shared->name)) - 2;
 	snprintf (colon + 1, len, "%s", new_name);
-
+	__atomic_fetch_add (port->port_generation, 1, __ATOMIC_RELEASE);
 
 	return 0;
 }
@@ -866,6 +1330,8 @@ jack_port_set_alias (jack_port_t *port, const char *alias)
 		return -1;
 	}
 
+	__atomic_fetch_add (port->port_generation, 1, __ATOMIC_RELEASE);
+
 	return 0;
 }
 
@@ -880,6 +1346,8 @@ jack_port_unset_alias (jack_port_t *port, const char *alias)
 		return -1;
 	}
 
+	__atomic_fetch_add (port->port_generation, 1, __ATOMIC_RELEASE);
+
 	return 0;
 }
 
@@ -934,13 +1402,11 @@ static void
 jack_audio_port_mixdown (jack_port_t *port, jack_nframes_t nframes)
 {
 	JSList *node;
-	jack_port_t *input;
-
-#ifndef ARCH_X86
-	jack_nframes_t n;
-	jack_default_audio_sample_t *dst, *src;
-#endif
+	jack_port_t *src;
+	const jack_default_audio_sample_t *srcs[JACK_MIX_MAX_INPUTS];
 	jack_default_audio_sample_t *buffer;
+	int nsrcs = 0;
+	unsigned int skipped = 0;
 
 	/* by the time we've called this, we've already established
 	   the existence of more than one connection to this input
@@ -953,32 +1419,45 @@ jack_audio_port_mixdown (jack_port_t *port, jack_nframes_t nframes)
 	   during this time.
 	 */
 
-	node = port->connections;
-	input = (jack_port_t*)node->data;
 	buffer = port->mix_buffer;
 
-#ifndef USE_DYNSIMD
-	memcpy (buffer, jack_output_port_buffer (input),
-		sizeof(jack_default_audio_sample_t) * nframes);
-#else   /* USE_DYNSIMD */
-	opt_copy (buffer, jack_output_port_buffer (input), nframes);
-#endif /* USE_DYNSIMD */
-
-	for (node = jack_slist_next (node); node;
-	     node = jack_slist_next (node)) {
+	for (node = port->connections; node; node = jack_slist_next (node)) {
 
-		input = (jack_port_t*)node->data;
+		src = (jack_port_t*)node->data;
 
-#ifndef USE_DYNSIMD
-		n = nframes;
-		dst = buffer;
-		src = jack_output_port_buffer (input);
+		if (jack_output_port_silent (src)) {
+			skipped++;
+			continue;
+		}
 
-		while (n--)
-			*dst++ += *src++;
+		srcs[nsrcs++] = (const jack_default_audio_sample_t*)
+				jack_output_port_buffer (src);
 
+		if (nsrcs == JACK_MIX_MAX_INPUTS) {
+			/* carry the partial sum over as the first
+			   input of the next batch */
+#ifndef USE_DYNSIMD
+			gen_mixnf (buffer, srcs, nsrcs, nframes);
 #else           /* USE_DYNSIMD */
-		opt_mix (buffer, jack_output_port_buffer (input), nframes);
+			opt_mixn (buffer, srcs, nsrcs, nframes);
 #endif /* USE_DYNSIMD */
+			srcs[0] = buffer;
+			nsrcs = 1;
+		}
+	}
+
+	if (nsrcs == 0) {
+		memset (buffer, 0, nframes * sizeof(jack_default_audio_sample_t));
+	} else if (nsrcs > 1 || srcs[0] != buffer) {
+#ifndef USE_DYNSIMD
+		gen_mixnf (buffer, srcs, nsrcs, nframes);
+#else   /* USE_DYNSIMD */
+		opt_mixn (buffer, srcs, nsrcs, nframes);
+#endif /* USE_DYNSIMD */
+	}
+
+	if (skipped) {
+		jack_silence_skipped (JackSilenceMixdown, skipped * nframes
+				      * sizeof(jack_default_audio_sample_t));
 	}
 }
@@ -0,0 +1,208 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "portindex.h"
+
+#define JACK_PORT_INDEX_ENTRIES 3
+
+static uint32_t
+jack_port_index_hash (const char *name)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+int
+jack_port_index_init (jack_port_index_t *index, uint32_t nports)
+{
+	uint32_t nentries = nports * JACK_PORT_INDEX_ENTRIES;
+	uint32_t nbuckets = 16;
+	uint32_t i;
+
+	/* keep chains short with every port carrying two aliases */
+	while (nbuckets < nentries) {
+		nbuckets <<= 1;
+	}
+
+	index->nports = nports;
+	index->mask = nbuckets - 1;
+	index->buckets = (int32_t*)malloc (sizeof(int32_t) * nbuckets);
+	index->next = (int32_t*)malloc (sizeof(int32_t) * nentries);
+	index->hash = (uint32_t*)malloc (sizeof(uint32_t) * nentries);
+	index->linked = (char*)calloc (nentries, 1);
+
+	if (!index->buckets || !index->next || !index->hash || !index->linked) {
+		jack_port_index_free (index);
+		return -1;
+	}
+
+	for (i = 0; i < nbuckets; i++) {
+		index->buckets[i] = -1;
+	}
+
+	return 0;
+}
+
+void
+jack_port_index_free (jack_port_index_t *index)
+{
+	free (index->buckets);
+	free (index->next);
+	free (index->hash);
+	free (index->linked);
+	memset (index, 0, sizeof(*index));
+}
+
+static void
+jack_port_index_unlink (jack_port_index_t *index, int32_t entry)
+{
+	int32_t *pp;
+
+	if (!index->linked[entry]) {
+		return;
+	}
+
+	for (pp = &index->buckets[index->hash[entry] & index->mask];
+	     *pp != -1; pp = &index->next[*pp]) {
+		if (*pp == entry) {
+			*pp = index->next[entry];
+			break;
+		}
+	}
+
+	index->linked[entry] = 0;
+}
+
+static void
+jack_port_index_link (jack_port_index_t *index, int32_t entry,
+		      const char *name)
+{
+	uint32_t h = jack_port_index_hash (name);
+
+	index->hash[entry] = h;
+	index->next[entry] = index->buckets[h & index->mask];
+	index->buckets[h & index->mask] = entry;
+	index->linked[entry] = 1;
+}
+
+void
+jack_port_index_remove (jack_port_index_t *index, jack_port_id_t id)
+{
+	int n;
+
+	if (id >= index->nports) {
+		return;
+	}
+
+	for (n = 0; n < JACK_PORT_INDEX_ENTRIES; n++) {
+		jack_port_index_unlink (index, id * JACK_PORT_INDEX_ENTRIES + n);
+	}
+}
+
+void
+jack_port_index_update (jack_port_index_t *index, jack_port_shared_t *port)
+{
+	const char *names[JACK_PORT_INDEX_ENTRIES];
+	int32_t base;
+	int n;
+
+	if (port->id >= index->nports) {
+		return;
+	}
+
+	jack_port_index_remove (index, port->id);
+
+	if (!port->in_use) {
+		return;
+	}
+
+	names[0] = port->name;
+	names[1] = port->alias1;
+	names[2] = port->alias2;
+	base = port->id * JACK_PORT_INDEX_ENTRIES;
+
+	for (n = 0; n < JACK_PORT_INDEX_ENTRIES; n++) {
+		if (names[n][0] != '\0') {
+			jack_port_index_link (index, base + n, names[n]);
+		}
+	}
+}
+
+void
+jack_port_index_rebuild (jack_port_index_t *index, jack_port_shared_t *ports)
+{
+	uint32_t i;
+
+	for (i = 0; i <= index->mask; i++) {
+		index->buckets[i] = -1;
+	}
+
+	memset (index->linked, 0, index->nports * JACK_PORT_INDEX_ENTRIES);
+
+	for (i = 0; i < index->nports; i++) {
+		if (ports[i].in_use) {
+			jack_port_index_update (index, &ports[i]);
+		}
+	}
+}
+
+jack_port_shared_t *
+jack_port_index_find (jack_port_index_t *index, jack_port_shared_t *ports,
+		      const char *name)
+{
+	char buf[JACK_PORT_NAME_SIZE + 1];
+	jack_port_shared_t *port;
+	uint32_t h;
+	int32_t entry;
+
+	if (index->buckets == NULL) {
+		return NULL;
+	}
+
+	h = jack_port_index_hash (jack_port_name_canonical (name, buf,
+							    sizeof(buf)));
+
+	for (entry = index->buckets[h & index->mask]; entry != -1;
+	     entry = index->next[entry]) {
+
+		if (index->hash[entry] != h) {
+			continue;
+		}
+
+		port = &ports[entry / JACK_PORT_INDEX_ENTRIES];
+
+		if (port->in_use && jack_port_name_equals (port, name)) {
+			return port;
+		}
+	}
+
+	return NULL;
+}
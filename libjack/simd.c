@@ -26,6 +26,9 @@
 
 #ifdef ARCH_X86
 
+#include <cpuid.h>
+#include <immintrin.h>
+
 int
 have_3dnow ()
 {
@@ -410,7 +413,355 @@ sse_nonalign:
 	}
 }
 
+/* AVX state has to be enabled by the OS as well as supported by the
+ * CPU. Returns 0 for neither, 1 for AVX2, 2 for AVX2 and AVX-512F.
+ */
+int
+have_avx ()
+{
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0_lo, xcr0_hi;
+	int res = 0;
+
+	if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx)) {
+		return 0;
+	}
+
+	/* OSXSAVE and AVX */
+	if ((ecx & (1 << 27)) == 0 || (ecx & (1 << 28)) == 0) {
+		return 0;
+	}
+
+	asm volatile ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+
+	/* XMM and YMM state */
+	if ((xcr0_lo & 0x6) != 0x6) {
+		return 0;
+	}
+
+	if (!__get_cpuid_count (7, 0, &eax, &ebx, &ecx, &edx)) {
+		return 0;
+	}
+
+	if (ebx & (1 << 5)) {
+		res = 1;
+		/* AVX-512F plus opmask, ZMM0-15 and ZMM16-31 state */
+		if ((ebx & (1 << 16)) && (xcr0_lo & 0xe0) == 0xe0) {
+			res = 2;
+		}
+	}
+
+	return res;
+}
+
+/* The *_mixnf() functions set dest to the sum of nsrcs (>= 1) source
+ * buffers, reading each source once and writing dest once. dest may
+ * be the same buffer as srcs[0].
+ */
+
+__attribute__((target ("sse")))
+void
+x86_sse_mixnf (float *dest, const float * const *srcs, int nsrcs, int length)
+{
+	int i, k;
+	const float *src;
+	__m128 a0, a1, a2, a3;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		src = srcs[0] + i;
+		a0 = _mm_loadu_ps (src);
+		a1 = _mm_loadu_ps (src + 4);
+		a2 = _mm_loadu_ps (src + 8);
+		a3 = _mm_loadu_ps (src + 12);
+		for (k = 1; k < nsrcs; k++) {
+			src = srcs[k] + i;
+			a0 = _mm_add_ps (a0, _mm_loadu_ps (src));
+			a1 = _mm_add_ps (a1, _mm_loadu_ps (src + 4));
+			a2 = _mm_add_ps (a2, _mm_loadu_ps (src + 8));
+			a3 = _mm_add_ps (a3, _mm_loadu_ps (src + 12));
+		}
+		_mm_storeu_ps (dest + i, a0);
+		_mm_storeu_ps (dest + i + 4, a1);
+		_mm_storeu_ps (dest + i + 8, a2);
+		_mm_storeu_ps (dest + i + 12, a3);
+	}
+	for (; i + 4 <= length; i += 4) {
+		a0 = _mm_loadu_ps (srcs[0] + i);
+		for (k = 1; k < nsrcs; k++)
+			a0 = _mm_add_ps (a0, _mm_loadu_ps (srcs[k] + i));
+		_mm_storeu_ps (dest + i, a0);
+	}
+	for (; i < length; i++) {
+		float acc = srcs[0][i];
+		for (k = 1; k < nsrcs; k++)
+			acc += srcs[k][i];
+		dest[i] = acc;
+	}
+}
+
+__attribute__((target ("avx2")))
+void
+x86_avx2_copyf (float *dest, const float *src, int length)
+{
+	int i;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		__m256 a = _mm256_loadu_ps (src + i);
+		__m256 b = _mm256_loadu_ps (src + i + 8);
+		__m256 c = _mm256_loadu_ps (src + i + 16);
+		__m256 d = _mm256_loadu_ps (src + i + 24);
+		_mm256_storeu_ps (dest + i, a);
+		_mm256_storeu_ps (dest + i + 8, b);
+		_mm256_storeu_ps (dest + i + 16, c);
+		_mm256_storeu_ps (dest + i + 24, d);
+	}
+	for (; i + 8 <= length; i += 8)
+		_mm256_storeu_ps (dest + i, _mm256_loadu_ps (src + i));
+	for (; i < length; i++)
+		dest[i] = src[i];
+}
+
+__attribute__((target ("avx2")))
+void
+x86_avx2_add2f (float *dest, const float *src, int length)
+{
+	int i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		__m256 a = _mm256_add_ps (_mm256_loadu_ps (dest + i),
+					  _mm256_loadu_ps (src + i));
+		__m256 b = _mm256_add_ps (_mm256_loadu_ps (dest + i + 8),
+					  _mm256_loadu_ps (src + i + 8));
+		_mm256_storeu_ps (dest + i, a);
+		_mm256_storeu_ps (dest + i + 8, b);
+	}
+	for (; i + 8 <= length; i += 8)
+		_mm256_storeu_ps (dest + i,
+				  _mm256_add_ps (_mm256_loadu_ps (dest + i),
+						 _mm256_loadu_ps (src + i)));
+	for (; i < length; i++)
+		dest[i] += src[i];
+}
+
+__attribute__((target ("avx2")))
+void
+x86_avx2_mixnf (float *dest, const float * const *srcs, int nsrcs, int length)
+{
+	int i, k;
+	const float *src;
+	__m256 a0, a1, a2, a3;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		src = srcs[0] + i;
+		a0 = _mm256_loadu_ps (src);
+		a1 = _mm256_loadu_ps (src + 8);
+		a2 = _mm256_loadu_ps (src + 16);
+		a3 = _mm256_loadu_ps (src + 24);
+		for (k = 1; k < nsrcs; k++) {
+			src = srcs[k] + i;
+			a0 = _mm256_add_ps (a0, _mm256_loadu_ps (src));
+			a1 = _mm256_add_ps (a1, _mm256_loadu_ps (src + 8));
+			a2 = _mm256_add_ps (a2, _mm256_loadu_ps (src + 16));
+			a3 = _mm256_add_ps (a3, _mm256_loadu_ps (src + 24));
+		}
+		_mm256_storeu_ps (dest + i, a0);
+		_mm256_storeu_ps (dest + i + 8, a1);
+		_mm256_storeu_ps (dest + i + 16, a2);
+		_mm256_storeu_ps (dest + i + 24, a3);
+	}
+	for (; i + 8 <= length; i += 8) {
+		a0 = _mm256_loadu_ps (srcs[0] + i);
+		for (k = 1; k < nsrcs; k++)
+			a0 = _mm256_add_ps (a0, _mm256_loadu_ps (srcs[k] + i));
+		_mm256_storeu_ps (dest + i, a0);
+	}
+	for (; i < length; i++) {
+		float acc = srcs[0][i];
+		for (k = 1; k < nsrcs; k++)
+			acc += srcs[k][i];
+		dest[i] = acc;
+	}
+}
+
+__attribute__((target ("avx512f")))
+void
+x86_avx512_copyf (float *dest, const float *src, int length)
+{
+	int i;
+
+	for (i = 0; i + 64 <= length; i += 64) {
+		__m512 a = _mm512_loadu_ps (src + i);
+		__m512 b = _mm512_loadu_ps (src + i + 16);
+		__m512 c = _mm512_loadu_ps (src + i + 32);
+		__m512 d = _mm512_loadu_ps (src + i + 48);
+		_mm512_storeu_ps (dest + i, a);
+		_mm512_storeu_ps (dest + i + 16, b);
+		_mm512_storeu_ps (dest + i + 32, c);
+		_mm512_storeu_ps (dest + i + 48, d);
+	}
+	for (; i + 16 <= length; i += 16)
+		_mm512_storeu_ps (dest + i, _mm512_loadu_ps (src + i));
+	if (i < length) {
+		__mmask16 m = (__mmask16)((1u << (length - i)) - 1);
+		_mm512_mask_storeu_ps (dest + i, m,
+				       _mm512_maskz_loadu_ps (m, src + i));
+	}
+}
+
+__attribute__((target ("avx512f")))
+void
+x86_avx512_add2f (float *dest, const float *src, int length)
+{
+	int i;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		__m512 a = _mm512_add_ps (_mm512_loadu_ps (dest + i),
+					  _mm512_loadu_ps (src + i));
+		__m512 b = _mm512_add_ps (_mm512_loadu_ps (dest + i + 16),
+					  _mm512_loadu_ps (src + i + 16));
+		_mm512_storeu_ps (dest + i, a);
+		_mm512_storeu_ps (dest + i + 16, b);
+	}
+	for (; i + 16 <= length; i += 16)
+		_mm512_storeu_ps (dest + i,
+				  _mm512_add_ps (_mm512_loadu_ps (dest + i),
+						 _mm512_loadu_ps (src + i)));
+	if (i < length) {
+		__mmask16 m = (__mmask16)((1u << (length - i)) - 1);
+		_mm512_mask_storeu_ps (dest + i, m,
+				       _mm512_add_ps (_mm512_maskz_loadu_ps (m, dest + i),
+						      _mm512_maskz_loadu_ps (m, src + i)));
+	}
+}
+
+__attribute__((target ("avx512f")))
+void
+x86_avx512_mixnf (float *dest, const float * const *srcs, int nsrcs, int length)
+{
+	int i, k;
+	const float *src;
+	__m512 a0, a1, a2, a3;
+	__mmask16 m;
+
+	for (i = 0; i + 64 <= length; i += 64) {
+		src = srcs[0] + i;
+		a0 = _mm512_loadu_ps (src);
+		a1 = _mm512_loadu_ps (src + 16);
+		a2 = _mm512_loadu_ps (src + 32);
+		a3 = _mm512_loadu_ps (src + 48);
+		for (k = 1; k < nsrcs; k++) {
+			src = srcs[k] + i;
+			a0 = _mm512_add_ps (a0, _mm512_loadu_ps (src));
+			a1 = _mm512_add_ps (a1, _mm512_loadu_ps (src + 16));
+			a2 = _mm512_add_ps (a2, _mm512_loadu_ps (src + 32));
+			a3 = _mm512_add_ps (a3, _mm512_loadu_ps (src + 48));
+		}
+		_mm512_storeu_ps (dest + i, a0);
+		_mm512_storeu_ps (dest + i + 16, a1);
+		_mm512_storeu_ps (dest + i + 32, a2);
+		_mm512_storeu_ps (dest + i + 48, a3);
+	}
+	for (; i < length; i += 16) {
+		m = (length - i >= 16) ? (__mmask16)0xffff
+		    : (__mmask16)((1u << (length - i)) - 1);
+		a0 = _mm512_maskz_loadu_ps (m, srcs[0] + i);
+		for (k = 1; k < nsrcs; k++)
+			a0 = _mm512_add_ps (a0, _mm512_maskz_loadu_ps (m, srcs[k] + i));
+		_mm512_mask_storeu_ps (dest + i, m, a0);
+	}
+}
+
 #endif  /* ARCH_X86 */
 
-#endif  /* USE_DYNSIMD */
+#ifdef ARCH_ARM64
+
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+int
+have_neon ()
+{
+	return (getauxval (AT_HWCAP) & HWCAP_ASIMD) != 0;
+}
+
+void
+arm64_neon_copyf (float *dest, const float *src, int length)
+{
+	int i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		float32x4_t a = vld1q_f32 (src + i);
+		float32x4_t b = vld1q_f32 (src + i + 4);
+		float32x4_t c = vld1q_f32 (src + i + 8);
+		float32x4_t d = vld1q_f32 (src + i + 12);
+		vst1q_f32 (dest + i, a);
+		vst1q_f32 (dest + i + 4, b);
+		vst1q_f32 (dest + i + 8, c);
+		vst1q_f32 (dest + i + 12, d);
+	}
+	for (; i + 4 <= length; i += 4)
+		vst1q_f32 (dest + i, vld1q_f32 (src + i));
+	for (; i < length; i++)
+		dest[i] = src[i];
+}
+
+void
+arm64_neon_add2f (float *dest, const float *src, int length)
+{
+	int i;
 
+	for (i = 0; i + 8 <= length; i += 8) {
+		float32x4_t a = vaddq_f32 (vld1q_f32 (dest + i),
+					   vld1q_f32 (src + i));
+		float32x4_t b = vaddq_f32 (vld1q_f32 (dest + i + 4),
+					   vld1q_f32 (src + i + 4));
+		vst1q_f32 (dest + i, a);
+		vst1q_f32 (dest + i + 4, b);
+	}
+	for (; i < length; i++)
+		dest[i] += src[i];
+}
+
+void
+arm64_neon_mixnf (float *dest, const float * const *srcs, int nsrcs, int length)
+{
+	int i, k;
+	const float *src;
+	float32x4_t a0, a1, a2, a3;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		src = srcs[0] + i;
+		a0 = vld1q_f32 (src);
+		a1 = vld1q_f32 (src + 4);
+		a2 = vld1q_f32 (src + 8);
+		a3 = vld1q_f32 (src + 12);
+		for (k = 1; k < nsrcs; k++) {
+			src = srcs[k] + i;
+			a0 = vaddq_f32 (a0, vld1q_f32 (src));
+			a1 = vaddq_f32 (a1, vld1q_f32 (src + 4));
+			a2 = vaddq_f32 (a2, vld1q_f32 (src + 8));
+			a3 = vaddq_f32 (a3, vld1q_f32 (src + 12));
+		}
+		vst1q_f32 (dest + i, a0);
+		vst1q_f32 (dest + i + 4, a1);
+		vst1q_f32 (dest + i + 8, a2);
+		vst1q_f32 (dest + i + 12, a3);
+	}
+	for (; i + 4 <= length; i += 4) {
+		a0 = vld1q_f32 (srcs[0] + i);
+		for (k = 1; k < nsrcs; k++)
+			a0 = vaddq_f32 (a0, vld1q_f32 (srcs[k] + i));
+		vst1q_f32 (dest + i, a0);
+	}
+	for (; i < length; i++) {
+		float acc = srcs[0][i];
+		for (k = 1; k < nsrcs; k++)
+			acc += srcs[k][i];
+		dest[i] = acc;
+	}
+}
+
+#endif  /* ARCH_ARM64 */
+
+#endif  /* USE_DYNSIMD */
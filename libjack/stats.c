@@ -0,0 +1,121 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "internal.h"
+#include "shm.h"
+
+#include "local.h"
+
+/* Reader side of the engine's per-client DSP load records. A record is
+ * rewritten about once a second, so a copy that races with the engine
+ * is simply retried.
+ */
+
+#define JACK_STATS_READ_TRIES 4
+
+static jack_stats_header_t *
+jack_stats_attach (jack_client_t *client)
+{
+	jack_stats_header_t *header = NULL;
+
+	pthread_mutex_lock (&client->attach_lock);
+
+	if (client->stats_shm.attached_at) {
+		header = (jack_stats_header_t*)jack_shm_addr (&client->stats_shm);
+	} else if (client->engine->stats_shm_index == JACK_SHM_NULL_INDEX) {
+		jack_error ("server does not provide client statistics");
+	} else {
+		client->stats_shm.index = client->engine->stats_shm_index;
+		if (jack_attach_shm (&client->stats_shm)) {
+			jack_error ("cannot attach client statistics shared "
+				    "memory (%s)", strerror (errno));
+			client->stats_shm.attached_at = NULL;
+		} else {
+			header = (jack_stats_header_t*)
+				 jack_shm_addr (&client->stats_shm);
+		}
+	}
+
+	pthread_mutex_unlock (&client->attach_lock);
+
+	return header;
+}
+
+int
+jack_stats_copy (jack_stats_header_t *header, jack_client_stats_t *stats,
+		 uint32_t max)
+{
+	jack_client_stats_t *rec;
+	uint32_t i, seq, n = 0;
+	int tries;
+
+	for (i = 0; i < header->nclients && n < max; i++) {
+
+		rec = &header->clients[i];
+
+		for (tries = 0; tries < JACK_STATS_READ_TRIES; tries++) {
+
+			seq = __atomic_load_n (&rec->seq, __ATOMIC_ACQUIRE);
+
+			if (seq & 1) {
+				continue;
+			}
+
+			memcpy (&stats[n], (const void*)rec, sizeof(*rec));
+			__atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+			if (__atomic_load_n (&rec->seq, __ATOMIC_RELAXED) == seq) {
+				if (stats[n].in_use) {
+					n++;
+				}
+				break;
+			}
+		}
+	}
+
+	return n;
+}
+
+int
+jack_get_client_stats (jack_client_t *client, jack_client_stats_t *stats,
+		       uint32_t max)
+{
+	jack_stats_header_t *header;
+
+	if ((header = jack_stats_attach (client)) == NULL) {
+		return -1;
+	}
+
+	return jack_stats_copy (header, stats, max);
+}
+
+void
+jack_stats_detach (jack_client_t *client)
+{
+	pthread_mutex_lock (&client->attach_lock);
+	if (client->stats_shm.attached_at) {
+		jack_release_shm (&client->stats_shm);
+		client->stats_shm.attached_at = NULL;
+	}
+	pthread_mutex_unlock (&client->attach_lock);
+}
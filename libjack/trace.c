@@ -0,0 +1,125 @@
+/* -*- mode: c; c-file-style: "bsd"; -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "internal.h"
+#include "shm.h"
+
+#include "local.h"
+
+/* Reader side of the engine's per-cycle trace ring. The engine is the
+ * only writer and never waits for us, so anything we are too slow to
+ * copy is simply lost.
+ */
+
+static jack_trace_header_t *
+jack_trace_attach (jack_client_t *client)
+{
+	jack_trace_header_t *trace = NULL;
+
+	pthread_mutex_lock (&client->attach_lock);
+
+	if (client->trace_shm.attached_at) {
+		trace = (jack_trace_header_t*)jack_shm_addr (&client->trace_shm);
+	} else if (client->engine->trace_shm_index == JACK_SHM_NULL_INDEX) {
+		jack_error ("server does not provide a cycle trace");
+	} else {
+		client->trace_shm.index = client->engine->trace_shm_index;
+		if (jack_attach_shm (&client->trace_shm)) {
+			jack_error ("cannot attach cycle trace shared memory (%s)",
+				    strerror (errno));
+			client->trace_shm.attached_at = NULL;
+		} else {
+			trace = (jack_trace_header_t*)
+				jack_shm_addr (&client->trace_shm);
+		}
+	}
+
+	pthread_mutex_unlock (&client->attach_lock);
+
+	return trace;
+}
+
+int
+jack_get_cycle_trace (jack_client_t *client, jack_trace_record_t *records,
+		      uint32_t max, uint64_t *position)
+{
+	jack_trace_header_t *trace;
+	jack_trace_record_t *rec;
+	uint64_t head;
+	uint32_t seq;
+	uint32_t n = 0;
+
+	if ((trace = jack_trace_attach (client)) == NULL) {
+		return -1;
+	}
+
+	head = __atomic_load_n (&trace->head, __ATOMIC_ACQUIRE);
+
+	if (*position > head) {
+		/* server restarted underneath us */
+		*position = head;
+	}
+
+	if (head - *position > trace->size) {
+		*position = head - trace->size;
+	}
+
+	while (n < max && *position < head) {
+
+		rec = &trace->records[*position & (trace->size - 1)];
+		seq = (uint32_t)(2 * *position + 2);
+
+		if (__atomic_load_n (&rec->seq, __ATOMIC_ACQUIRE) == seq) {
+
+			memcpy (&records[n], (const void*)rec, sizeof(*rec));
+			__atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+			/* the writer lapped us while copying? */
+			if (__atomic_load_n (&rec->seq, __ATOMIC_RELAXED) == seq) {
+				n++;
+			}
+		}
+
+		(*position)++;
+	}
+
+	return n;
+}
+
+void
+jack_trace_detach (jack_client_t *client)
+{
+	pthread_mutex_lock (&client->attach_lock);
+	if (client->trace_shm.attached_at) {
+		jack_release_shm (&client->trace_shm);
+		client->trace_shm.attached_at = NULL;
+	}
+	pthread_mutex_unlock (&client->attach_lock);
+}
+
+void
+jack_get_null_cycles (jack_client_t *client, uint32_t *lock, uint32_t *problem)
+{
+	*lock = client->engine->lock_null_cycles;
+	*problem = client->engine->problem_null_cycles;
+}